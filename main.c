@@ -12,6 +12,30 @@
 #include <ncurses.h>    // Text-based UI library
 #include <time.h>
 #include<math.h>
+#include <pthread.h>    // Worker threads for the headless calibration sweep
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sched.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <sys/stat.h>   // fstat for level packs and tick histories
+#include <sys/mman.h>   // mmap for level packs and tick histories
+#include <fcntl.h>      // open and posix_fadvise
+#include <poll.h>
+#include <signal.h>
+#include <pty.h>        // forkpty for --pty-latency
+#include <sys/socket.h>
+#include <sys/un.h>     // Unix sockets for --host and --join
+#include <netinet/in.h> // loopback port for METRICS
+#include <linux/perf_event.h>   // hardware counters for --perf and --stress
+#include <zlib.h>       // compressed session recordings
+#include "swallow_env.h" // library API, see VECTORIZED ENVIRONMENTS
+#include "swallow_shm.h" // shared memory layout, see SHARED STATE EXPORT
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>  // __rdtsc for the event trace clock
+#endif
 
 
 //=================================//
@@ -26,10 +50,13 @@
 #define LEFT        'a'
 #define RIGHT       'd'
 #define ACTIVATE_TAXI 't'
+#define PLAY_AGAIN  'r'        // on the end screen
 // Timing and speed
 #define FRAME_TIME    50   // Milliseconds per frame (100ms = 0.1 sec)
 #define SPEED_UP     'p'
 #define SPEED_DOWN    'o'
+#define HUNTER_WAIT   30   // frames a hunter rests against a wall before dashing again
+#define MAX_DT        16   // most frames GameTick may simulate at once
 
 #define BORDER 1
 // Color pair identifiers (used with ncurses color system)
@@ -42,7 +69,11 @@
 #define OFFX        5        // X offset from left of screen
 
 #define MAX_COMMAND_SIZE 50 // max command size for the configuration.txt
+#define MAX_MAP_PATH 256    // MAP file name
+#define MAP_WALL_COLOR MAIN_COLOR
 #define THRESHOLD    3 // used for the birds speed
+#define BIRD_SYMBOL  "/|O|\\"
+#define BIRD_WIDTH   ((int)sizeof(BIRD_SYMBOL) - 1)
 
 // ranking system
 #define NUM_PLAYERS 10
@@ -55,6 +86,14 @@
 
 #define MAX_STARS 10
 #define MAX_HUNTERS 6
+#define MAX_BIRDS 8             // bit masks of birds are one byte
+#define MAX_PLAYERS 3           // birds steered from the keyboard, the rest are flown by the bot
+#define BIRD_CELL 8             // a cell of the bird grid covers at least 8x8 board cells
+#define BIRD_GRID 64            // and the grid is at most 64x64 cells
+#define MAP_SPAWN_TRIES 8       // spots a hunter tries before it gives up on a respawn
+#define ENTITY_CHUNK 256        // hunters or stars per job of the update phase
+#define MAX_SHAPE_ROWS 16       // tallest hunter mask, rows are one uint64_t so at most 64 wide
+#define MAX_SHAPE_TEXT 1100     // "#.#/###/..." text of a HUNTER_MASK line
 #define BORDER      1
 //COLORS
 #define MAIN_COLOR    1        // Main window color
@@ -66,11 +105,34 @@
 #define INJURED_BIRD  6
 #define TAXI_COLOR    7
 
+//DIFFICULTY
+#define NUM_LEVELS 4
+#define DIFFICULTY_FILE "difficulty.txt"
+#define TRACE_FILE "trace.bin"
+#define RECORD_FILE "session-%ld.cast.gz"   // %ld: start time
+#define GAME_RUNNING (-1) // MainLoop/GameTick result while the game is still going
+#define HEADLESS(w) ((w)->window == NULL) // simulated games have no ncurses window
+// The *With functions take board and shape sizes as arguments: called with constants
+// they are compiled into the specialised kernels, see GAME_KERNEL
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// Static walls of the board from a MAP file: an occupancy grid and its summed-area table,
+// so whether a box holds any wall is four lookups whatever the box size or the wall count
+typedef struct{
+    int cols, rows;
+    int walls;              // wall cells
+    uint8_t* solid;         // cols x rows, 1 for a wall
+    int32_t* sum;           // (cols + 1) x (rows + 1), walls above and left of every corner
+    int lanes;              // columns the stars fall in (levels of a PACK), 0 for any column
+    uint16_t* lane;         // cols entries when the map can hold lanes, else NULL
+} MAP;
+
 typedef struct {
     WINDOW* window;        // ncurses window pointer
     int x, y;        // position on screen
     int rows, cols;        // size of window
     int color;        // color scheme
+    const MAP* map;   // walls inside the play window, NULL for none
 } WIN;
 
 typedef struct {
@@ -80,11 +142,15 @@ typedef struct {
     int speed;        // movement speed
     int counter;
     char *symbol;        // character to display
+    int width;           // strlen(symbol), kept so the hot loops do not recount it
     int color;      // color scheme
     int score;
     int life;
     int max_life;
     int on_taxi;  //0 false , 1 true
+    int last_x, last_y;  // position before the last MoveBird, for swept collisions
+    int path_x[MAX_DT], path_y[MAX_DT];  // position after each frame of the last MoveBird
+    int dirty;    // 1 once it turned, stepped, scored or was hurt, until TickHistoryRecord hashed it
 } BIRD;
 
 typedef struct{
@@ -99,6 +165,12 @@ typedef struct{
     int color;
     int active ;  // 1 - is active , 0 - is dead
     int wait_dash;
+    int routed;   // 1 while it follows the flow field around walls instead of dashing straight
+    int id;       // slot in the hunter array
+    int solid;    // 1 when the whole width x height box is filled
+    unsigned int seed; // the game's, its draws are GameRandAt(seed, tick, id, ...)
+    uint64_t mask[MAX_SHAPE_ROWS];  // bit j of mask[i] is the cell (x + j , y + i)
+    int dirty;    // 1 once it moved, turned, ended a wait or died, until TickHistoryRecord hashed it
 } HUNTER;
 
 typedef struct {
@@ -111,6 +183,9 @@ typedef struct {
     int counter;
     char symbol;
     int color;
+    int id;           // slot in the star array
+    unsigned int seed; // the game's, its draws are GameRandAt(seed, tick, id, ...)
+    int dirty;        // 1 once it was caught or fell off the board, until TickHistoryRecord hashed it
 } STAR ;
 
 typedef struct{
@@ -119,14 +194,92 @@ typedef struct{
     int dx , dy ;
     int speed;
     char *symbol;
+    int width;  // strlen(symbol)
     int color;
     int counter_of_taxis;
     int active;
     int state ; // 0 waiting time on the bird
+    int last_x; // position before the last MoveTaxi
+    BIRD* rider; // the bird on board while state is 1
+    int bonus;   // bonus stars a ride puts on the road, at most BONUS_STARS
     int bonusx[BONUS_STARS]; //position of the bonus points that will appear on the road
     int bonusa[BONUS_STARS]; //1 is a visible bonus 0 is an already collected one
+    int dirty;   // 1 once it came, moved or left, until TickHistoryRecord hashed it
 } TAXI;
 
+// Where a hunter should go from every cell of a board with walls, from a breadth first
+// search from the birds redone whenever one of them changes cell. A cell is a position of the hunter's
+// top left corner, open when the whole hunter fits there between the walls and the border.
+typedef struct{
+    const MAP* map;
+    int cols, rows;
+    int hw, hh;                     // hunter box
+    int count;                      // birds the field was built for
+    int key[MAX_BIRDS][2];          // and their cells, -1 for a dead bird
+    long builds;                    // searches started
+    int step[8];                    // cell index offset of each direction
+    int head, tail;                 // of the search queue, kept so it can go on next tick
+    uint8_t* open;
+    uint8_t* moves;                 // bit k: the step to direction k stays open
+    uint16_t* dist;                 // steps to the nearest bird, FLOW_FAR without a route (yet)
+    uint8_t* target;                // the bird the route leads to
+    uint8_t* want;                  // hunter cells the search still has to reach
+    int32_t* queue;
+} FLOW_FIELD;
+
+// STAR_RAIN: thousands of stars as bits, see the STAR RAIN section
+#define RAIN_CLASSES 14         // speed classes, an interval of 2 to 5 frames and a phase within it
+#define RAIN_MAX_WORDS 64       // 64-bit words per row, so boards up to 4098 columns
+
+typedef struct{
+    WIN* win;
+    int rows, width, words;         // falling rows (screen rows 1..rows), columns (1..width)
+    long stars;
+    long frame;
+    unsigned int seed;              // of the game, for GameRandAt
+    int top[RAIN_CLASSES];          // ring row of screen row 1, per class
+    uint64_t* plane;                // [class][ring row][word], bit j is column 1 + j
+    uint64_t* shown;                // [screen row - 1][word], the rain on screen
+    uint8_t* touched;               // [class][ring row], 1 once a star left or joined the row
+    int32_t* changed;               // the touched rows, in the order they were touched
+    long changes;                   // until TickHistoryRecord hashed them
+} STAR_RAIN;
+
+// Every bird of the game, and a coarse grid over the board to find them: bit i of a cell
+// is set when bird i passed through it in the last tick. Hunters aim at and hit birds, and
+// stars are caught, through the grid, so each only looks at the birds near it.
+typedef struct{
+    BIRD* bird[MAX_BIRDS];
+    int count;
+    int cell_w, cell_h;             // board cells per grid cell
+    int grid_cols, grid_rows;
+    int rect[MAX_BIRDS][4];         // grid cells x0 y0 x1 y1 bird i is in, x1 < x0 for none
+    uint8_t grid[BIRD_GRID * BIRD_GRID];
+    FLOW_FIELD* flow;               // routes for the hunters when the board has walls, else NULL
+    uint32_t tick;                  // frames played before this GameTick, the clock of the random draws
+} FLOCK;
+
+// What a chunk of hunters or stars did this frame. The birds are only changed
+// when the chunks are merged, in chunk order, so the update itself can run anywhere.
+typedef struct{
+    int damage[MAX_BIRDS];  // life lost to hunters
+    int score[MAX_BIRDS];   // stars collected
+    int spawns;             // hunters of the chunk that rolled a respawn
+} FRAME_EFFECTS;
+
+// Bird, star and hunter updates compiled for one board size and solid hunter shape,
+// chosen by SelectKernel when the config is loaded. The generic one fits any config.
+typedef struct{
+    int cols, rows;                         // board, 0 for the generic kernel
+    int hunter_width, hunter_height;
+    void (*move_bird)(BIRD* b , int dt);
+    void (*move_stars)(void* batch , int chunk);     // JOB_FN over an ENTITY_BATCH
+    void (*move_hunters)(void* batch , int chunk);
+    const char* name;
+} GAME_KERNEL;
+
+typedef struct LEVEL_PACK LEVEL_PACK;
+
 typedef struct {
     int screen_width;
     int screen_height;
@@ -143,8 +296,28 @@ typedef struct {
     int hunter_bounces;
     int hunter_width;
     int hunter_height;
+    int hunter_solid;
+    uint64_t hunter_mask[MAX_SHAPE_ROWS]; // HUNTER_MASK, or a solid HUNTER_SHAPE box
     int hunter_num;
     int available_taxis;
+    int record;              // 1 records the session to an asciicast file
+    int shared_state;        // 1 publishes every tick to shared memory, see swallow_shm.h
+    int birds;               // birds in the game, 1 to MAX_BIRDS
+    char map_file[MAX_MAP_PATH];    // MAP, empty for an open board
+    const MAP* map;          // loaded by LoadConfig
+    int players;             // of those steered from the keyboard, the rest fly with the bot
+    int planner;             // PLANNER: simulated ticks per decision of the lookahead bot, 0 for the reference bot
+    int planner_threads;     // PLANNER_THREADS, 0 for every core
+    int star_rain;           // STAR_RAIN: falling stars on top of the MAX_STARS ones, 0 for none
+    char pack_file[MAX_MAP_PATH];   // PACK, empty for no campaign
+    LEVEL_PACK* pack;        // opened by LoadConfig
+    int pack_level;          // level of the pack being played, 0 without one
+    int taxi_bonus;          // bonus stars on a taxi ride, at most BONUS_STARS
+    int hunter_flocking;     // HUNTER_FLOCKING: 1 makes the hunters keep apart and fly together, see HUNTER BOIDS
+    int heatmap;             // HEATMAP: 1 appends where things happened in every game to HEATMAP_FILE
+    int autosave;            // AUTOSAVE: seconds between checkpoints of the game to resume after a crash, 0 for none
+    int metrics;             // METRICS: 1 serves Prometheus metrics on a Unix socket, a port number on that port
+    const GAME_KERNEL* kernel;  // set by LoadConfig
 } GameConfig;
 
 typedef struct{
@@ -155,931 +328,4895 @@ typedef struct{
     int total_score;
 } RANKING;
 
+// Settings applied by Difficulty() when a level starts
+typedef struct{
+    int hunter_spawn_rate;
+    int hunter_bounces;
+    int hunter_num;
+    double hunter_speed;   // 0 keeps the speed from config.txt
+} LEVEL;
+
+typedef struct{
+    LEVEL level[NUM_LEVELS];
+} DIFFICULTY_TABLE;
+
+// The hand tuned values, used when there is no difficulty.txt
+static const DIFFICULTY_TABLE DEFAULT_DIFFICULTY = {{
+    {50, 3, 3, 0.0},
+    {25, 8, 4, 0.0},
+    {20, 5, 5, 1.0},
+    {10, 4, 6, 1.2},
+}};
+
+// Bump allocator: one block, reset by forgetting everything in it
+typedef struct{
+    unsigned char* base;
+    size_t size;
+    size_t used;
+} ARENA;
+
+typedef struct PLANNER PLANNER;
+typedef struct HEATMAP HEATMAP;
+
+// A level of a PACK file once decoded, see LEVEL PACKS
+enum { PACK_EMPTY, PACK_LOADING, PACK_READY };
+
+typedef struct{
+    int number;                     // 1 based, 0 for none
+    int state;                      // PACK_EMPTY, PACK_LOADING or PACK_READY
+    int users;                      // games playing it, it is not reused while > 0
+    long used;                      // pack clock when it was last entered
+    int star_quota;
+    double time_limit;
+    int available_taxis;
+    int taxi_bonus;
+    DIFFICULTY_TABLE table;
+    MAP* map;                       // walls and star lanes, NULL when the level has neither
+    MAP* store;                     // the slot's own map memory
+} PACK_LEVEL;
+
+// Everything one game owns. The actors live in the arena, so a new game is an arena
+// reset plus re-initialising them, and the ncurses screen stays up in between.
+typedef struct{
+    ARENA arena;
+    WIN* playwin;                   // owned by the caller, kept across games
+    WIN* statwin;                   // NULL for headless games
+    GameConfig base;                // config.txt as loaded
+    GameConfig config;              // this game's copy, changed by Difficulty and the taxi
+    const DIFFICULTY_TABLE* table;  // the caller's, for games without a pack
+    const DIFFICULTY_TABLE* level_table;    // this game's: table or the pack level's
+    const PACK_LEVEL* level;        // the pack level played, NULL without a pack
+    int pack_level;                 // pack level the next SessionReset starts, 1 based
+    BIRD* bird;                     // the first player's bird
+    TAXI* taxi;
+    STAR* star[MAX_STARS];
+    HUNTER* hunter[MAX_HUNTERS];
+    FLOCK flock;                    // every bird, flock.bird[0] is bird
+    long frame;                     // frames played in this game
+    double max_time;                // time limit at the start of the game
+    unsigned int seed;              // seed of the current game
+    int games;                      // games started on this session
+    long frame_allocs;              // heap allocations in the frames after the first one
+    uint64_t restart_ns;            // SessionReset to the end of the first frame (headless games)
+    PLANNER* planner;               // plays the bot's birds when set, owned by the session
+    STAR_RAIN* rain;                // STAR_RAIN stars, in the arena, NULL without them
+    HEATMAP* heat;                  // this game's HEATMAP counts, in the arena, NULL without them
+} GAME_SESSION;
+
 
 //============================//
-// ACTORS AND PHYSICS        //
+//  MEMORY                    //
 //==========================//
 
-// ___________BIRD___________//
+#define ARENA_ALIGN 16
+#define SESSION_ARENA_SIZE (MAX_BIRDS * sizeof(BIRD) + sizeof(TAXI) + MAX_STARS * sizeof(STAR) \
+                            + MAX_HUNTERS * sizeof(HUNTER) + (1 + MAX_BIRDS + MAX_STARS + MAX_HUNTERS) * ARENA_ALIGN)
 
+// Allocation counter so the frame loop can be checked to never touch the heap.
+// Only in builds with -DSWALLOW_COUNT_ALLOCS (make perf) and glibc: malloc, calloc and
+// realloc are then wrapped for the whole process (ncurses included) and forwarded to
+// glibc's allocator. Counted per thread, always 0 otherwise.
+static _Thread_local long alloc_count = 0;
 
-BIRD* InitBird(WIN* w, int x, int y, int dx, int dy , GameConfig *config)
-{
-    // Allocate memory for BIRD structure
-    BIRD* b = (BIRD*)malloc(sizeof(BIRD));
+// not in the library either, it would wrap the user's malloc
+#if defined(SWALLOW_COUNT_ALLOCS) && defined(__GLIBC__) && !defined(SWALLOW_NO_MAIN)
+#define ALLOCS_COUNTED 1
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
 
-    // Set bird properties
-    b->win = w;            // window containing bird
-    b->x = x;            // initial x position
-    b->y = y;            // initial y position
-    b->dx = dx;            // direction: -1=left, 1=right
-    b->dy = dy;            // direction: -1=up, 1=down
-    b->speed = config->swallow_speed_min;  // movement speed from the configuration
-    b->counter = 0;
-    b->symbol = "/|O|\\";        // display character
-    b->color = BIRD_COLOR;    // color scheme
-    b->score = 0;
-    b->life = 100;
-    b->max_life = 100;
-    return b;
+void* malloc(size_t size)
+{
+    alloc_count++;
+    return __libc_malloc(size);
 }
 
-void DrawBird(BIRD* b)
+void* calloc(size_t count, size_t size)
 {
-    // Set bird color
-    wattron(b->win->window, COLOR_PAIR(b->color));
-
-    // Draw bird symbol at current position
-    mvwprintw(b->win->window, b->y, b->x, "%s", b->symbol);
-
-    // Restore window color
-    wattron(b->win->window, COLOR_PAIR(b->win->color));
+    alloc_count++;
+    return __libc_calloc(count, size);
 }
 
-void ClearBird(BIRD* b)
+void* realloc(void* ptr, size_t size)
 {
-    // Overwrite bird with a space character
-    mvwprintw(b->win->window, b->y, b->x,"     ");
+    alloc_count++;
+    return __libc_realloc(ptr, size);
 }
+#else
+#define ALLOCS_COUNTED 0
+#endif
 
-void UpdateBirdColor(BIRD* b)
+// The line --perf ends with
+void PrintAllocs(long allocs)
 {
-    // We change the color ID based on how much life is left.
-    // Note: These color pair IDs (4, 6, 5) must match what we defined in screen.c/Start()
-    
-    if (b->life > 66) {
-        b->color = BIRD_COLOR;
-    } else if (b->life > 33) {
-        b->color = INJURED_BIRD;
-    } else {
-        b->color = HUNTER_COLOR; // Pair 5 = Red (Critical)
-    }
+    if (ALLOCS_COUNTED) printf("heap allocations after the first frame: %ld\n", allocs);
+    else printf("heap allocations after the first frame: not counted, build with make perf\n");
 }
 
-void MoveBird(BIRD* b)
+int ArenaInit(ARENA* a, size_t size)
 {
-    b->counter += b->speed;
-    while(b->counter >= THRESHOLD){
-        
-        
-        b->counter -= THRESHOLD;
-        // Step 1: Erase bird from old position
-        ClearBird(b);
-        int bird_size = strlen(b->symbol);
-        // Step 2: Check if bird is already at boundary
-        // If at boundary, only reverse direction - don't move!
-        int at_x_boundary = (b->x <= BORDER) || (b->x >= b->win->cols - BORDER - 1);
-        int at_y_boundary = (b->y <= BORDER) || (b->y >= b->win->rows - BORDER - 1);
-        
-        // Step 3: Handle horizontal movement
-        if (at_x_boundary) {
-            // Already at X boundary - just reverse direction if needed
-            if (b->x <= BORDER) {
-                b->dx = 1;     // Change direction to right
-            }
-            else if (b->x >= b->win->cols - BORDER - bird_size) {
-                b->dx = -1;    // Change direction to left
-            }
-            // Don't change X position!
-        }
-        // Not at boundary - calculate new position
-        int new_x = b->x + b->dx;
-        
-        // Check if new position would hit boundary
-        if (new_x <= BORDER) {
-            b->x = BORDER;
-            b->dx = 1;
-        }
-        else if (new_x >= b->win->cols - BORDER - bird_size) {
-            b->x = b->win->cols - BORDER - bird_size;
-            b->dx = -1;
-        }
-        else {
-            b->x = new_x;    // Accept new position
-        }
-        
-        if (at_y_boundary) {
-            // Already at Y boundary - just reverse direction if needed
-            if (b->y <= BORDER) {
-                b->dy = 1;    // Change direction to down
-            }
-            else if (b->y >= b->win->rows - BORDER - 1) {
-                b->dy = -1;    // Change direction to up
-            }
-            // Don't change Y position!
-        }
-        // Not at boundary - calculate new position
-        int new_y = b->y + b->dy;
-        
-        // Check if new position would hit boundary
-        if (new_y <= BORDER) {
-            b->y = BORDER;
-            b->dy = 1;
-        }
-        else if (new_y >= b->win->rows - BORDER - 1) {
-            b->y = b->win->rows - BORDER - 1;
-            b->dy = -1;
-        }
-        else {
-            b->y = new_y;    // Accept new position
-        }
-        
-        
-        // Step 5: Draw bird at new position
-        UpdateBirdColor(b);
-        DrawBird(b);
-    }
+    a->base = (unsigned char*)malloc(size);
+    a->size = a->base ? size : 0;
+    a->used = 0;
+    return a->base != NULL;
 }
 
-void SpeedUp(BIRD* b , GameConfig *config)
+// Returns NULL when the arena is full
+void* ArenaAlloc(ARENA* a, size_t size)
 {
-    if(b->speed < config->swallow_speed_max){
-        b->speed++;
-    }
+    size_t start = (a->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (start + size > a->size) return NULL;
+    a->used = start + size;
+    return a->base + start;
 }
 
-void SpeedDown(BIRD* b , GameConfig *config)
+void ArenaReset(ARENA* a)
 {
-    if(b->speed > config->swallow_speed_min){
-        b->speed--;
-    }
+    a->used = 0;
 }
 
-void UpBird(BIRD* b)
+void ArenaFree(ARENA* a)
 {
-    b->dy = -1;
-    b->dx = 0;
+    free(a->base);
+    a->base = NULL;
+    a->size = a->used = 0;
 }
 
-void DownBird(BIRD* b)
-{
-    b->dy = 1;
-    b->dx = 0;
 
+//============================//
+//  RANDOM NUMBERS            //
+//==========================//
+
+// Every game owns its own random stream so headless games can run
+// side by side on worker threads and still replay exactly from a seed.
+// The game itself does not use a stream: every draw a hunter, star or the rain makes is
+// GameRandAt of the game's seed, the tick, the entity's id and what the number is for,
+// so updating them in any order, on any thread or four at a time gives the same game.
+// GameRand is left for the tools (the calibration samples).
+static _Thread_local unsigned int rng_state = 1;
+static _Thread_local unsigned int game_seed = 1;
+
+void GameSeed(unsigned int seed)
+{
+    rng_state = seed;
+    game_seed = seed;
 }
 
-void RightBird(BIRD* b)
+int GameRandFrom(unsigned int* state)
 {
-    b->dx = 1;
-    b->dy = 0;
+    *state = *state * 1103515245u + 12345u;
+    return (int)((*state >> 16) & 0x7fff);
 }
 
-void LeftBird(BIRD* b)
+int GameRand(void)
 {
-    b->dx = -1;
-    b->dy = 0;
+    return GameRandFrom(&rng_state);
 }
 
-//_________________HUNTER________//
+// Seed of the game being set up on this thread, the one entities key their draws with
+unsigned int GameKey(void)
+{
+    return game_seed;
+}
 
-//
-//  hunter.c
-//  project_test
-//
-//  Created by Mateusz Ciesielczyk on 29/11/2025.
-//
+// What a draw is for. A draw is only ever repeated by asking for the same thing again.
+enum {
+    RAND_HUNTER_BOUNCES,
+    RAND_HUNTER_SIDE,           // n is the spawn try
+    RAND_HUNTER_SPOT,
+    RAND_HUNTER_SPAWN,          // the respawn roll of an inactive hunter
+    RAND_STAR_X,
+    RAND_STAR_INTERVAL,
+    RAND_STAR_FALLEN,           // new column after falling off the bottom
+    RAND_STAR_CAUGHT_X,
+    RAND_STAR_CAUGHT_INTERVAL,
+    RAND_RAIN_STAR,             // id is the star, words 0-2 class, row and column
+    RAND_RAIN_TURN,             // id is the speed class
+    RAND_RAIN_RESPAWN           // id is the catch of the frame, words 0-1 class and column
+};
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
 
+typedef struct{
+    uint32_t word[4];
+} RAND4;
 
-HUNTER* InitHunter(WIN *w, BIRD* b , GameConfig *config)
+// Philox-4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"):
+// the counter (tick, id, purpose, n) scrambled under the key (seed, 0) by ten rounds of
+// two 32x32->64 multiplies. Four independent 32-bit words per call.
+static inline RAND4 Philox(uint32_t seed , uint32_t tick , uint32_t id , uint32_t purpose , uint32_t n)
 {
-    HUNTER* h = (HUNTER*)malloc(sizeof(HUNTER));
-    h->win = w;
-    h->speed = config->hunter_speed;
-    h->color = HUNTER_COLOR;
-    h->damage = config->damage_penalty;
-    
-    // Using config value for bounces
-    h->bounces = (rand() % 3) + config->hunter_bounces;
-    h->width = config->hunter_width;
-    h->height = config->hunter_height;
-    h->active = 1;
-    h->wait_dash = 0;
-    
-    // Spawn Logic
-    int side = rand() % 4;
-    if(side == 0) {  // Top
-           h->y = BORDER + 1;
-           h->x = (rand() % (w->cols - 2 * BORDER - 2 - h->width)) + BORDER + 1;
-       }
-       else if(side == 1) {  // Right
-           h->x = w->cols - BORDER - h->width;
-           h->y = (rand() % (w->rows - 2 * BORDER - 2 - h->height)) + BORDER + 1;
-       }
-       else if(side == 2) {  // Bottom
-           h->y = w->rows - BORDER - h->height;
-           h->x = (rand() % (w->cols - 2 * BORDER - 2 - h->width)) + BORDER + 1;
-       }
-       else {  // Left
-           h->x = BORDER + 1;
-           h->y = (rand() % (w->rows - 2 * BORDER - 2 - h->height)) + BORDER + 1;
-       }
-    double diffx = b->x - h->x;
-    double diffy = b->y - h->y;
-    double length = sqrt( (b->x - h->x)*(b->x - h->x) +  (b->y - h->y)*(b->y - h->y));
-    if (length != 0) {
-            h->dx = (diffx / length) ;
-            h->dy = (diffy / length) ;
-        } else {
-            h->dx = 0; h->dy = 0;
-        }
-    return h;
-}
-
-void InitMultipleHunter(HUNTER* h[] , WIN* w , BIRD* b , GameConfig *config){
-    for(int i =0 ; i < MAX_HUNTERS ; i++){
-        h[i] = InitHunter(w,b,config);
-        if (i < config->hunter_num) {
-            h[i]->active = 1;
-        }else {
-            h[i]->active = 0;
-        }
+    uint32_t c0 = tick, c1 = id, c2 = purpose, c3 = n;
+    uint32_t k0 = seed, k1 = 0;
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
     }
+    RAND4 out = {{ c0, c1, c2, c3 }};
+    return out;
 }
 
-void DrawHunter(HUNTER* h)
+// Four Philox calls side by side, for the ids id .. id + 3 and otherwise the same counter.
+// A 32-bit value per 64-bit lane, so a lane multiply is the full 32x32->64 product
+// (pmuludq). word[j] lane i is Philox(seed, tick, id + i, purpose, n).word[j].
+typedef uint64_t RAND_LANES __attribute__((vector_size(32)));
+
+static inline void PhiloxLanes(uint32_t seed , uint32_t tick , uint32_t id , uint32_t purpose , uint32_t n , RAND_LANES word[4])
 {
-    wattron(h->win->window, COLOR_PAIR(h->color));
-    int numposx = h->width / 2;
-    int numposy = h->height / 2;
-    for(int i =0 ; i < h->height ; i++){
-        for(int j = 0; j < h->width ; j++){
-            if(i == numposy && j == numposx){
-                mvwprintw(h->win->window, h->y + i, h->x + j, "%d", h->bounces);
-            }
-            else
-            {
-                mvwprintw(h->win->window, h->y + i, h->x + j, "#");
-            }
-        }
+    const uint64_t low = 0xffffffffu;
+    RAND_LANES c0 = { tick, tick, tick, tick };
+    RAND_LANES c1 = { id, id + 1u, id + 2u, id + 3u };
+    RAND_LANES c2 = { purpose, purpose, purpose, purpose };
+    RAND_LANES c3 = { n, n, n, n };
+    uint32_t k0 = seed, k1 = 0;
+    for (int r = 0; r < PHILOX_ROUNDS; r++) {
+        RAND_LANES p0 = c0 * PHILOX_M0;
+        RAND_LANES p1 = c2 * PHILOX_M1;
+        c0 = (p1 >> 32) ^ c1 ^ k0;
+        c1 = p1 & low;
+        c2 = (p0 >> 32) ^ c3 ^ k1;
+        c3 = p0 & low;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
     }
-    wattron(h->win->window, COLOR_PAIR(h->win->color));
+    word[0] = c0;
+    word[1] = c1;
+    word[2] = c2;
+    word[3] = c3;
+}
 
+// A draw of 0 .. 2^31 - 1, ready for % like GameRand
+static inline int GameRandAt(uint32_t seed , uint32_t tick , uint32_t id , uint32_t purpose , uint32_t n)
+{
+    return (int)(Philox(seed, tick, id, purpose, n).word[0] >> 1);
 }
 
-void DrawMultipleHunters(HUNTER* h[] , GameConfig *config){
-    for(int i =0 ; i < config->hunter_num ; i++){
-        DrawHunter(h[i]);
-    }
+
+//============================//
+//  COLLISION MASKS           //
+//==========================//
+
+// Every entity is rasterized into one uint64_t per row (bit j = j cells right of its x).
+// Two entities touch when any pair of rows on the same screen line share a set bit
+// once they are shifted to the same column. Rows are handled four at a time.
+typedef uint64_t ROWS4 __attribute__((vector_size(32)));
+
+uint64_t RowBits(int width)
+{
+    return width >= 64 ? ~0ULL : (1ULL << width) - 1;
 }
 
-void ClearHunter(HUNTER* h)
+void SolidMask(uint64_t rows[], int width, int height)
 {
-    for(int i =0 ; i < h->height ; i++){
-        for(int j = 0; j < h->width ; j++){
-            mvwprintw(h->win->window, (int)(h->y + i), (int)(h->x + j)," ");
+    for (int i = 0; i < MAX_SHAPE_ROWS; i++) rows[i] = i < height ? RowBits(width) : 0;
+}
 
+// Reads a HUNTER_MASK like "#.#/.#./#.#" ('#' filled, anything else empty, '/' between rows)
+// returns 1 if it fits in MAX_SHAPE_ROWS x 64 and has at least one filled cell
+int ParseMask(const char* text, uint64_t rows[], int* width, int* height)
+{
+    int w = 0, h = 0, col = 0;
+    uint64_t any = 0;
+    for (int i = 0; i < MAX_SHAPE_ROWS; i++) rows[i] = 0;
+    for (const char* c = text; ; c++) {
+        if (*c == '/' || *c == '\0') {
+            if (col > w) w = col;
+            h++;
+            col = 0;
+            if (*c == '\0') break;
+            if (h >= MAX_SHAPE_ROWS) return 0;
+            continue;
         }
+        if (col >= 64) return 0;
+        if (*c == '#') rows[h] |= 1ULL << col;
+        any |= rows[h];
+        col++;
     }
+    if (!any) return 0;
+    *width = w;
+    *height = h;
+    return 1;
+}
 
+int MaskIsSolid(const uint64_t rows[], int width, int height)
+{
+    for (int i = 0; i < height; i++) {
+        if (rows[i] != RowBits(width)) return 0;
+    }
+    return 1;
 }
 
-void CheckHunterBird(HUNTER* h , BIRD* b ){
-    int bird_width = strlen(b->symbol);
-    if(b->on_taxi == 1){
-        return;
+// Overlap of mask a (ah rows at ax, ay) with mask b (bh rows at bx, by), cell exact
+int MaskOverlap(const uint64_t* a, int ax, int ay, int ah, const uint64_t* b, int bx, int by, int bh)
+{
+    int y0 = ay > by ? ay : by;
+    int y1 = ay + ah < by + bh ? ay + ah : by + bh;
+    int d = bx - ax;
+    if (y0 >= y1 || d >= 64 || d <= -64) return 0;
+    const uint64_t* ra = a + (y0 - ay);
+    const uint64_t* rb = b + (y0 - by);
+    int n = y1 - y0;
+    int i = 0;
+    ROWS4 hit = {0, 0, 0, 0};
+    for (; i + 4 <= n; i += 4) {
+        ROWS4 va, vb;
+        memcpy(&va, ra + i, sizeof va);
+        memcpy(&vb, rb + i, sizeof vb);
+        hit |= d >= 0 ? (va >> d) & vb : va & (vb >> -d);
     }
-    else if ((int)h->y <= (int)b->y && (int)h->y + h->height >=  (int)b->y) {
-        if ((int)h->x <= (int)b->x + bird_width && (int)h->x + h->width >= (int)b->x) {
-            h->active = 0;
-            b->life -= h->damage;
-            ClearHunter(h);
-            if(b->life < 0) b->life = 0;
-        }
+    uint64_t any = hit[0] | hit[1] | hit[2] | hit[3];
+    for (; i < n; i++) {
+        any |= d >= 0 ? (ra[i] >> d) & rb[i] : ra[i] & (rb[i] >> -d);
     }
+    return any != 0;
 }
 
-void CheckHunterTaxi(HUNTER* h  , TAXI* t)
+// Rows of a hollow hunter against the part of a solid box it can reach
+int HunterMaskOverlapsBox(HUNTER* h, int hx, int hy, int x, int y, int width, int height)
 {
-    if (!t->active || !t->state) return ;
-    if (h->x < t->x + SAFE_ZONEW && h->x + h->width > t->x){
-        if(h->y < t->y + SAFE_ZONEH && h->y + h->height > t->y){
-            h->active = 0;
-            ClearHunter(h);
-        }
-    }
+    int y0 = y > hy ? y : hy;
+    int y1 = y + height < hy + h->height ? y + height : hy + h->height;
+    uint64_t box[MAX_SHAPE_ROWS];
+    for (int i = 0; i < y1 - y0; i++) box[i] = RowBits(width);
+    return MaskOverlap(h->mask, hx, hy, h->height, box, x, y0, y1 - y0);
 }
 
+// Hunter (hw x hh, solid or not) against a solid width x height box at (x, y). Solid
+// hunters stop at the box test, so they cost the same as the old rectangle comparison.
+ALWAYS_INLINE int HunterOverlapsBoxWith(HUNTER* h, int x, int y, int width, int height, int hw, int hh, int solid)
+{
+    int hx = (int)h->x;
+    int hy = (int)h->y;
+    if (hx >= x + width || hx + hw <= x) return 0;
+    if (hy >= y + height || hy + hh <= y) return 0;
+    if (solid) return 1;
+    return HunterMaskOverlapsBox(h, hx, hy, x, y, width, height);
+}
 
-void Bounce(HUNTER* h,BIRD* b ,TAXI* t, int width , int height){
-    int hit = 0;
-    double diffx = b->x - h->x;
-    double diffy = b->y - h->y;
-    double length = sqrt( (b->x - h->x)*(b->x - h->x) +  (b->y - h->y)*(b->y - h->y));
-    if (h->x < BORDER ) {
-            h->x = BORDER;
-            hit = 1;
-        if(t->active && t->state) h->dx = -h->dx;
-        } else if (h->x > width - BORDER - h->width) {
-            h->x = width - BORDER - h->width ;
-            hit = 1;
-        }
-        
-        if (h->y < BORDER) {
-            h->y = BORDER;
-            hit = 1;
-        } else if (h->y > height - BORDER  - h->height) {
-            h->y = height - BORDER - h->height;
-            hit = 1;
-        }
-    
-    // IF WE HIT A WALL: Stop and Start Timer
-        if (hit) {
-                h->dx = 0;
-                h->dy = 0;
-                h->wait_dash = 30; // Wait for 20 frames (approx 1 sec)
-                h->bounces--;
-            
-        }
+static inline int HunterOverlapsBox(HUNTER* h, int x, int y, int width, int height)
+{
+    return HunterOverlapsBoxWith(h, x, y, width, height, h->width, h->height, h->solid);
 }
 
-void MoveHunter(HUNTER* h , BIRD* b , TAXI* t){
-    if(!h->active) return;
-    CheckHunterBird(h , b);
-    if(!h->active) return;
-    CheckHunterTaxi(h,t);
-    if(!h->active) return;
-    ClearHunter(h);
-    if(h->wait_dash > 0){
-        h->wait_dash--;
-        if(h->wait_dash == 0){
-            double length = sqrt( (b->x - h->x)*(b->x - h->x) +  (b->y - h->y)*(b->y - h->y));
-            if (length != 0) {
-                h->dx = ((b->x - h->x) / length) ;
-                h->dy = ((b->y - h->y) / length) ;
-            }
-        }
-        DrawHunter(h);
+// Slab test of a point moving from r0 by v against [lo, hi) on one axis.
+// Narrows [*enter, *exit] to the part of the move spent inside.
+void SweepAxis(double r0, double v, double lo, double hi, double* enter, double* exit)
+{
+    if (v == 0) {
+        if (r0 < lo || r0 >= hi) *exit = -1;
         return;
     }
-    h->x += (h->dx * h->speed);
-    h->y += (h->dy * h->speed);
-    Bounce(h, b , t, h->win->cols, h->win->rows);
-    if (h->bounces < 0) {
-        h->active = 0;
-    } else {
-        DrawHunter(h);
-    }
-   
-    CheckHunterBird(h , b);
+    double t0 = (lo - r0) / v;
+    double t1 = (hi - r0) / v;
+    if (t0 > t1) { double tmp = t0; t0 = t1; t1 = tmp; }
+    if (t0 > *enter) *enter = t0;
+    if (t1 < *exit) *exit = t1;
 }
 
-void MoveMultipleHunter(HUNTER* h[] , BIRD* b , TAXI* t, WIN* w , GameConfig *config)
+// Swept version of HunterOverlapsBox for one frame: the hunter moves from (hx0, hy0) to its
+// current position while the box moves from (bx0, by0) to (bx1, by1). The relative move is
+// tested against the box first, then hollow shapes are checked cell by cell along it.
+ALWAYS_INLINE int SweptHunterHitsBoxWith(HUNTER* h, double hx0, double hy0, int bx0, int by0, int bx1, int by1,
+                                         int width, int height, int hw, int hh, int solid)
 {
-    for(int i = 0 ; i < config->hunter_num ; i++){
-        
-        if(h[i]->active){
-            MoveHunter(h[i] , b , t);
-        }else {
-            if(rand() % config->hunter_spawn_rate == 0){
-                ClearHunter(h[i]);
-                free(h[i]);
-                h[i] = InitHunter(w , b , config);
-                h[i]->active = 1;
-                
-            }
-        }
+    double hx1 = h->x, hy1 = h->y;
+    if (HunterOverlapsBoxWith(h, bx1, by1, width, height, hw, hh, solid)) return 1;
+    // hunter cells overlap the box while (hunter - box) is in [1 - hunter width, box width)
+    double rx = hx0 - bx0, ry = hy0 - by0;
+    double vx = (hx1 - bx1) - rx, vy = (hy1 - by1) - ry;
+    // most hunters are nowhere near the box, their whole move is outside it without any division
+    if (fmax(rx, rx + vx) < 1 - hw || fmin(rx, rx + vx) >= width) return 0;
+    if (fmax(ry, ry + vy) < 1 - hh || fmin(ry, ry + vy) >= height) return 0;
+    double enter = 0, exit = 1;
+    SweepAxis(rx, vx, 1 - hw, width, &enter, &exit);
+    SweepAxis(ry, vy, 1 - hh, height, &enter, &exit);
+    if (enter >= exit) return 0;
+    if (solid) return 1;
+    int hit = 0;
+    double step = fabs(vx) > fabs(vy) ? fabs(vx) : fabs(vy);
+    step = step > 1 ? 1 / step : 1;
+    for (double t = enter; t < exit && !hit; t += step) {
+        h->x = hx0 + t * (hx1 - hx0);
+        h->y = hy0 + t * (hy1 - hy0);
+        hit = HunterOverlapsBox(h, (int)lround(bx0 + t * (bx1 - bx0)), (int)lround(by0 + t * (by1 - by0)), width, height);
     }
+    h->x = hx1;
+    h->y = hy1;
+    return hit;
 }
 
-void free_hunter(HUNTER* h[] , GameConfig *config)
+int SweptHunterHitsBox(HUNTER* h, double hx0, double hy0, int bx0, int by0, int bx1, int by1, int width, int height)
 {
-    for(int i = 0 ; i < config->hunter_num ; i++){
-        free(h[i]);
-    }
+    return SweptHunterHitsBoxWith(h, hx0, hy0, bx0, by0, bx1, by1, width, height, h->width, h->height, h->solid);
 }
 
-//____________STARS_______________//
 
-//
-//  star.c
-//  project_test
-//
-//  Created by Mateusz Ciesielczyk on 29/11/2025.
-//
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ncurses.h>
+//============================//
+//  OBSTACLES                 //
+//==========================//
+
+// A map file draws the board as text, one line per row from the top border down: '#' (or
+// any other character but '.' and space) is a wall. Shorter or missing lines are open.
+// The rows the taxi drives through are always kept open, so it cannot carry a bird into a wall.
 
-STAR* InitStar(WIN* w)
+void FreeMap(MAP* m)
 {
-    STAR* s = (STAR*)malloc(sizeof(STAR));
-    s->win = w;
-    s->x = (rand() % (w->cols - 2)) + 1;
-    s->y = 1;
-    s->dx = 0;
-    s->dy = 1;
-    s->symbol = '*';
-    s->interval = (rand() % 4) + 2; //random intervaal 1 to 4 1-fast , 4 - slow
-    s->counter = s->interval; //starting counter at full interval
-    s->color = STAR_COLOR;
-    return s;
-    
+    if (!m) return;
+    free(m->solid);
+    free(m->sum);
+    free(m->lane);
+    free(m);
 }
 
-void InitMultipleStar(STAR* s[] , WIN* w)
+// An open cols x rows map, with room for star lanes if lanes is set. NULL if out of memory.
+MAP* NewMap(int cols, int rows, int lanes)
 {
-    for(int i = 0; i < MAX_STARS ; i++){
-        s[i] = InitStar(w);
+    MAP* m = (MAP*)calloc(1, sizeof(MAP));
+    if (!m) return NULL;
+    m->cols = cols;
+    m->rows = rows;
+    m->solid = (uint8_t*)calloc((size_t)cols * rows, 1);
+    m->sum = (int32_t*)calloc((size_t)(cols + 1) * (rows + 1), sizeof(int32_t));
+    m->lane = lanes ? (uint16_t*)calloc(cols, sizeof(uint16_t)) : NULL;
+    if (!m->solid || !m->sum || (lanes && !m->lane)) {
+        FreeMap(m);
+        return NULL;
     }
+    return m;
 }
 
-void DrawStar(STAR* s)
+// Rebuilds the summed-area table and the wall count from solid
+void SumMap(MAP* m)
 {
-    wattron(s->win->window, COLOR_PAIR(s->color));
-    mvwprintw(s->win->window , s->y , s->x , "%c" , s->symbol);
-    wattron(s->win->window, COLOR_PAIR(s->win->color));
-
+    int cols = m->cols, rows = m->rows;
+    // sum[(y + 1) * (cols + 1) + x + 1] counts the walls in rows 0..y and columns 0..x
+    for (int y = 0; y < rows; y++) {
+        int row = 0;
+        for (int x = 0; x < cols; x++) {
+            row += m->solid[y * cols + x];
+            m->sum[(y + 1) * (cols + 1) + x + 1] = m->sum[y * (cols + 1) + x + 1] + row;
+        }
+    }
+    m->walls = m->sum[rows * (cols + 1) + cols];
 }
 
-void DrawMultipleStar(STAR* s[])
+// Returns NULL if the file cannot be read
+MAP* LoadMap(const char* filename, int cols, int rows)
 {
-    for(int i =0 ; i<MAX_STARS ; i++){
-        DrawStar(s[i]);
+    FILE* file = fopen(filename, "r");
+    if (!file) return NULL;
+    MAP* m = NewMap(cols, rows, 0);
+    if (!m) {
+        fclose(file);
+        return NULL;
+    }
+    char line[1024];
+    int taxi_road = rows - SAFE_ZONEH - 1;
+    for (int y = 0; y < rows && fgets(line, sizeof(line), file); y++) {
+        for (int x = 0; x < cols && line[x] && line[x] != '\n' && line[x] != '\r'; x++) {
+            if (line[x] != '.' && line[x] != ' ' && y < taxi_road) m->solid[y * cols + x] = 1;
+        }
     }
+    fclose(file);
+    SumMap(m);
+    return m;
 }
 
-void ClearStar(STAR* s)
+// Walls in columns x0..x1 and rows y0..y1, the part outside the map counts as open
+static inline int MapWallsIn(const MAP* m, int x0, int y0, int x1, int y1)
 {
-    mvwprintw(s->win->window, s->y, s->x," "); //clear star for movement
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= m->cols) x1 = m->cols - 1;
+    if (y1 >= m->rows) y1 = m->rows - 1;
+    if (x0 > x1 || y0 > y1) return 0;
+    int stride = m->cols + 1;
+    return m->sum[(y1 + 1) * stride + x1 + 1] - m->sum[y0 * stride + x1 + 1]
+         - m->sum[(y1 + 1) * stride + x0] + m->sum[y0 * stride + x0];
 }
 
- void IfTouchedBird(STAR* s , BIRD* b)
+// 1 if a width x height box at (x, y) would overlap a wall
+static inline int MapBlocked(const MAP* m, int x, int y, int width, int height)
 {
-     int bird_width = strlen(b->symbol);
-     if(s->y == b->y || s->y == b-> y + 1){
-         if(s->x >= b->x  && s->x < b->x + bird_width){
-             ClearStar(s);
-             s->y = 1;
-             s->x = (rand() % (s->win->cols - 2)) + 1;
-             s->interval = (rand() % 4) + 1;
-             s->counter = s->interval;
-             b->score++;
-         }
-     }
- }
+    return MapWallsIn(m, x, y, x + width - 1, y + height - 1) != 0;
+}
 
-void MoveStar(STAR* s , BIRD* b)
+static inline int MapSolid(const MAP* m, int x, int y)
 {
-    s->counter--;
-    if(s->counter <= 0){
-        s->counter = s->interval;
-        ClearStar(s);
-        s->y +=1;
-        if(s->y >= s->win->rows - 1){
-            s->x = (rand() % (s->win->cols - 2)) + 1;
-            s->y = 1;
-            s->counter = s->interval;
+    return x >= 0 && y >= 0 && x < m->cols && y < m->rows && m->solid[y * m->cols + x];
+}
+
+void DrawMap(WIN* w)
+{
+    if (HEADLESS(w) || !w->map) return;
+    const MAP* m = w->map;
+    for (int y = 0; y < m->rows && y < w->rows; y++) {
+        for (int x = 0; x < m->cols && x < w->cols; x++) {
+            if (m->solid[y * m->cols + x]) mvwaddch(w->window, y, x, ' ' | A_REVERSE | COLOR_PAIR(MAP_WALL_COLOR));
         }
     }
-    IfTouchedBird(s , b);
-    DrawStar(s);
 }
-    
-void MoveMultipleStar(STAR* s[] , BIRD* b){
-    for(int i = 0 ; i < MAX_STARS ; i++){
-        MoveStar(s[i] , b);
+
+//============================//
+//  LEVEL PACKS               //
+//==========================//
+
+// A PACK file holds a whole campaign, levels played one after the other on the config's
+// board. It is mapped read only and only its header is read at startup; a level is
+// checked and decoded the first time it is entered, and the next one is decoded on a
+// background thread while the current one is played. Decoded levels live in PACK_SLOTS
+// slots allocated when the pack is opened, so memory does not grow with the pack.
+//
+// Layout, little endian:
+//   PACK_HEADER
+//   level records, each a PACK_RECORD followed by uint16_t lane[lanes] and PACK_RUN run[runs]
+//   PACK_ENTRY index[levels], at header.index
+#define PACK_MAGIC   0x4b505753u    // "SWPK"
+#define PACK_VERSION 1
+#define PACK_SLOTS   4              // decoded levels kept: the one played, the next and older ones
+
+typedef struct{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;           // sizeof(PACK_HEADER)
+    uint32_t levels;
+    uint16_t cols, rows;            // the board every level is drawn for
+    uint64_t index;                 // file offset of the PACK_ENTRY table
+} PACK_HEADER;
+
+typedef struct{
+    uint64_t offset;
+    uint32_t size;
+    uint32_t crc;                   // crc32 of the record
+} PACK_ENTRY;
+
+// One stage of the level's difficulty table, as LEVEL
+typedef struct{
+    uint16_t hunter_spawn_rate;
+    uint16_t hunter_bounces;
+    uint16_t hunter_num;
+    uint16_t hunter_speed;          // in thousandths, 0 keeps the config's speed
+} PACK_STAGE;
+
+typedef struct{
+    uint32_t star_quota;
+    uint32_t time_limit;            // milliseconds
+    uint16_t available_taxis;
+    uint16_t taxi_bonus;            // bonus stars on a taxi ride, at most BONUS_STARS
+    uint16_t lanes;                 // columns stars fall in, 0 for any column
+    uint16_t runs;                  // horizontal runs of wall cells
+    PACK_STAGE stage[NUM_LEVELS];
+} PACK_RECORD;
+
+typedef struct{
+    uint16_t y, x, length;
+} PACK_RUN;
+
+struct LEVEL_PACK{
+    const unsigned char* data;      // the whole file, mapped
+    size_t size;
+    int levels;
+    int cols, rows;
+    const PACK_ENTRY* index;
+    pthread_mutex_t lock;
+    pthread_cond_t loaded;          // a slot left PACK_LOADING
+    long clock;
+    long decodes, hits;             // levels decoded, and entered already decoded
+    PACK_LEVEL slot[PACK_SLOTS];
+};
+
+void ClosePack(LEVEL_PACK* p);
+
+// Maps filename for a cols x rows board. NULL with a message on stderr if it cannot be
+// read, is not a pack of this version or was made for another board.
+LEVEL_PACK* OpenPack(const char* filename, int cols, int rows)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open level pack %s\n", filename);
+        return NULL;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(PACK_HEADER)) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map level pack %s\n", filename);
+        return NULL;
+    }
+    // levels are far apart in a big pack, so read ahead only what PackPrefetch asks for
+    madvise(data, st.st_size, MADV_RANDOM);
+    const PACK_HEADER* h = (const PACK_HEADER*)data;
+    size_t size = st.st_size;
+    if (h->magic != PACK_MAGIC || h->version != PACK_VERSION || h->header_size != sizeof(PACK_HEADER) ||
+        h->levels < 1 || h->index > size || (size - h->index) / sizeof(PACK_ENTRY) < h->levels || h->index % 8) {
+        fprintf(stderr, "Error: %s is not a version %d level pack\n", filename, PACK_VERSION);
+        munmap(data, size);
+        return NULL;
     }
+    if (h->cols != cols || h->rows != rows) {
+        fprintf(stderr, "Error: level pack %s is for a %dx%d board, not %dx%d\n", filename, h->cols, h->rows, cols, rows);
+        munmap(data, size);
+        return NULL;
+    }
+    LEVEL_PACK* p = (LEVEL_PACK*)calloc(1, sizeof(LEVEL_PACK));
+    if (!p) {
+        munmap(data, size);
+        return NULL;
+    }
+    p->data = (const unsigned char*)data;
+    p->size = size;
+    p->levels = h->levels;
+    p->cols = cols;
+    p->rows = rows;
+    p->index = (const PACK_ENTRY*)(p->data + h->index);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->loaded, NULL);
+    for (int i = 0; i < PACK_SLOTS; i++) {
+        p->slot[i].store = NewMap(cols, rows, 1);
+        if (!p->slot[i].store) {
+            ClosePack(p);
+            return NULL;
+        }
+    }
+    return p;
 }
 
-void free_star(STAR* s[])
+// Level number of p into l, from the mapped record. Returns 0 if the record is damaged.
+static int DecodeLevel(const LEVEL_PACK* p , int number , PACK_LEVEL* l)
 {
-    for(int i = 0 ; i< MAX_STARS ; i++){
-        free(s[i]);
+    const PACK_ENTRY* e = &p->index[number - 1];
+    if (e->offset > p->size || e->size > p->size - e->offset || e->size < sizeof(PACK_RECORD) || e->offset % 8) return 0;
+    const unsigned char* data = p->data + e->offset;
+    if (crc32(0, data, e->size) != e->crc) return 0;
+    const PACK_RECORD* r = (const PACK_RECORD*)data;
+    if (e->size != sizeof(PACK_RECORD) + r->lanes * sizeof(uint16_t) + r->runs * sizeof(PACK_RUN)) return 0;
+    if (r->lanes > p->cols - 2 || r->star_quota < 1 || r->time_limit < 1) return 0;
+    l->star_quota = r->star_quota;
+    l->time_limit = r->time_limit / 1000.0;
+    l->available_taxis = r->available_taxis;
+    l->taxi_bonus = r->taxi_bonus > BONUS_STARS ? BONUS_STARS : r->taxi_bonus;
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        LEVEL* stage = &l->table.level[i];
+        stage->hunter_spawn_rate = r->stage[i].hunter_spawn_rate > 0 ? r->stage[i].hunter_spawn_rate : 1;
+        stage->hunter_bounces = r->stage[i].hunter_bounces;
+        stage->hunter_num = r->stage[i].hunter_num > MAX_HUNTERS ? MAX_HUNTERS : r->stage[i].hunter_num;
+        stage->hunter_speed = r->stage[i].hunter_speed / 1000.0;
     }
+    MAP* m = l->store;
+    const uint16_t* lane = (const uint16_t*)(r + 1);
+    m->lanes = 0;
+    for (int i = 0; i < r->lanes; i++) {
+        if (lane[i] < 1 || lane[i] > p->cols - 2) return 0;
+        m->lane[m->lanes++] = lane[i];
+    }
+    memset(m->solid, 0, (size_t)m->cols * m->rows);
+    const PACK_RUN* run = (const PACK_RUN*)(lane + r->lanes);
+    int taxi_road = m->rows - SAFE_ZONEH - 1;
+    for (int i = 0; i < r->runs; i++) {
+        if (run[i].y >= m->rows || run[i].x + run[i].length > m->cols) return 0;
+        if (run[i].y < taxi_road) memset(m->solid + run[i].y * m->cols + run[i].x, 1, run[i].length);
+    }
+    SumMap(m);
+    l->map = m->walls || m->lanes ? m : NULL;
+    return 1;
 }
 
-//____________TAXI_____________//
-
-//
-//  taxi.c
-//  project_test
-//
-//  Created by Mateusz Ciesielczyk on 03/12/2025.
-//
-
-TAXI* InitTaxi(WIN* w , GameConfig* config)
+// Caller holds the lock. The least recently entered slot nobody plays or loads, or NULL.
+static PACK_LEVEL* PackVictim(LEVEL_PACK* p)
 {
-    TAXI* t = (TAXI*)malloc(sizeof(TAXI));
-    t->win = w;
-    t->y = config->screen_height - SAFE_ZONEH - 1;
-    t->x = 2;
-    t->dx = 1;
-    t->dy = 0;
-    t->symbol = "o\\__/o" ;
-    t->speed = 1;
-    t->color = TAXI_COLOR;
-    t->counter_of_taxis = 0;
-    t->active = 0;
-    t->state = 0;
-    for(int i=0; i<BONUS_STARS; i++) t->bonusa[i] = 0;
-    return t;
+    PACK_LEVEL* victim = NULL;
+    for (int i = 0; i < PACK_SLOTS; i++) {
+        PACK_LEVEL* l = &p->slot[i];
+        if (l->users > 0 || l->state == PACK_LOADING) continue;
+        if (!victim || l->state == PACK_EMPTY || (victim->state != PACK_EMPTY && l->used < victim->used)) victim = l;
+    }
+    return victim;
 }
 
-void InitBonus(TAXI* t)
+// Caller holds the lock. The slot holding or loading number, or NULL.
+static PACK_LEVEL* PackFind(LEVEL_PACK* p , int number)
 {
-    for(int i = 0 ; i < BONUS_STARS ; i++){
-        t->bonusx[i] = t->x + 20 + (i*10);
-        t->bonusa[i] = 1;
+    for (int i = 0; i < PACK_SLOTS; i++) {
+        if (p->slot[i].number == number && p->slot[i].state != PACK_EMPTY) return &p->slot[i];
     }
+    return NULL;
 }
 
-void CheckTaxiBonus(TAXI* t , BIRD* b)
+// Level number (1 based) for a new game, decoded now unless it already was. The level
+// stays in memory until PackRelease. NULL if it is out of range, damaged, or every slot
+// is in use.
+const PACK_LEVEL* PackLevel(LEVEL_PACK* p , int number)
 {
-    for(int i = 0 ; i< BONUS_STARS ; i++){
-        if (t->bonusa[i] == 1) {
-            if(t->x + SAFE_ZONEW >= t->bonusx[i]){
-                b->score++;
-                t->bonusa[i] = 0;
-            }
-        }
+    if (number < 1 || number > p->levels) return NULL;
+    pthread_mutex_lock(&p->lock);
+    PACK_LEVEL* l = PackFind(p, number);
+    while (l && l->state == PACK_LOADING) {
+        pthread_cond_wait(&p->loaded, &p->lock);
+        l = PackFind(p, number);
+    }
+    if (l) {
+        p->hits++;
+    }
+    else if ((l = PackVictim(p)) != NULL) {
+        l->number = number;
+        l->state = DecodeLevel(p, number, l) ? PACK_READY : PACK_EMPTY;
+        p->decodes++;
+        if (l->state == PACK_EMPTY) l = NULL;
     }
+    if (l) {
+        l->users++;
+        l->used = ++p->clock;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return l;
 }
 
-void DrawBonus(TAXI* t)
+void PackRelease(LEVEL_PACK* p , const PACK_LEVEL* level)
 {
-    wattron(t->win->window, COLOR_PAIR(INJURED_BIRD));
-    for(int i = 0 ; i < BONUS_STARS ; i++)
-    {
-        if(t->bonusa[i] == 1){
-            mvwprintw(t->win->window, t->y + SAFE_ZONEH/2 , t->bonusx[i], "*");
+    if (!p || !level) return;
+    pthread_mutex_lock(&p->lock);
+    ((PACK_LEVEL*)level)->users--;
+    pthread_mutex_unlock(&p->lock);
+}
+
+typedef struct{
+    LEVEL_PACK* pack;
+    PACK_LEVEL* slot;
+} PACK_JOB;
+
+static void* PackPrefetchJob(void* arg)
+{
+    PACK_JOB job = *(PACK_JOB*)arg;
+    free(arg);
+    int ok = DecodeLevel(job.pack, job.slot->number, job.slot);
+    pthread_mutex_lock(&job.pack->lock);
+    job.slot->state = ok ? PACK_READY : PACK_EMPTY;
+    job.pack->decodes++;
+    pthread_cond_broadcast(&job.pack->loaded);
+    pthread_mutex_unlock(&job.pack->lock);
+    return NULL;
+}
+
+// Starts decoding level number on a background thread, so PackLevel finds it ready.
+// Does nothing if it is out of range, already decoded, or no slot is free.
+void PackPrefetch(LEVEL_PACK* p , int number)
+{
+    if (number < 1 || number > p->levels) return;
+    pthread_mutex_lock(&p->lock);
+    PACK_LEVEL* l = PackFind(p, number) ? NULL : PackVictim(p);
+    PACK_JOB* job = l ? (PACK_JOB*)malloc(sizeof(PACK_JOB)) : NULL;
+    pthread_t thread;
+    if (job) {
+        const PACK_ENTRY* e = &p->index[number - 1];
+        if (e->offset < p->size) {
+            // the record's pages are read in while the thread starts
+            uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+            uintptr_t start = ((uintptr_t)(p->data + e->offset)) & ~(page - 1);
+            uintptr_t end = (uintptr_t)p->data + (e->size < p->size - e->offset ? e->offset + e->size : p->size);
+            madvise((void*)start, end - start, MADV_WILLNEED);
+        }
+        job->pack = p;
+        job->slot = l;
+        l->number = number;
+        l->state = PACK_LOADING;
+        l->used = p->clock;
+        if (pthread_create(&thread, NULL, PackPrefetchJob, job) == 0) {
+            pthread_detach(thread);
+        }
+        else {
+            l->state = PACK_EMPTY;      // PackLevel decodes it when it is entered
+            free(job);
         }
     }
-    wattroff(t->win->window, COLOR_PAIR(INJURED_BIRD));
+    pthread_mutex_unlock(&p->lock);
 }
 
-void DrawTaxiSafeZone(TAXI* t)
+// Waits for the prefetches still running
+void ClosePack(LEVEL_PACK* p)
 {
-    // Only draw if the shield is active
-    if (!t->active || !t->state) return;
-   wattron(t->win->window, COLOR_PAIR(BIRD_COLOR)); // Use a specific color (e.g., Green or Cyan)
-
-        // Draw Top and Bottom borders
-    for (int i = 0; i < SAFE_ZONEW ; i++) {
-        // Top Edge
-        mvwprintw(t->win->window, t->y, t->x + i, "-");
-        // Bottom Edge
-        mvwprintw(t->win->window, t->y + SAFE_ZONEH - 1, t->x + i, "-");
+    if (!p) return;
+    pthread_mutex_lock(&p->lock);
+    for (int i = 0; i < PACK_SLOTS; i++) {
+        while (p->slot[i].state == PACK_LOADING) pthread_cond_wait(&p->loaded, &p->lock);
     }
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < PACK_SLOTS; i++) FreeMap(p->slot[i].store);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->loaded);
+    munmap((void*)p->data, p->size);
+    free(p);
+}
 
-        // Draw Left and Right borders
-    for (int i = 0; i < SAFE_ZONEH ; i++) {
-        // Left Edge
-        mvwprintw(t->win->window, t->y + i, t->x, "|");
-        // Right Edge
-        mvwprintw(t->win->window, t->y + i, t->x + SAFE_ZONEW - 1, "|");
+
+//============================//
+//  JOB SYSTEM                //
+//==========================//
+
+// A small work-stealing pool for the entity update phase of very large scenes.
+// JobsParallelFor() deals the chunks out to every worker's deque before waking them;
+// a worker pops its own deque from the bottom and, once empty, steals from the top
+// of the others (Chase-Lev deque, fixed size since a batch never grows).
+typedef void (*JOB_FN)(void* ctx, int chunk);
+
+typedef struct{
+    atomic_long top;
+    atomic_long bottom;
+    atomic_int* jobs;
+    long capacity;
+} JOB_DEQUE;
+
+typedef struct{
+    int workers;            // including the thread calling JobsParallelFor
+    int started;            // threads[1 .. started] are running
+    pthread_t* threads;
+    JOB_DEQUE* deques;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int generation;         // bumped for every batch, under lock
+    int quit;
+    JOB_FN fn;
+    void* ctx;
+    atomic_int pending;     // chunks of the batch not finished yet
+    atomic_int busy;        // workers inside JobsRun
+} JOB_SYSTEM;
+
+typedef struct{
+    JOB_SYSTEM* js;
+    int id;
+} JOB_WORKER;
+
+// entity updates use this pool when set (headless scenes only, ncurses is single threaded)
+static JOB_SYSTEM* entity_jobs = NULL;
+
+int JobTake(JOB_DEQUE* q, int* job)
+{
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return 0;
     }
-    wattroff(t->win->window, COLOR_PAIR(BIRD_COLOR));
+    *job = atomic_load_explicit(&q->jobs[b % q->capacity], memory_order_relaxed);
+    if (t == b) {
+        // last job: race the thieves for it
+        int won = atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+    return 1;
 }
 
-void DrawTaxi(TAXI* t)
+int JobSteal(JOB_DEQUE* q, int* job)
 {
-    int taxi_width = strlen(t->symbol);
-    wattron(t->win->window, COLOR_PAIR(t->color));
-    wattron(t->win->window, A_BOLD);
-    mvwprintw(t->win->window , t->y + SAFE_ZONEH - 2, t->x + SAFE_ZONEW/2 - taxi_width/2, "%s" , t->symbol);
-    wattroff(t->win->window, A_BOLD);
-    wattroff(t->win->window, COLOR_PAIR(t->win->color));
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b) return 0;
+    *job = atomic_load_explicit(&q->jobs[t % q->capacity], memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
 }
 
-void ClearTaxi(TAXI* t)
+void JobsRun(JOB_SYSTEM* js, int self)
 {
-    for(int i = 0; i < SAFE_ZONEH; i++) {
-            for(int j = 0; j < SAFE_ZONEW; j++) {
-                 mvwprintw(t->win->window, t->y + i, t->x + j, " ");
-            }
+    int job;
+    unsigned int victim = self;
+    while (atomic_load_explicit(&js->pending, memory_order_acquire) > 0) {
+        int got = JobTake(&js->deques[self], &job);
+        for (int i = 1; !got && i < js->workers; i++) {
+            got = JobSteal(&js->deques[(victim + i) % js->workers], &job);
         }
+        if (!got) {
+            victim = victim * 1103515245u + 12345u; // next round starts at another victim
+            continue;
+        }
+        js->fn(js->ctx, job);
+        atomic_fetch_sub_explicit(&js->pending, 1, memory_order_acq_rel);
+    }
 }
 
-void SafeBirdTaxi(TAXI* t , BIRD* b)
+void FreeHunterGrid(void);
+
+void* JobWorker(void* arg)
 {
-    int bird_width = strlen(b->symbol);
-    if (b->x + bird_width >= t->x && b->x <= t->x + SAFE_ZONEW) {
-        if(b->y >= t->y && b->y <= t->y + SAFE_ZONEH) {
-            t->state = 1;    // Switch Taxi to MOVING mode
-            b->on_taxi = 1;  // Tell Bird it is riding
-            InitBonus(t);
+    JOB_WORKER* w = (JOB_WORKER*)arg;
+    JOB_SYSTEM* js = w->js;
+    int seen = 0;
+    while (1) {
+        pthread_mutex_lock(&js->lock);
+        while (js->generation == seen && !js->quit) pthread_cond_wait(&js->wake, &js->lock);
+        seen = js->generation;
+        if (js->quit) {
+            pthread_mutex_unlock(&js->lock);
+            break;
         }
+        atomic_fetch_add(&js->busy, 1);
+        pthread_mutex_unlock(&js->lock);
+        JobsRun(js, w->id);
+        atomic_fetch_sub(&js->busy, 1);
     }
+    FreeHunterGrid();   // a worker that stepped sessions may have built one
+    free(w);
+    return NULL;
 }
 
-void MoveTaxi(TAXI* t, BIRD* b)
+void JobsDestroy(JOB_SYSTEM* js);
+
+// A pool of workers threads (the caller is one of them) for batches of up to max_chunks chunks.
+// NULL if memory runs out or a thread cannot be started, with nothing left running.
+JOB_SYSTEM* JobsCreate(int workers, int max_chunks)
 {
-    if (!t->active) return;
-    ClearTaxi(t);
-    
-    if(t->state == 0) //waiting mode
-    {
-        t->x = 2;
-        t->y = t->win->rows - SAFE_ZONEH - 1;
-        DrawTaxi(t);
-        SafeBirdTaxi(t ,b);
+    JOB_SYSTEM* js = (JOB_SYSTEM*)calloc(1, sizeof(JOB_SYSTEM));
+    if (!js) return NULL;
+    js->workers = workers < 1 ? 1 : workers;
+    pthread_mutex_init(&js->lock, NULL);
+    pthread_cond_init(&js->wake, NULL);
+    atomic_init(&js->pending, 0);
+    atomic_init(&js->busy, 0);
+    js->threads = (pthread_t*)malloc(js->workers * sizeof(pthread_t));
+    js->deques = (JOB_DEQUE*)calloc(js->workers, sizeof(JOB_DEQUE));
+    if (!js->threads || !js->deques) {
+        JobsDestroy(js);
+        return NULL;
     }
-    else if(t->state == 1){
-        t->x += (t->dx * t->speed);
-        ClearBird(b);
-        if (b->life < 100) {
-            b->life++;  // +1 HP every frame (gradual healing)
+    for (int i = 0; i < js->workers; i++) {
+        js->deques[i].capacity = max_chunks;
+        js->deques[i].jobs = (atomic_int*)calloc(max_chunks, sizeof(atomic_int));
+        if (!js->deques[i].jobs) {
+            JobsDestroy(js);
+            return NULL;
         }
-        CheckTaxiBonus(t , b);
-        int bird_width = strlen(b->symbol);
-        b->x = t->x + (SAFE_ZONEW / 2) - (bird_width / 2); // attaching the bird to sit on the taxi
-        b->y = t->y + SAFE_ZONEH - 3;
-        if(t->x >= t->win->cols - SAFE_ZONEW - 1){
-            t->active = 0;
-            t->state = 0;
-            b->on_taxi = 0;
-            ClearTaxi(t);
-            return;
+    }
+    for (int i = 1; i < js->workers; i++) {
+        JOB_WORKER* w = (JOB_WORKER*)malloc(sizeof(JOB_WORKER));
+        if (w) {
+            w->js = js;
+            w->id = i;
         }
-        DrawTaxiSafeZone(t);
-        DrawTaxi(t);
-        DrawBonus(t);
+        if (!w || pthread_create(&js->threads[i], NULL, JobWorker, w) != 0) {
+            free(w);
+            JobsDestroy(js);
+            return NULL;
+        }
+        js->started = i;
     }
+    return js;
 }
 
+// Stops the workers that were started and frees js, which may be only partly set up
+void JobsDestroy(JOB_SYSTEM* js)
+{
+    pthread_mutex_lock(&js->lock);
+    js->quit = 1;
+    pthread_cond_broadcast(&js->wake);
+    pthread_mutex_unlock(&js->lock);
+    for (int i = 1; i <= js->started; i++) pthread_join(js->threads[i], NULL);
+    for (int i = 0; js->deques && i < js->workers; i++) free(js->deques[i].jobs);
+    pthread_mutex_destroy(&js->lock);
+    pthread_cond_destroy(&js->wake);
+    free(js->deques);
+    free(js->threads);
+    free(js);
+}
 
-//__________RANKING SYSTEM_____________//
+// Runs fn(ctx, 0 .. chunks-1) on all workers and returns when every chunk is done.
+// chunks must not exceed the max_chunks given to JobsCreate.
+void JobsParallelFor(JOB_SYSTEM* js, int chunks, JOB_FN fn, void* ctx)
+{
+    pthread_mutex_lock(&js->lock);
+    // a worker that woke late for the last batch may still be looking for work
+    while (atomic_load(&js->busy) > 0) sched_yield();
+    js->fn = fn;
+    js->ctx = ctx;
+    // worker i gets a contiguous run of chunks, the others steal when they run dry
+    for (int i = 0; i < js->workers; i++) {
+        JOB_DEQUE* q = &js->deques[i];
+        int first = (long)chunks * i / js->workers;
+        int last = (long)chunks * (i + 1) / js->workers;
+        for (int c = first; c < last; c++) atomic_store_explicit(&q->jobs[last - 1 - c], c, memory_order_relaxed);
+        atomic_store_explicit(&q->top, 0, memory_order_relaxed);
+        atomic_store_explicit(&q->bottom, last - first, memory_order_relaxed);
+    }
+    atomic_store_explicit(&js->pending, chunks, memory_order_release);
+    js->generation++;
+    pthread_cond_broadcast(&js->wake);
+    pthread_mutex_unlock(&js->lock);
 
+    JobsRun(js, 0);
+    while (atomic_load_explicit(&js->pending, memory_order_acquire) > 0 || atomic_load(&js->busy) > 0) sched_yield();
+}
 
-//
-//  ranking.c
-//  project_test
-//
-//  Created by Mateusz Ciesielczyk on 05/12/2025.
-//
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ncurses.h>
 
-//helper function for sorting the rankings
-int CompareScores(const void* x, const void* y){
-    RANKING* scorex = (RANKING*)x;
-    RANKING* scorey = (RANKING*)y;
-    return scorey->total_score - scorex->total_score;
+//============================//
+//  EVENT TRACE               //
+//==========================//
+
+// Always-on record of what happened in a game. TraceEvent() appends a fixed size binary
+// event to a ring owned by the calling thread (single producer, no locks); a background
+// thread drains every ring into the trace file. When a ring is full the event is dropped
+// and counted rather than making the game wait. ./game --trace-json converts the file.
+#define TRACE_MAGIC       "SWTRACE1"
+#define TRACE_RING_EVENTS 16384      // per thread, power of two
+#define TRACE_FLUSH_US    10000      // how often the writer drains the rings
+#define TRACE_SYNC_NS     1000000000ULL  // how often it writes a clock sync
+
+enum {
+    TRACE_CLOCK_SYNC = 0,   // written by the flusher: a/b = low/high 32 bits of CLOCK_MONOTONIC ns
+    TRACE_FRAME_BEGIN,
+    TRACE_FRAME_END,
+    TRACE_STAR_COLLECTED,   // entity = star, a/b = x/y
+    TRACE_BIRD_DAMAGED,     // entity = hunter, a = damage, b/c = bird x/y
+    TRACE_HUNTER_SPAWNED,   // entity = hunter, a/b = x/y
+    TRACE_TAXI_BOARDED,     // a/b = bird x/y
+    TRACE_TAXI_FINISHED,    // a = bonus stars collected
+    TRACE_DROPPED,          // written by the flusher: a = events lost since the last one
+    TRACE_EVENT_TYPES
+};
+
+typedef struct{
+    uint64_t time;      // raw clock, see TraceClock
+    uint32_t tick;      // game frame
+    uint16_t type;
+    uint16_t thread;
+    int32_t entity;
+    int32_t a, b, c;
+} TRACE_EVENT;
+
+typedef struct TRACE_RING{
+    TRACE_EVENT events[TRACE_RING_EVENTS];
+    atomic_uint head;           // next slot the owner writes
+    atomic_uint tail;           // next slot the flusher reads
+    atomic_uint dropped;
+    uint16_t thread;
+    struct TRACE_RING* next;    // all rings, newest first
+} TRACE_RING;
+
+typedef struct{
+    FILE* file;
+    pthread_t flusher;
+    atomic_int running;
+    _Atomic(TRACE_RING*) rings;
+    atomic_int threads;
+} TRACE;
+
+static TRACE tracer;
+static _Thread_local TRACE_RING* trace_ring = NULL;
+static _Thread_local uint32_t trace_tick = 0;   // set by GameTick
+static _Thread_local int trace_muted = 0;        // set while this thread plays a WORLD
+
+static inline uint64_t TraceClock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
 }
 
-int CalculateScore(BIRD* b , GameConfig* config)
+uint64_t TraceWallNs(void)
 {
-    return (int)(config->time_limit * 50) + b->score * 100 + b->life * 5 + config->curr_level * 500 ;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
-int FindPlayerIndex(RANKING scores[], int count, const char* name) {
-    for (int i = 0; i < count; i++) {
-        if (strcmp(scores[i].name, name) == 0) {
-            return i; // Player found at this index
-        }
+// The calling thread's ring, NULL when out of memory (its events are then lost)
+TRACE_RING* TraceRegisterThread(void)
+{
+    TRACE_RING* ring = (TRACE_RING*)calloc(1, sizeof(TRACE_RING));
+    if (!ring) return NULL;
+    ring->thread = (uint16_t)atomic_fetch_add(&tracer.threads, 1);
+    ring->next = atomic_load(&tracer.rings);
+    while (!atomic_compare_exchange_weak(&tracer.rings, &ring->next, ring)) {
     }
-    return -1; // Player not found
+    trace_ring = ring;
+    return ring;
 }
 
-void SetPlayerStats(RANKING* r, BIRD* b, GameConfig* cfg, double t_used, int score) {
-    r->stars_collected = b->score;
-    r->star_quota = cfg->star_quota;
-    r->time_used = t_used;
-    r->total_score = score;
+static inline void TraceEvent(int type, int entity, int a, int b, int c)
+{
+    if (trace_muted || !atomic_load_explicit(&tracer.running, memory_order_relaxed)) return;
+    TRACE_RING* ring = trace_ring ? trace_ring : TraceRegisterThread();
+    if (!ring) return;
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= TRACE_RING_EVENTS) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    TRACE_EVENT* e = &ring->events[head & (TRACE_RING_EVENTS - 1)];
+    e->time = TraceClock();
+    e->tick = trace_tick;
+    e->type = (uint16_t)type;
+    e->thread = ring->thread;
+    e->entity = entity;
+    e->a = a;
+    e->b = b;
+    e->c = c;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
 }
 
-void UpdateRanking(BIRD* b, GameConfig* config, double time_used, int total_score)
+void TraceWriteSync(void)
 {
-    RANKING scores[NUM_PLAYERS + 1];
-    int count = 0;
-    FILE* file = fopen(RANKING_FILE, "r");
-    if(file){
-        while(count < NUM_PLAYERS && fscanf(file, "%s %d %d %lf %d",scores[count].name,&scores[count].stars_collected,&scores[count].star_quota,&scores[count].time_used,&scores[count].total_score) == 5){
-            count++;
+    TRACE_EVENT e = {0};
+    uint64_t ns = TraceWallNs();
+    e.time = TraceClock();
+    e.type = TRACE_CLOCK_SYNC;
+    e.a = (int32_t)(uint32_t)ns;
+    e.b = (int32_t)(uint32_t)(ns >> 32);
+    fwrite(&e, sizeof(e), 1, tracer.file);
+}
+
+void TraceDrain(void)
+{
+    for (TRACE_RING* ring = atomic_load(&tracer.rings); ring; ring = ring->next) {
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        while (tail != head) {
+            // copy up to the end of the buffer, then wrap
+            unsigned int start = tail & (TRACE_RING_EVENTS - 1);
+            unsigned int count = head - tail;
+            if (count > TRACE_RING_EVENTS - start) count = TRACE_RING_EVENTS - start;
+            fwrite(&ring->events[start], sizeof(TRACE_EVENT), count, tracer.file);
+            tail += count;
+            atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        }
+        unsigned int dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+        if (dropped) {
+            TRACE_EVENT e = {0};
+            e.time = TraceClock();
+            e.type = TRACE_DROPPED;
+            e.thread = ring->thread;
+            e.a = (int32_t)dropped;
+            fwrite(&e, sizeof(e), 1, tracer.file);
         }
-        fclose(file);
     }
-    int found_index = FindPlayerIndex(scores, count, config->player_name);
-    if(found_index != -1) {
-        // Player found! Only update if the NEW score is better.
-        if(total_score > scores[found_index].total_score) {
-            SetPlayerStats(&scores[found_index], b, config, time_used, total_score);
+}
+
+void* TraceFlusher(void* arg)
+{
+    (void)arg;
+    uint64_t synced = TraceWallNs();    // TraceStart wrote one
+    while (atomic_load(&tracer.running)) {
+        usleep(TRACE_FLUSH_US);
+        TraceDrain();
+        if (TraceWallNs() - synced >= TRACE_SYNC_NS) {
+            TraceWriteSync();
+            synced = TraceWallNs();
         }
     }
-    else{
-        strcpy(scores[count].name, config->player_name);
-        SetPlayerStats(&scores[count], b, config, time_used, total_score);
-        count++;
+    return NULL;
+}
+
+// Starts recording into filename, returns 0 if the file cannot be written
+int TraceStart(const char* filename)
+{
+    tracer.file = fopen(filename, "wb");
+    if (!tracer.file) return 0;
+    uint32_t header[2] = { 1, sizeof(TRACE_EVENT) };  // version, event size
+    fwrite(TRACE_MAGIC, 1, 8, tracer.file);
+    fwrite(header, sizeof(header), 1, tracer.file);
+    TraceWriteSync();
+    atomic_store(&tracer.running, 1);
+    pthread_create(&tracer.flusher, NULL, TraceFlusher, NULL);
+    return 1;
+}
+
+// Stops recording once every thread that traced is done with its events
+void TraceStop(void)
+{
+    if (!tracer.file) return;
+    atomic_store(&tracer.running, 0);
+    pthread_join(tracer.flusher, NULL);
+    TraceDrain();
+    TraceWriteSync();
+    fclose(tracer.file);
+    tracer.file = NULL;
+    TRACE_RING* ring = atomic_exchange(&tracer.rings, NULL);
+    while (ring) {
+        TRACE_RING* next = ring->next;
+        free(ring);
+        ring = next;
     }
-    
-    qsort(scores, count, sizeof(RANKING), CompareScores);
-    file = fopen(RANKING_FILE, "w");
-        if (!file) return;
-    int limit;
-    if (count < NUM_PLAYERS) {
-        limit = count;
-    } else {
-        limit = NUM_PLAYERS;
+    trace_ring = NULL;
+}
+
+
+//============================//
+//  PERFORMANCE COUNTERS      //
+//==========================//
+
+// Hardware counters (perf_event_open) split by frame phase, for --perf and --stress.
+// PerfStartTick() begins a tick and PerfPhase(p) charges everything since the last mark
+// to phase p. Counters only see the thread that opened them. Counters the kernel or
+// VM does not offer are left out, and with none at all only wall time is measured.
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1_MISSES, PERF_LLC_MISSES,
+       PERF_BRANCH_MISSES, PERF_CONTEXT_SWITCHES, PERF_COUNTERS };
+enum { PHASE_INPUT, PHASE_BIRD, PHASE_STARS, PHASE_HUNTERS, PHASE_HEAT, PHASE_EXPORT, PHASE_RENDER, PHASE_RECORD, PERF_PHASES };
+#define PERF_WALL PERF_COUNTERS   // extra slot next to the counters: wall time in ns
+
+typedef struct{
+    int group;                          // group leader fd, -1 if no counter could be opened
+    int fd[PERF_COUNTERS];
+    int slot[PERF_COUNTERS];            // position in the group read, -1 if not available
+    int opened;
+    int error;                          // errno of the first counter that failed
+    uint64_t last[PERF_COUNTERS + 1];   // values at the last mark
+    uint64_t total[PERF_PHASES][PERF_COUNTERS + 1];
+    long ticks;
+} PERF;
+
+static _Thread_local PERF* phase_perf = NULL;   // NULL unless this thread is measured
+
+static const struct { uint32_t type; uint64_t config; const char* name; } PERF_EVENTS[PERF_COUNTERS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instr" },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), "L1d miss" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "LLC miss" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "br miss" },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "ctx sw" },
+};
+static const char* PHASE_NAMES[PERF_PHASES] = { "input", "bird+taxi", "stars", "hunters", "heatmap", "export", "render", "record" };
+
+int PerfOpenCounter(int counter, int group)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_EVENTS[counter].type;
+    attr.config = PERF_EVENTS[counter].config;
+    attr.disabled = (group == -1);
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    if (fd < 0 && errno == EACCES) {
+        attr.exclude_kernel = 1;   // perf_event_paranoid only allows user space counting
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
     }
-    for (int i = 0; i < limit; i++) {
-        fprintf(file, "%s %d %d %.2f %d\n",
-                scores[i].name,
-                scores[i].stars_collected,
-                scores[i].star_quota,
-                scores[i].time_used,
-                scores[i].total_score);
+    return fd;
+}
+
+// Opens every counter it can as one group on the calling thread.
+// Returns the number of counters opened, 0 means wall time only.
+int PerfOpen(PERF* p)
+{
+    memset(p, 0, sizeof(*p));
+    p->group = -1;
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        p->fd[i] = PerfOpenCounter(i, p->group);
+        p->slot[i] = -1;
+        if (p->fd[i] < 0) {
+            if (!p->error) p->error = errno;
+            continue;
+        }
+        if (p->group == -1) p->group = p->fd[i];
+        p->slot[i] = p->opened++;
     }
-    fclose(file);
-    
+    if (p->group != -1) {
+        ioctl(p->group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(p->group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    return p->opened;
 }
 
-void ShowRanking(WINDOW* ranking, int rows, int cols)
+void PerfClose(PERF* p)
 {
-    int h = 16, w = 60;
-    int y = (rows - h) / 2;
-    int x = (cols - w) / 2;
-    WINDOW* win = newwin(h, w, y, x);
-    box(win, 0, 0);
-    wbkgd(win, COLOR_PAIR(1));
-    wattron(win, A_BOLD | A_UNDERLINE);
-    mvwprintw(win, 1, 20, "BEST OF THE BEST");
-    wattroff(win, A_BOLD | A_UNDERLINE);
-    wattron(win, A_REVERSE);
-    mvwprintw(win, 3, 2, "RK  NAME         STARS   TIME(s)  SCORE  ");
-    wattroff(win, A_REVERSE);
-    FILE* file = fopen(RANKING_FILE, "r");
-    char name[50];
-    int s, q, score;
-    double t;
-    int line = 4;
-    if (file) {
-           int rank = 1;
-           while (fscanf(file, "%s %d %d %lf %d", name, &s, &q, &t, &score) == 5 && rank <= NUM_PLAYERS) {
-               mvwprintw(win, line, 2, "#%-2d %-12s %2d/%-2d   %6.1f   %6d",
-                         rank, name, s, q, t, score);
-               line++;
-               rank++;
-           }
-           fclose(file);
-       }else {
-           mvwprintw(win, 6, 20, "No Records Yet!");
-       }
-    mvwprintw(win, h-2, 18, "Press Any Key");
-    wrefresh(win);
-    nodelay(win, FALSE);
-    wgetch(win);
-    delwin(win);
-    
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        if (p->fd[i] >= 0) close(p->fd[i]);
+        p->fd[i] = -1;
+    }
+    p->group = -1;
 }
 
+// Current value of every counter plus the wall clock. Counts are scaled up when the
+// kernel had to multiplex the group with other events.
+void PerfRead(PERF* p, uint64_t now[])
+{
+    now[PERF_WALL] = TraceWallNs();
+    if (p->group == -1) return;
+    uint64_t buf[3 + PERF_COUNTERS];   // nr, time enabled, time running, values
+    if (read(p->group, buf, sizeof(buf)) < (ssize_t)(3 * sizeof(uint64_t))) return;
+    double scale = buf[2] ? (double)buf[1] / (double)buf[2] : 0.0;
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        if (p->slot[i] >= 0) now[i] = (uint64_t)(buf[3 + p->slot[i]] * scale);
+    }
+}
 
+static inline void PerfPhase(int phase)
+{
+    PERF* p = phase_perf;
+    if (!p) return;
+    uint64_t now[PERF_COUNTERS + 1] = {0};
+    PerfRead(p, now);
+    for (int i = 0; i <= PERF_COUNTERS; i++) {
+        p->total[phase][i] += now[i] - p->last[i];
+        p->last[i] = now[i];
+    }
+}
 
+// Begins a tick, whatever happened since the last phase (sleeping between frames) is not counted
+static inline void PerfStartTick(void)
+{
+    PERF* p = phase_perf;
+    if (!p) return;
+    PerfRead(p, p->last);
+    p->ticks++;
+}
 
+// Per tick averages of every phase that was measured
+void PerfReport(const PERF* p, FILE* out)
+{
+    if (p->ticks == 0) return;
+    if (p->opened == 0) {
+        fprintf(out, "Hardware counters unavailable (%s), wall time only\n", strerror(p->error));
+    }
+    else if (p->opened < PERF_COUNTERS) {
+        fprintf(out, "Some counters unavailable (%s):", strerror(p->error));
+        for (int i = 0; i < PERF_COUNTERS; i++) {
+            if (p->slot[i] < 0) fprintf(out, " %s", PERF_EVENTS[i].name);
+        }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "per tick over %ld ticks\n%-10s %9s", p->ticks, "phase", "us");
+    for (int i = 0; i < PERF_COUNTERS; i++) fprintf(out, " %10s", PERF_EVENTS[i].name);
+    fprintf(out, " %6s\n", "IPC");
+    for (int ph = 0; ph < PERF_PHASES; ph++) {
+        if (p->total[ph][PERF_WALL] == 0) continue;   // phase not part of this run
+        fprintf(out, "%-10s %9.2f", PHASE_NAMES[ph], p->total[ph][PERF_WALL] / 1000.0 / p->ticks);
+        for (int i = 0; i < PERF_COUNTERS; i++) {
+            if (p->slot[i] < 0) fprintf(out, " %10s", "-");
+            else fprintf(out, " %10.1f", (double)p->total[ph][i] / p->ticks);
+        }
+        if (p->slot[PERF_CYCLES] >= 0 && p->slot[PERF_INSTRUCTIONS] >= 0 && p->total[ph][PERF_CYCLES])
+            fprintf(out, " %6.2f\n", (double)p->total[ph][PERF_INSTRUCTIONS] / p->total[ph][PERF_CYCLES]);
+        else
+            fprintf(out, " %6s\n", "-");
+    }
+}
 
 
-//--------------------------------------//
-//          CONFIGURATION INPUT
-//--------------------------------------//
+//============================//
+//  SESSION RECORDING         //
+//==========================//
 
+// Records what the terminal shows as an asciicast v2 file (gzip compressed, play it with
+// zcat session.cast.gz | asciinema play -). After every frame RecordFrame() copies the
+// screen cells into a free slot of a ring (single producer, single consumer, no locks).
+// A writer thread turns the difference to the previous frame into escape sequences and
+// compresses them to disk. When the writer falls behind, frames are dropped and counted,
+// and the next written frame still shows everything that changed.
+#define RECORD_SLOTS   32       // frames in flight, power of two
+#define RECORD_POLL_US 5000     // how often the writer looks for new frames
+#define RECORD_EVENT   (32 * 1024)   // bytes of output kept per frame, larger diffs are flushed in parts
+#define RECORD_PAIRS   16       // color pairs the game uses, see Start()
 
-//Loads configuration of a text file
-//will return 1 if succesfull and 0 if failed
+typedef struct{
+    uint64_t time;      // CLOCK_MONOTONIC ns when the frame was copied
+    chtype* cells;      // rows x (cols + 1), winchnstr adds a 0 after every row
+} RECORD_FRAME;
 
-int LoadConfig(const char* filename, GameConfig* config);
-void DefaultValues(GameConfig* config);
+typedef struct{
+    gzFile file;
+    pthread_t writer;
+    atomic_int running;
+    int rows, cols;
+    uint64_t start;
+    RECORD_FRAME frames[RECORD_SLOTS];
+    atomic_uint head;           // next slot the game fills
+    atomic_uint tail;           // next slot the writer reads
+    atomic_uint dropped;
+    unsigned int written;
+    chtype* shown;              // cells as of the last written frame
+    char* event;                // escape sequences of one frame, JSON escaped
+    short pair_fg[RECORD_PAIRS], pair_bg[RECORD_PAIRS];
+} RECORDER;
+
+static RECORDER recorder;
+
+// Game thread: copies the screen as last refreshed. Never waits for the writer.
+void RecordFrame(void)
+{
+    if (!atomic_load_explicit(&recorder.running, memory_order_relaxed)) return;
+    unsigned int head = atomic_load_explicit(&recorder.head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&recorder.tail, memory_order_acquire) >= RECORD_SLOTS) {
+        atomic_fetch_add_explicit(&recorder.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    RECORD_FRAME* f = &recorder.frames[head & (RECORD_SLOTS - 1)];
+    f->time = TraceWallNs();
+    // curscr's cursor is where ncurses thinks the terminal cursor is, so put it back
+    int cy, cx;
+    getyx(curscr, cy, cx);
+    for (int y = 0; y < recorder.rows; y++) {
+        mvwinchnstr(curscr, y, 0, f->cells + y * (recorder.cols + 1), recorder.cols);
+    }
+    wmove(curscr, cy, cx);
+    atomic_store_explicit(&recorder.head, head + 1, memory_order_release);
+}
 
-void AssignValue(GameConfig* config, const char* key, int value)
+// gzprintf truncates long lines, so the event text goes through gzwrite
+void RecordEvent(double at, int len)
 {
-    if (strcmp(key, "SCREEN_WIDTH") == 0) config->screen_width = value;
-    else if (strcmp(key, "SCREEN_HEIGHT") == 0) config->screen_height = value;
-    else if (strcmp(key, "STAR_QUOTA") == 0) config->star_quota = value;
-    else if (strcmp(key, "TIME_LIMIT") == 0) config->time_limit = value;
-    else if (strcmp(key, "SWALLOW_SPEED_MIN") == 0) config->swallow_speed_min = value;
-    else if (strcmp(key, "SWALLOW_SPEED_MAX") == 0) config->swallow_speed_max = value;
-    else if (strcmp(key, "HUNTER_SPAWN_RATE") == 0) config->hunter_spawn_rate = value;
-    else if (strcmp(key, "SEED") == 0) config->seed = value;
-    else if (strcmp(key, "DAMAGE_PENALTY") == 0) config->damage_penalty = value;
-    else if (strcmp(key, "HUNTER_SPEED") == 0) config->hunter_speed = value;
-    else if (strcmp(key, "LEVEL") == 0) config->curr_level = value;
-    else if (strcmp(key, "HUNTER_BOUNCES") == 0) config->hunter_bounces = value;
-    else if (strcmp(key, "HUNTER_NUM") == 0) config->hunter_num = value;
-    else if (strcmp(key, "AVAILABLE_TAXIS") == 0) config->available_taxis = value;
+    gzprintf(recorder.file, "[%.6f, \"o\", \"", at);
+    gzwrite(recorder.file, recorder.event, len);
+    gzputs(recorder.file, "\"]\n");
 }
 
-int LoadConfig(const char* filename, GameConfig* config) {
-    FILE* file = fopen(filename, "r");
-    
-    // Safety check: Make sure the file actually exists
-    if (!file) {
-        fprintf(stderr, "Error: Could not open config file %s\n", filename);
-        return 0; // Return 0 to indicate failure
+// Appends text to the current "o" event, written out when the buffer is nearly full
+void RecordPut(int* len, double at, const char* text, int n)
+{
+    if (*len + n > RECORD_EVENT - 16) {
+        RecordEvent(at, *len);
+        *len = 0;
     }
-    DefaultValues(config);
-    char key[MAX_COMMAND_SIZE];
-    int value;
-    while (fscanf(file, "%s", key) == 1) {
-        if (strcmp(key, "PLAYER_NAME") == 0) {
-            fscanf(file, "%s", config->player_name);}
-        else if (strcmp(key, "HUNTER_SPEED") == 0) {
-            fscanf(file, "%lf", &config->hunter_speed);
-                    }
-        else if (strcmp(key, "TIME_LIMIT") == 0) {
-            fscanf(file, "%lf", &config->time_limit);
-                    }
-        else if (strcmp(key , "HUNTER_SHAPE") == 0){
-            fscanf(file, "%dx%d" , &config->hunter_width , &config->hunter_height);
+    memcpy(recorder.event + *len, text, n);
+    *len += n;
+}
+
+// One cell as UTF-8, JSON escaped. Line drawing characters come from the ACS set.
+int RecordCellText(chtype c, char* out)
+{
+    int ch = (int)(c & A_CHARTEXT);
+    if (c & A_ALTCHARSET) {
+        const char* box = NULL;
+        switch (ch) {
+            case 'q': box = "\u2500"; break;   // ─
+            case 'x': box = "\u2502"; break;   // │
+            case 'l': box = "\u250c"; break;   // ┌
+            case 'k': box = "\u2510"; break;   // ┐
+            case 'm': box = "\u2514"; break;   // └
+            case 'j': box = "\u2518"; break;   // ┘
         }
-        else{
-            int value;
-            fscanf(file , "%d" , &value);
-            AssignValue(config , key , value);
+        if (box) return sprintf(out, "%s", box);
+    }
+    if (ch == '"' || ch == '\\') return sprintf(out, "\\%c", ch);
+    if (ch < 32 || ch > 126) ch = ' ';
+    out[0] = (char)ch;
+    return 1;
+}
 
+// Writer thread: everything that changed since the last written frame as one "o" event
+void RecordWrite(RECORD_FRAME* f)
+{
+    double at = (f->time - recorder.start) / 1e9;
+    int stride = recorder.cols + 1;
+    int len = 0;
+    attr_t attrs = (attr_t)-1;
+    int cursor_y = -1, cursor_x = -1;
+    char text[64];
+    for (int y = 0; y < recorder.rows; y++) {
+        for (int x = 0; x < recorder.cols; x++) {
+            chtype c = f->cells[y * stride + x];
+            if (c == recorder.shown[y * stride + x]) continue;
+            recorder.shown[y * stride + x] = c;
+            if (cursor_y != y || cursor_x != x) {
+                RecordPut(&len, at, text, sprintf(text, "\\u001b[%d;%dH", y + 1, x + 1));
+            }
+            attr_t a = c & (A_ATTRIBUTES & ~A_ALTCHARSET);
+            if (a != attrs) {
+                int pair = PAIR_NUMBER(a);
+                int n = sprintf(text, "\\u001b[0");
+                if (pair > 0 && pair < RECORD_PAIRS) {
+                    n += sprintf(text + n, ";%d;%d", 30 + recorder.pair_fg[pair], 40 + recorder.pair_bg[pair]);
+                }
+                if (a & A_BOLD) n += sprintf(text + n, ";1");
+                if (a & A_UNDERLINE) n += sprintf(text + n, ";4");
+                if (a & A_REVERSE) n += sprintf(text + n, ";7");
+                n += sprintf(text + n, "m");
+                RecordPut(&len, at, text, n);
+                attrs = a;
+            }
+            RecordPut(&len, at, text, RecordCellText(c, text));
+            cursor_y = y;
+            cursor_x = x + 1;
         }
+    }
+    if (len > 0) RecordEvent(at, len);
+    recorder.written++;
+}
+
+void RecordDrain(void)
+{
+    unsigned int tail = atomic_load_explicit(&recorder.tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&recorder.head, memory_order_acquire);
+    while (tail != head) {
+        RecordWrite(&recorder.frames[tail & (RECORD_SLOTS - 1)]);
+        atomic_store_explicit(&recorder.tail, ++tail, memory_order_release);
+    }
+}
+
+void* RecordWriter(void* arg)
+{
+    (void)arg;
+    while (atomic_load(&recorder.running)) {
+        usleep(RECORD_POLL_US);
+        RecordDrain();
+    }
+    return NULL;
+}
+
+// Starts recording the top left rows x cols of the screen into filename (after Start(),
+// the color pairs are read from ncurses). Returns 0 if the file cannot be written.
+int RecordStart(const char* filename, int rows, int cols)
+{
+    if (rows > LINES) rows = LINES;
+    if (cols > COLS) cols = COLS;
+    recorder.file = gzopen(filename, "wb1");   // fastest level, the writer must keep up
+    if (!recorder.file) return 0;
+    recorder.rows = rows;
+    recorder.cols = cols;
+    size_t cells = (size_t)rows * (cols + 1);
+    for (int i = 0; i < RECORD_SLOTS; i++) {
+        recorder.frames[i].cells = (chtype*)calloc(cells, sizeof(chtype));
+    }
+    recorder.shown = (chtype*)malloc(cells * sizeof(chtype));
+    memset(recorder.shown, 0xff, cells * sizeof(chtype));   // nothing shown yet
+    recorder.event = (char*)malloc(RECORD_EVENT);
+    for (short i = 0; i < RECORD_PAIRS; i++) {
+        recorder.pair_fg[i] = 9;   // 39 and 49: terminal default
+        recorder.pair_bg[i] = 9;
+        if (i > 0 && i < COLOR_PAIRS) {
+            short fg, bg;
+            pair_content(i, &fg, &bg);
+            if (fg >= 0 && fg < 8) recorder.pair_fg[i] = fg;
+            if (bg >= 0 && bg < 8) recorder.pair_bg[i] = bg;
         }
-    fclose(file);
+    }
+    recorder.start = TraceWallNs();
+    recorder.written = 0;
+    atomic_store(&recorder.head, 0);
+    atomic_store(&recorder.tail, 0);
+    atomic_store(&recorder.dropped, 0);
+    gzprintf(recorder.file, "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %ld, "
+             "\"env\": {\"TERM\": \"xterm-256color\"}}\n", cols, rows, (long)time(NULL));
+    gzprintf(recorder.file, "[0.0, \"o\", \"\\u001b[2J\\u001b[?25l\"]\n");   // clear, hide cursor
+    atomic_store(&recorder.running, 1);
+    pthread_create(&recorder.writer, NULL, RecordWriter, NULL);
     return 1;
-    
 }
 
-void DefaultValues(GameConfig* config)
+// Writes what is left and closes the file, returns the number of dropped frames
+unsigned int RecordStop(void)
 {
-    //default values if the fil doesnt work or is incomplete
-    config->screen_width = 100;
-    config->screen_height = 35;
-    config->star_quota = 10;
-    config->time_limit = 60;
-    config->swallow_speed_min = 1;
-    config->swallow_speed_max = 5;
-    config->hunter_spawn_rate = 100;
-    config->seed = 1234;
-    config->damage_penalty = 1;
-    config->hunter_speed = 1;
-    strcpy(config->player_name , "PLAYER1");
-    config->hunter_bounces = 3;
-    config->curr_level = 1;
+    if (!recorder.file) return 0;
+    atomic_store(&recorder.running, 0);
+    pthread_join(recorder.writer, NULL);
+    RecordDrain();
+    unsigned int dropped = atomic_load(&recorder.dropped);
+    if (dropped) {
+        gzprintf(recorder.file, "[%.6f, \"m\", \"%u frames dropped\"]\n",
+                 (TraceWallNs() - recorder.start) / 1e9, dropped);
+    }
+    gzclose(recorder.file);
+    recorder.file = NULL;
+    for (int i = 0; i < RECORD_SLOTS; i++) {
+        free(recorder.frames[i].cells);
+        recorder.frames[i].cells = NULL;
+    }
+    free(recorder.shown);
+    free(recorder.event);
+    return dropped;
 }
 
-//-----------------------------------//
-//  SCREEN SETTINGS AND I/O          //
-//-----------------------------------//
 
+//============================//
+//  SHARED STATE EXPORT       //
+//==========================//
 
-WINDOW* Start();
-void CleanWin(WIN* W, int bo);
-WIN* InitWin(WINDOW* parent, int rows, int cols, int y, int x, int color, int bo, int delay);
-void ShowStatus(WIN* W, void* bird , GameConfig *config ); //we use void so the program and the includes wont stay in an infinite loop
-void EndGameWin(WIN* W);
-void EndGameLose(WIN* W);
-void EndGameQuit(WIN* W);
+// SHARED_STATE 1 in config.txt publishes the world after every tick into the POSIX shared
+// memory object SWALLOW_SHM_NAME, so other local programs can follow the game without
+// scraping the terminal (layout and reader side in swallow_shm.h). The tick is written
+// straight into the mapping under a sequence lock: odd while writing, even when done.
+// Only the game thread writes, so it never waits, and readers retry a torn copy.
+_Static_assert(SWALLOW_SHM_HUNTERS == MAX_HUNTERS && SWALLOW_SHM_STARS == MAX_STARS &&
+               SWALLOW_SHM_BONUS == BONUS_STARS, "swallow_shm.h is out of date");
 
+typedef struct{
+    swallow_shm* shm;
+    char name[64];
+    uint64_t tick;          // frames of the current game
+    uint32_t game;
+} SHM_EXPORT;
 
-WINDOW* Start(){
-    WINDOW* win;
+static SHM_EXPORT shm_export;
 
-    // Initialize ncurses - sets up terminal for text UI
-    if ( (win = initscr()) == NULL ) {
-        fprintf(stderr, "Error initialising ncurses.\n");
-        exit(EXIT_FAILURE);
+int CalculateScore(BIRD* b , GameConfig* config);
+
+int ShmStart(const char* name)
+{
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not create shared memory %s: %s\n", name, strerror(errno));
+        return 0;
+    }
+    if (ftruncate(fd, sizeof(swallow_shm)) != 0) {
+        fprintf(stderr, "Error: Could not size shared memory %s: %s\n", name, strerror(errno));
+        close(fd);
+        return 0;
     }
+    void* p = mmap(NULL, sizeof(swallow_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return 0;
+    swallow_shm* shm = (swallow_shm*)p;
+    // the object may be left over from an earlier game that readers still have mapped:
+    // keep its sequence going forwards and make it odd until the header is valid again
+    uint64_t seq = (shm->seq | 1) + 1;
+    __atomic_store_n(&shm->seq, seq - 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memset(&shm->state, 0, sizeof(shm->state));
+    shm->state.result = GAME_RUNNING;
+    shm->magic = SWALLOW_SHM_MAGIC;
+    shm->version = SWALLOW_SHM_VERSION;
+    shm->size = sizeof(swallow_shm);
+    __atomic_store_n(&shm->closed, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&shm->seq, seq, __ATOMIC_RELEASE);
+    snprintf(shm_export.name, sizeof(shm_export.name), "%s", name);
+    shm_export.shm = shm;
+    shm_export.tick = 0;
+    shm_export.game = 0;
+    return 1;
+}
 
-    // Initialize color system
-    start_color();
+// Called when a game starts, the tick count restarts with it
+void ShmNewGame(void)
+{
+    shm_export.tick = 0;
+    shm_export.game++;
+}
 
-    // Define color pairs: init_pair(ID, FOREGROUND, BACKGROUND)
-    init_pair(MAIN_COLOR, COLOR_WHITE, COLOR_BLACK);
-    init_pair(PLAY_COLOR, COLOR_CYAN, COLOR_BLACK);
-    init_pair(STAT_COLOR, COLOR_YELLOW, COLOR_BLUE);
-    //ACTORS
-    init_pair(BIRD_COLOR, COLOR_GREEN, COLOR_BLACK);
-    init_pair(STAR_COLOR, COLOR_MAGENTA , COLOR_BLACK);
-    init_pair(HUNTER_COLOR , COLOR_RED , COLOR_BLACK);
-    init_pair(INJURED_BIRD, COLOR_YELLOW, COLOR_BLACK);
-    init_pair(TAXI_COLOR , COLOR_CYAN , COLOR_BLACK);
-    // Don't echo typed characters to screen
-    noecho();
-    
-    // Make cursor invisible (curs_set: 0=invisible, 1=normal, 2=very visible)
-    curs_set(0);
+// Publishes the state after a tick. result is GameTick's.
+void ShmPublish(const GAME_SESSION* gs, int result)
+{
+    swallow_shm* shm = shm_export.shm;
+    if (!shm) return;
+    uint64_t now = TraceWallNs();
+    uint64_t seq = shm->seq;
+    __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    swallow_shm_state* s = &shm->state;
+    const BIRD* b = gs->bird;
+    const TAXI* t = gs->taxi;
+    const GameConfig* config = &gs->config;
+    s->tick = ++shm_export.tick;
+    s->time_ns = now;
+    s->game = shm_export.game;
+    s->result = result;
+    s->width = gs->playwin->cols;
+    s->height = gs->playwin->rows;
+    s->level = config->curr_level;
+    s->star_quota = config->star_quota;
+    s->hunter_num = config->hunter_num;
+    s->total_score = CalculateScore(gs->bird, (GameConfig*)config);
+    s->time_left = (float)config->time_limit;
+    s->bird = (swallow_shm_bird){ b->x, b->y, b->dx, b->dy, b->speed, b->life, b->max_life,
+                                  b->score, b->on_taxi };
+    s->taxi.x = t->x;
+    s->taxi.y = t->y;
+    s->taxi.state = t->state;
+    s->taxi.active = t->active;
+    s->taxi.taxis_left = config->available_taxis;
+    for (int i = 0; i < BONUS_STARS; i++) {
+        s->taxi.bonus_x[i] = t->bonusx[i];
+        s->taxi.bonus_active[i] = (uint8_t)t->bonusa[i];
+    }
+    for (int i = 0; i < MAX_HUNTERS; i++) {
+        const HUNTER* h = gs->hunter[i];
+        s->hunter[i] = (swallow_shm_hunter){ h->x, h->y, h->dx, h->dy, h->bounces, h->active,
+                                             h->width, h->height };
+    }
+    for (int i = 0; i < MAX_STARS; i++) {
+        s->star[i] = (swallow_shm_star){ gs->star[i]->x, gs->star[i]->y };
+    }
 
-    return win;
+    __atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELEASE);
 }
 
-void CleanWin(WIN* W, int bo)
+// Tells readers the game is gone and removes the name; mapped readers keep the last tick
+void ShmStop(void)
 {
-    int i, j;
+    if (!shm_export.shm) return;
+    __atomic_store_n(&shm_export.shm->closed, 1, __ATOMIC_RELEASE);
+    munmap(shm_export.shm, sizeof(swallow_shm));
+    shm_unlink(shm_export.name);
+    shm_export.shm = NULL;
+}
 
-    // Set window color
-    wattron(W->window, COLOR_PAIR(W->color));
 
-    // Draw border if requested
-    if (bo) box(W->window, 0, 0);
+//============================//
+//  METRICS                   //
+//==========================//
 
-    // Fill window with spaces (clearing it)
-    for (i = bo; i < W->rows - bo; i++)
-        for (j = bo; j < W->cols - bo; j++)
-            mvwprintw(W->window, i, j, " ");
+// METRICS in config.txt serves the health of a running game in the Prometheus text format:
+// METRICS 1 on the Unix socket METRICS_SOCKET (one per process, scrape it with
+// curl --unix-socket), a port number on that port of 127.0.0.1. The game thread only
+// does relaxed atomic adds and stores into the registry, a server thread formats it for
+// whoever connects, so a slow or stuck scraper never holds up a frame.
+#define METRICS_SOCKET   "swallow-%ld.metrics"  // the game's pid
+#define METRICS_BOUNDS   8                      // histogram buckets before +Inf
+#define METRICS_POLL_MS  100                    // how often the server checks it should stop
+#define METRICS_IO_MS    200                    // a scraper gets this long to send and read
+#define METRICS_TEXT     16384
+#define FRAME_OVERRUN_NS (FRAME_TIME * 1500000ULL)  // a frame later than 1.5 frame times
+
+enum { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM };
+
+enum {
+    M_FRAMES, M_FRAME_OVERRUNS, M_FRAME_SECONDS, M_FRAME_INTERVAL, M_TERMINAL_BYTES,
+    M_RANKING_SECONDS, M_GAMES_WON, M_GAMES_LOST, M_GAMES_QUIT,
+    M_HUNTERS, M_STARS, M_BIRDS, M_SCORE, M_TIME_LEFT, M_LEVEL,
+    M_HUNTER_SPAWNS, M_STARS_COLLECTED, M_BIRD_HITS, M_SCRAPES,
+    METRIC_COUNT
+};
 
-    // Refresh to show changes
-    wrefresh(W->window);
-}
+typedef struct{
+    const char* name;
+    const char* help;
+    int type;
+    const double* bounds;           // histograms: upper bounds in seconds, METRICS_BOUNDS of them
+    _Atomic uint64_t count;         // counters
+    _Atomic double value;           // gauges
+    _Atomic uint64_t bucket[METRICS_BOUNDS + 1];   // histograms, not cumulative, the last is +Inf
+    _Atomic uint64_t sum_ns;
+} METRIC;
+
+static const double FRAME_BOUNDS[METRICS_BOUNDS] = { 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05 };
+static const double INTERVAL_BOUNDS[METRICS_BOUNDS] = { 0.0505, 0.051, 0.0525, 0.055, 0.06, 0.075, 0.1, 0.25 };
+static const double RANKING_BOUNDS[METRICS_BOUNDS] = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.05 };
+
+static METRIC metrics[METRIC_COUNT] = {
+    [M_FRAMES] = { "swallow_frames_total", "Frames played", METRIC_COUNTER, NULL },
+    [M_FRAME_OVERRUNS] = { "swallow_frame_overruns_total", "Frames that started more than half a frame late", METRIC_COUNTER, NULL },
+    [M_FRAME_SECONDS] = { "swallow_frame_seconds", "Time a frame spends on input, logic, drawing and recording", METRIC_HISTOGRAM, FRAME_BOUNDS },
+    [M_FRAME_INTERVAL] = { "swallow_frame_interval_seconds", "Time from the start of one frame to the start of the next", METRIC_HISTOGRAM, INTERVAL_BOUNDS },
+    [M_TERMINAL_BYTES] = { "swallow_terminal_bytes_total", "Bytes written to the terminal", METRIC_COUNTER, NULL },
+    [M_RANKING_SECONDS] = { "swallow_ranking_update_seconds", "Time UpdateRanking takes at the end of a game", METRIC_HISTOGRAM, RANKING_BOUNDS },
+    [M_GAMES_WON] = { "swallow_games_won_total", "Games won", METRIC_COUNTER, NULL },
+    [M_GAMES_LOST] = { "swallow_games_lost_total", "Games lost", METRIC_COUNTER, NULL },
+    [M_GAMES_QUIT] = { "swallow_games_quit_total", "Games quit", METRIC_COUNTER, NULL },
+    [M_HUNTERS] = { "swallow_hunters_active", "Hunters on the board", METRIC_GAUGE, NULL },
+    [M_STARS] = { "swallow_stars_active", "Stars on the board, STAR_RAIN included", METRIC_GAUGE, NULL },
+    [M_BIRDS] = { "swallow_birds_alive", "Birds still flying", METRIC_GAUGE, NULL },
+    [M_SCORE] = { "swallow_score", "Stars collected this game", METRIC_GAUGE, NULL },
+    [M_TIME_LEFT] = { "swallow_time_left_seconds", "Time left in this game", METRIC_GAUGE, NULL },
+    [M_LEVEL] = { "swallow_level", "Current level", METRIC_GAUGE, NULL },
+    [M_HUNTER_SPAWNS] = { "swallow_hunter_spawns_total", "Hunters that entered the board", METRIC_COUNTER, NULL },
+    [M_STARS_COLLECTED] = { "swallow_stars_collected_total", "Stars the birds collected", METRIC_COUNTER, NULL },
+    [M_BIRD_HITS] = { "swallow_bird_hits_total", "Times a hunter hit a bird", METRIC_COUNTER, NULL },
+    [M_SCRAPES] = { "swallow_metrics_scrapes_total", "Times the metrics were served", METRIC_COUNTER, NULL },
+};
 
-WIN* InitWin(WINDOW* parent, int rows, int cols, int y, int x, int color, int bo, int delay)
+typedef struct{
+    atomic_int on;                  // 1 while the server runs, read before every update
+    atomic_int running;
+    int fd;
+    char path[108];                 // the Unix socket, empty for a port
+    pthread_t server;
+    char text[METRICS_TEXT];        // the server's
+} METRICS_SERVER;
+
+static METRICS_SERVER metrics_server = { .fd = -1 };
+
+// Not counted while this thread plays a WORLD (the planner's futures) or nobody scrapes
+static inline int MetricsLive(void)
 {
-    // Allocate memory for WIN structure
-    WIN* W = (WIN*)malloc(sizeof(WIN));
+    return !trace_muted && atomic_load_explicit(&metrics_server.on, memory_order_relaxed);
+}
+
+static inline void MetricAdd(int id, uint64_t n)
+{
+    if (MetricsLive()) atomic_fetch_add_explicit(&metrics[id].count, n, memory_order_relaxed);
+}
+
+static inline void MetricSet(int id, double v)
+{
+    if (MetricsLive()) atomic_store_explicit(&metrics[id].value, v, memory_order_relaxed);
+}
+
+static inline void MetricObserve(int id, uint64_t ns)
+{
+    if (!MetricsLive()) return;
+    METRIC* m = &metrics[id];
+    double s = ns / 1e9;
+    int b = 0;
+    while (b < METRICS_BOUNDS && s > m->bounds[b]) b++;
+    atomic_fetch_add_explicit(&m->bucket[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->sum_ns, ns, memory_order_relaxed);
+}
+
+// ncurses writes the screen straight to its file descriptor from libtinfo, past any FILE*
+// the game could hand it, so the terminal bytes come from the kernel's count of what the
+// game thread wrote (wchar in /proc/thread-self/io). Everything else the game thread writes
+// while a game runs is the screen; the heatmap and ranking at the end of a game are left
+// out with MetricsWrites(0).
+static int metrics_io = -1;         // the game thread's io file, opened by MetricsStart
+static uint64_t metrics_written;    // its wchar as of the last MetricsWrites
+
+static uint64_t MetricsWchar(void)
+{
+    char text[512];
+    ssize_t n = pread(metrics_io, text, sizeof(text) - 1, 0);
+    if (n <= 0) return metrics_written;
+    text[n] = '\0';
+    const char* w = strstr(text, "wchar:");
+    return w ? strtoull(w + 6, NULL, 10) : metrics_written;
+}
+
+// On the game thread: what it wrote since the last call goes to M_TERMINAL_BYTES, or with
+// terminal 0 is skipped
+void MetricsWrites(int terminal)
+{
+    if (!MetricsLive() || metrics_io < 0) return;
+    uint64_t written = MetricsWchar();
+    if (terminal && written > metrics_written) MetricAdd(M_TERMINAL_BYTES, written - metrics_written);
+    metrics_written = written;
+}
+
+// Frame start to frame start, and the part of it spent working, once a frame from MainLoop
+void MetricsFrame(const GAME_SESSION* gs, uint64_t work_ns, uint64_t interval_ns)
+{
+    if (!MetricsLive()) return;
+    int hunters = 0, birds = 0, score = 0;
+    for (int i = 0; i < MAX_HUNTERS; i++) hunters += gs->hunter[i]->active;
+    for (int i = 0; i < gs->flock.count; i++) {
+        birds += gs->flock.bird[i]->life > 0;
+        score += gs->flock.bird[i]->score;
+    }
+    MetricAdd(M_FRAMES, 1);
+    MetricsWrites(1);
+    MetricObserve(M_FRAME_SECONDS, work_ns);
+    if (interval_ns) {
+        MetricObserve(M_FRAME_INTERVAL, interval_ns);
+        if (interval_ns > FRAME_OVERRUN_NS) MetricAdd(M_FRAME_OVERRUNS, 1);
+    }
+    MetricSet(M_HUNTERS, hunters);
+    MetricSet(M_STARS, MAX_STARS + (gs->rain ? gs->rain->stars : 0));
+    MetricSet(M_BIRDS, birds);
+    MetricSet(M_SCORE, score);
+    MetricSet(M_TIME_LEFT, gs->config.time_limit > 0 ? gs->config.time_limit : 0);
+    MetricSet(M_LEVEL, gs->config.curr_level);
+}
+
+// The registry in the text exposition format, cut short if it does not fit
+size_t MetricsText(char* out, size_t size)
+{
+    size_t len = 0;
+#define METRICS_PRINTF(...) do { \
+        int n_ = snprintf(out + len, size - len, __VA_ARGS__); \
+        if (n_ < 0 || (size_t)n_ >= size - len) return len; \
+        len += n_; \
+    } while (0)
+    static const char* TYPES[] = { "counter", "gauge", "histogram" };
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        METRIC* m = &metrics[i];
+        METRICS_PRINTF("# HELP %s %s.\n# TYPE %s %s\n", m->name, m->help, m->name, TYPES[m->type]);
+        if (m->type == METRIC_COUNTER) {
+            METRICS_PRINTF("%s %llu\n", m->name, (unsigned long long)atomic_load_explicit(&m->count, memory_order_relaxed));
+        } else if (m->type == METRIC_GAUGE) {
+            METRICS_PRINTF("%s %.17g\n", m->name, atomic_load_explicit(&m->value, memory_order_relaxed));
+        } else {
+            uint64_t total = 0;
+            for (int b = 0; b <= METRICS_BOUNDS; b++) {
+                total += atomic_load_explicit(&m->bucket[b], memory_order_relaxed);
+                if (b < METRICS_BOUNDS) METRICS_PRINTF("%s_bucket{le=\"%g\"} %llu\n", m->name, m->bounds[b], (unsigned long long)total);
+                else METRICS_PRINTF("%s_bucket{le=\"+Inf\"} %llu\n", m->name, (unsigned long long)total);
+            }
+            METRICS_PRINTF("%s_sum %.9f\n%s_count %llu\n", m->name,
+                           atomic_load_explicit(&m->sum_ns, memory_order_relaxed) / 1e9, m->name, (unsigned long long)total);
+        }
+    }
+#undef METRICS_PRINTF
+    return len;
+}
+
+// One scrape: whatever was asked (an HTTP GET from Prometheus or curl, or nothing from
+// nc), the answer is the registry as an HTTP/1.0 response
+static void MetricsServe(int fd)
+{
+    struct timeval tv = { 0, METRICS_IO_MS * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    char request[1024];
+    size_t got = 0;
+    while (got < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + got, sizeof(request) - 1 - got, 0);
+        if (n <= 0) break;
+        got += n;
+        request[got] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    atomic_fetch_add_explicit(&metrics[M_SCRAPES].count, 1, memory_order_relaxed);
+    char* text = metrics_server.text;
+    size_t body = MetricsText(text, METRICS_TEXT);
+    char head[160];
+    int head_len = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                            "Content-Length: %zu\r\nConnection: close\r\n\r\n", body);
+    if (send(fd, head, head_len, MSG_NOSIGNAL) != head_len) return;
+    for (size_t sent = 0; sent < body; ) {
+        ssize_t n = send(fd, text + sent, body - sent, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        sent += n;
+    }
+}
+
+void* MetricsServer(void* arg)
+{
+    (void)arg;
+    struct pollfd p = { metrics_server.fd, POLLIN, 0 };
+    while (atomic_load(&metrics_server.running)) {
+        if (poll(&p, 1, METRICS_POLL_MS) <= 0) continue;
+        int fd = accept(metrics_server.fd, NULL, NULL);
+        if (fd < 0) continue;
+        MetricsServe(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+// METRICS 1 serves on METRICS_SOCKET, a higher value on that port of the loopback. Called
+// by the game thread. Returns 0 with a message if it cannot listen.
+int MetricsStart(int where)
+{
+    int fd;
+    metrics_server.path[0] = '\0';
+    if (where == 1) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(metrics_server.path, sizeof(metrics_server.path), METRICS_SOCKET, (long)getpid());
+        strcpy(addr.sun_path, metrics_server.path);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(metrics_server.path);
+        if (fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)where);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int yes = 1;
+        fd = where > 0 && where < 65536 ? socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+        if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        if (fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0 || listen(fd, 8) != 0) {
+        if (where == 1) fprintf(stderr, "Error: Could not serve metrics on %s: %s\n", metrics_server.path, strerror(errno));
+        else fprintf(stderr, "Error: Could not serve metrics on port %d: %s\n", where, strerror(errno));
+        if (fd >= 0) close(fd);
+        metrics_server.path[0] = '\0';
+        return 0;
+    }
+    metrics_server.fd = fd;
+    atomic_store(&metrics_server.running, 1);
+    if (pthread_create(&metrics_server.server, NULL, MetricsServer, NULL) != 0) {
+        close(fd);
+        metrics_server.fd = -1;
+        return 0;
+    }
+    // without per thread io accounting in the kernel the terminal bytes stay 0
+    metrics_io = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+    if (metrics_io >= 0) metrics_written = MetricsWchar();
+    atomic_store(&metrics_server.on, 1);
+    return 1;
+}
+
+void MetricsStop(void)
+{
+    if (metrics_server.fd < 0) return;
+    atomic_store(&metrics_server.on, 0);
+    atomic_store(&metrics_server.running, 0);
+    pthread_join(metrics_server.server, NULL);
+    close(metrics_server.fd);
+    metrics_server.fd = -1;
+    if (metrics_io >= 0) close(metrics_io);
+    metrics_io = -1;
+    if (metrics_server.path[0]) unlink(metrics_server.path);
+}
+
+
+//============================//
+//  HEATMAPS                  //
+//==========================//
+
+// HEATMAP 1 in config.txt counts, for every board cell, what happened there in a game: where
+// the birds flew, where they were hit, where they collected stars and where the hunters were.
+// A tick only adds one to a counter per bird and per hunter, and the game appends its map to
+// HEATMAP_FILE when it ends. Maps only ever add up, so any number of games, files and merged
+// files sum in any order: see ./game --heat-merge and --heat-show.
+#define HEATMAP_FILE "heatmap.bin"
+#define HEAT_MAGIC   0x4d485753u    // "SWHM"
+#define HEAT_VERSION 1
+
+enum { HEAT_BIRD, HEAT_DAMAGE, HEAT_STARS, HEAT_HUNTERS, HEAT_LAYERS };
+static const char* HEAT_NAMES[HEAT_LAYERS] = { "bird", "damage", "stars", "hunters" };
+
+// One game's counts, in the session's arena
+struct HEATMAP{
+    int cols, rows;
+    uint32_t ticks;
+    int life[MAX_BIRDS];            // of every bird after the last tick
+    int score[MAX_BIRDS];
+    uint32_t* count;                // [layer][row][col]
+};
+
+// A record of the file: one game, or many summed up, followed by packed bytes of its
+// counts [layer][row][col], sparse: for every cell that is not 0, the number of 0 cells
+// skipped since the last one and then its count, both as varints (7 bits a byte, low first).
+// Most of a game's cells stay 0, so a record is a few KB and summing it only touches the rest.
+typedef struct{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t cols, rows;
+    uint64_t games;
+    uint64_t ticks;
+    uint32_t packed;
+    uint32_t crc;                   // crc32 of the packed bytes
+} HEAT_RECORD;
+
+// Any number of records summed up
+typedef struct{
+    int cols, rows;
+    uint64_t games, ticks;
+    uint64_t* count;                // [layer][row][col]
+} HEAT_TOTAL;
+
+size_t HeatmapSize(int cols , int rows)
+{
+    return sizeof(HEATMAP) + ARENA_ALIGN + (size_t)HEAT_LAYERS * cols * rows * sizeof(uint32_t);
+}
+
+// An empty map over mem (HeatmapSize bytes) for w's board, starting from the flock as it is
+HEATMAP* InitHeatmap(void* mem , const WIN* w , const FLOCK* flock)
+{
+    if (!mem) return NULL;
+    HEATMAP* h = (HEATMAP*)mem;
+    h->cols = w->cols;
+    h->rows = w->rows;
+    h->ticks = 0;
+    unsigned char* p = (unsigned char*)(h + 1);
+    h->count = (uint32_t*)(((uintptr_t)p + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+    memset(h->count, 0, (size_t)HEAT_LAYERS * h->cols * h->rows * sizeof(uint32_t));
+    for (int i = 0; i < flock->count; i++) {
+        h->life[i] = flock->bird[i]->life;
+        h->score[i] = flock->bird[i]->score;
+    }
+    return h;
+}
+
+static inline void HeatAdd(HEATMAP* h , int layer , int x , int y , uint32_t n)
+{
+    if (x < 0 || y < 0 || x >= h->cols || y >= h->rows) return;
+    h->count[((size_t)layer * h->rows + y) * h->cols + x] += n;
+}
+
+// After a tick: every living bird and active hunter counts where its middle is. A bird that
+// lost life was hit there and one whose score went up collected the stars there (at the end
+// of the tick, the frame it happened in for ticks of one frame).
+void HeatTick(HEATMAP* h , const FLOCK* flock , HUNTER* const hunter[] , int hunters)
+{
+    h->ticks++;
+    for (int i = 0; i < flock->count; i++) {
+        const BIRD* b = flock->bird[i];
+        int x = b->x + b->width / 2;
+        if (b->life > 0) HeatAdd(h, HEAT_BIRD, x, b->y, 1);
+        if (b->life < h->life[i]) HeatAdd(h, HEAT_DAMAGE, x, b->y, 1);
+        if (b->score > h->score[i]) HeatAdd(h, HEAT_STARS, x, b->y, b->score - h->score[i]);
+        h->life[i] = b->life;
+        h->score[i] = b->score;
+    }
+    for (int i = 0; i < hunters; i++) {
+        const HUNTER* k = hunter[i];
+        if (k->active) HeatAdd(h, HEAT_HUNTERS, (int)k->x + k->width / 2, (int)k->y + k->height / 2, 1);
+    }
+}
+
+static inline unsigned char* HeatVarint(unsigned char* p , uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+// Appends a record of count (HEAT_LAYERS * cols * rows values) to file, in one write so
+// games ending in several processes at once do not mix their records. Returns 1 if written.
+static int HeatAppend(const char* file , int cols , int rows , uint64_t games , uint64_t ticks , const uint64_t* count)
+{
+    size_t cells = (size_t)HEAT_LAYERS * cols * rows;
+    unsigned char* out = (unsigned char*)malloc(sizeof(HEAT_RECORD) + cells * 20);   // two 10 byte varints a cell at worst
+    if (!out) return 0;
+    unsigned char* p = out + sizeof(HEAT_RECORD);
+    size_t last = 0;
+    for (size_t i = 0; i < cells; i++) {
+        if (!count[i]) continue;
+        p = HeatVarint(HeatVarint(p, i - last), count[i]);
+        last = i + 1;
+    }
+    size_t packed = p - (out + sizeof(HEAT_RECORD));
+    HEAT_RECORD r = { HEAT_MAGIC, HEAT_VERSION, (uint32_t)cols, (uint32_t)rows, games, ticks,
+                      (uint32_t)packed, (uint32_t)crc32(0, out + sizeof(HEAT_RECORD), packed) };
+    memcpy(out, &r, sizeof(r));
+    int fd = open(file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    size_t size = sizeof(HEAT_RECORD) + packed;
+    int ok = fd >= 0 && write(fd, out, size) == (ssize_t)size;
+    if (fd >= 0) ok = close(fd) == 0 && ok;
+    free(out);
+    return ok;
+}
+
+// The game's record, when it has ended
+int HeatFlush(const HEATMAP* h , const char* file)
+{
+    size_t cells = (size_t)HEAT_LAYERS * h->cols * h->rows;
+    uint64_t* wide = (uint64_t*)malloc(cells * sizeof(uint64_t));
+    if (!wide) return 0;
+    for (size_t i = 0; i < cells; i++) wide[i] = h->count[i];
+    int ok = HeatAppend(file, h->cols, h->rows, 1, h->ticks, wide);
+    free(wide);
+    if (!ok) fprintf(stderr, "Error: Could not append the heatmap to %s\n", file);
+    return ok;
+}
+
+// Records of the files being summed, split into chunks summed on the job system
+typedef struct{
+    const unsigned char** record;
+    int records;
+    int chunks;
+    int cols, rows;
+    uint64_t** partial;             // [chunk], counts of the chunk
+    uint64_t* games;                // [chunk]
+    uint64_t* ticks;                // [chunk]
+    int* bad;                       // [chunk] records that did not check out
+} HEAT_MERGE;
+
+// Adds the packed counts of a record to sum. Returns 0, having added part of them, if they
+// run past the end of the record or the board.
+static int HeatAddPacked(uint64_t* sum , size_t cells , const unsigned char* p , size_t size)
+{
+    const unsigned char* end = p + size;
+    size_t at = 0;
+    while (p < end) {
+        uint64_t v[2] = { 0, 0 };
+        for (int k = 0; k < 2; k++) {
+            for (int shift = 0; ; shift += 7) {
+                if (p == end || shift > 63) return 0;
+                v[k] |= (uint64_t)(*p & 0x7f) << shift;
+                if (!(*p++ & 0x80)) break;
+            }
+        }
+        if (v[0] >= cells - at) return 0;
+        at += v[0];
+        sum[at++] += v[1];
+    }
+    return 1;
+}
+
+static void HeatMergeChunk(void* ctx , int chunk)
+{
+    HEAT_MERGE* m = (HEAT_MERGE*)ctx;
+    size_t cells = (size_t)HEAT_LAYERS * m->cols * m->rows;
+    uint64_t* sum = m->partial[chunk];
+    memset(sum, 0, cells * sizeof(uint64_t));
+    m->games[chunk] = m->ticks[chunk] = 0;
+    m->bad[chunk] = 0;
+    int first = (long)m->records * chunk / m->chunks, last = (long)m->records * (chunk + 1) / m->chunks;
+    for (int i = first; i < last; i++) {
+        HEAT_RECORD r;      // records follow each other unaligned
+        memcpy(&r, m->record[i], sizeof(r));
+        const unsigned char* packed = m->record[i] + sizeof(r);
+        // the crc is checked first, so a damaged record adds nothing
+        if ((int)r.cols != m->cols || (int)r.rows != m->rows || crc32(0, packed, r.packed) != r.crc ||
+            !HeatAddPacked(sum, cells, packed, r.packed)) {
+            m->bad[chunk]++;
+            continue;
+        }
+        m->games[chunk] += r.games;
+        m->ticks[chunk] += r.ticks;
+    }
+}
+
+// Sums m's records into t, the partial sums on the job system. Returns 0 if memory runs out.
+static int HeatSum(HEAT_MERGE* m , int threads , HEAT_TOTAL* t , int* skipped)
+{
+    m->chunks = threads * 4 < m->records ? threads * 4 : m->records;
+    size_t cells = (size_t)HEAT_LAYERS * m->cols * m->rows;
+    m->partial = (uint64_t**)calloc(m->chunks, sizeof(uint64_t*));
+    m->games = (uint64_t*)calloc(m->chunks, sizeof(uint64_t));
+    m->ticks = (uint64_t*)calloc(m->chunks, sizeof(uint64_t));
+    m->bad = (int*)calloc(m->chunks, sizeof(int));
+    t->count = (uint64_t*)calloc(cells, sizeof(uint64_t));
+    int ok = m->partial && m->games && m->ticks && m->bad && t->count;
+    for (int c = 0; ok && c < m->chunks; c++) {
+        m->partial[c] = (uint64_t*)malloc(cells * sizeof(uint64_t));
+        ok = m->partial[c] != NULL;
+    }
+    if (ok) {
+        JOB_SYSTEM* js = JobsCreate(threads, m->chunks);
+        if (js) {
+            JobsParallelFor(js, m->chunks, HeatMergeChunk, m);
+            JobsDestroy(js);
+        } else {
+            for (int c = 0; c < m->chunks; c++) HeatMergeChunk(m, c);   // on this thread alone
+        }
+        t->cols = m->cols;
+        t->rows = m->rows;
+        t->games = t->ticks = 0;
+        for (int c = 0; c < m->chunks; c++) {
+            for (size_t i = 0; i < cells; i++) t->count[i] += m->partial[c][i];
+            t->games += m->games[c];
+            t->ticks += m->ticks[c];
+            *skipped += m->bad[c];
+        }
+    } else {
+        free(t->count);
+        t->count = NULL;
+    }
+    for (int c = 0; m->partial && c < m->chunks; c++) free(m->partial[c]);
+    free(m->partial);
+    free(m->games);
+    free(m->ticks);
+    free(m->bad);
+    return ok;
+}
+
+// Sums every record of the files into t on threads threads. The board is the first record's,
+// records of other boards and damaged ones are skipped (and counted). Returns 0 with a
+// message if nothing could be read or memory runs out.
+int HeatLoad(char* const files[] , int count , int threads , HEAT_TOTAL* t)
+{
+    unsigned char** data = (unsigned char**)calloc(count, sizeof(unsigned char*));
+    size_t* sizes = (size_t*)calloc(count, sizeof(size_t));
+    HEAT_MERGE m = { 0 };
+    int capacity = 0, skipped = 0;
+    int ok = data && sizes;
+    t->count = NULL;
+    for (int f = 0; ok && f < count; f++) {
+        int fd = open(files[f], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+            fprintf(stderr, "Error: Could not read %s\n", files[f]);
+            if (fd >= 0) close(fd);
+            continue;
+        }
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            fprintf(stderr, "Error: Could not read %s\n", files[f]);
+            continue;
+        }
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+        data[f] = (unsigned char*)p;
+        sizes[f] = st.st_size;
+        size_t at = 0;
+        while (at < sizes[f]) {
+            HEAT_RECORD r;
+            if (sizes[f] - at >= sizeof(r)) memcpy(&r, data[f] + at, sizeof(r));
+            if (sizes[f] - at < sizeof(r) || r.magic != HEAT_MAGIC || r.version != HEAT_VERSION ||
+                r.packed > sizes[f] - at - sizeof(r)) {
+                if (at == 0) fprintf(stderr, "Error: %s is not a heatmap\n", files[f]);
+                else fprintf(stderr, "Error: %s is damaged after %zu bytes\n", files[f], at);
+                break;
+            }
+            if (m.records == 0) {
+                m.cols = r.cols;
+                m.rows = r.rows;
+            }
+            if (m.records == capacity) {
+                int more = capacity ? capacity * 2 : 1024;
+                const unsigned char** record = (const unsigned char**)realloc(m.record, more * sizeof(unsigned char*));
+                if (!record) {
+                    ok = 0;
+                    break;
+                }
+                m.record = record;
+                capacity = more;
+            }
+            m.record[m.records++] = data[f] + at;
+            at += sizeof(r) + r.packed;
+        }
+    }
+    if (ok && m.records > 0) ok = HeatSum(&m, threads, t, &skipped);
+    if (!ok) fprintf(stderr, "Error: Out of memory\n");
+    if (skipped) fprintf(stderr, "%d records skipped (another board or damaged)\n", skipped);
+    int records = m.records;
+    for (int f = 0; data && f < count; f++) {
+        if (data[f]) munmap(data[f], sizes[f]);
+    }
+    free(m.record);
+    free(data);
+    free(sizes);
+    if (ok && records == skipped) {
+        free(t->count);
+        t->count = NULL;
+    }
+    return ok && records > skipped;
+}
+
+// Prints layer of t squeezed into at most width columns, darker characters for more.
+// The scale is logarithmic, a cell is as dark as log(1 + count) is of the busiest one's.
+void HeatRender(const HEAT_TOTAL* t , int layer , int width , FILE* out)
+{
+    static const char RAMP[] = " .:-=+*#%@";
+    int levels = (int)sizeof(RAMP) - 2;
+    int step = (t->cols + width - 1) / width;
+    if (step < 1) step = 1;
+    int cols = (t->cols + step - 1) / step, rows = (t->rows + step - 1) / step;
+    uint64_t* cell = (uint64_t*)calloc((size_t)cols * rows, sizeof(uint64_t));
+    if (!cell) return;
+    const uint64_t* count = t->count + (size_t)layer * t->cols * t->rows;
+    uint64_t total = 0, most = 0;
+    for (int y = 0; y < t->rows; y++) {
+        for (int x = 0; x < t->cols; x++) {
+            cell[(y / step) * cols + x / step] += count[(size_t)y * t->cols + x];
+            total += count[(size_t)y * t->cols + x];
+        }
+    }
+    for (int i = 0; i < cols * rows; i++) if (cell[i] > most) most = cell[i];
+    fprintf(out, "%s: %llu in %llu games, busiest %dx%d cell %llu\n", HEAT_NAMES[layer],
+            (unsigned long long)total, (unsigned long long)t->games, step, step, (unsigned long long)most);
+    fprintf(out, "+");
+    for (int x = 0; x < cols; x++) fputc('-', out);
+    fprintf(out, "+\n");
+    for (int y = 0; y < rows; y++) {
+        fputc('|', out);
+        for (int x = 0; x < cols; x++) {
+            uint64_t v = cell[y * cols + x];
+            int k = v == 0 ? 0 : 1 + (int)((levels - 1) * log1p((double)v) / log1p((double)most));
+            fputc(RAMP[k], out);
+        }
+        fprintf(out, "|\n");
+    }
+    fprintf(out, "+");
+    for (int x = 0; x < cols; x++) fputc('-', out);
+    fprintf(out, "+\n");
+    free(cell);
+}
+
+
+//============================//
+//  TICK HASHES               //
+//==========================//
+
+// For runs that should be identical and are not (another build, other compiler flags,
+// another machine): every tick of a game is hashed entity by entity, and the tick hashes
+// are the leaves of a Merkle tree over tick ranges. Two runs' trees lead to the first tick
+// that differs with one comparison per level, and that tick's row of entity hashes shows
+// what differs. ./game --tick-hash plays a game and writes its history, --tick-diff
+// compares two. Only entities that changed are hashed again: the game code marks a bird,
+// hunter, star or the taxi dirty where it changes one, and the rain the rows stars left or
+// joined. What only counts frames between changes (a star's counter, a hunter's wait, a
+// flying bird's counter) is hashed against the tick, so it keeps its hash while it counts.
+// A tick keeps the entity hashes that changed, the rows are written out with the history.
+#define TICK_MAGIC   0x48545753u    // "SWTH"
+#define TICK_VERSION 3
+#define TICK_KEYS    32             // words per block of the hash, longer inputs take several
+#define TICK_PAIR(a, b) ((uint64_t)(uint32_t)(a) << 32 | (uint32_t)(b))
+
+enum { TICK_GAME, TICK_BIRDS, TICK_TAXI = TICK_BIRDS + MAX_BIRDS, TICK_STARS,
+       TICK_HUNTERS = TICK_STARS + MAX_STARS, TICK_RAIN = TICK_HUNTERS + MAX_HUNTERS, TICK_ENTITIES };
+
+_Static_assert(TICK_ENTITIES <= TICK_KEYS, "a tick hash keys every entity's hash with its own key");
+
+typedef struct{
+    uint32_t tick;
+    uint32_t entity;
+    uint64_t hash;
+} TICK_CHANGE;
+
+// A game's history, recorded by the tool that plays it
+typedef struct{
+    long capacity;                  // ticks there is room for
+    long ticks;
+    int full;                       // 1 if the game went on after capacity ticks
+    int rehash;                     // 1 until the first tick of a game hashed every entity
+    uint64_t hash[TICK_ENTITIES];   // every entity's as of the last tick
+    uint64_t sum;                   // of hash[i] * tick_keys[i], the last tick's hash before TickFinish
+    TICK_CHANGE* change;            // the entity hashes each tick changed, in tick order
+    long changes;
+    uint64_t* rain_row;             // hash of every rain row as of the last tick, NULL without rain
+    long rain_rows;
+    uint64_t rain_sum;              // of the row hashes
+    uint64_t* leaf;                 // [capacity][TICK_ENTITIES], written from the changes by TickHistoryRows
+    uint64_t* node;                 // the tree by level, tick hashes first, 2 * capacity
+} TICK_HISTORY;
+
+typedef struct{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entities;              // TICK_ENTITIES of the build that wrote it
+    uint32_t levels;                // of the tree, the last is the root
+    uint64_t ticks;
+    uint32_t seed;
+    int32_t dt;
+} TICK_FILE;    // then leaf[ticks][entities] and the tree level by level
+
+static uint64_t tick_keys[TICK_KEYS + 1];
+
+static inline uint64_t TickBits(double d)
+{
+    uint64_t u;
+    memcpy(&u, &d, sizeof(u));
+    return u;
+}
+
+// MurmurHash3's finalizer, never 0: that is an empty subtree
+static inline uint64_t TickFinish(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h ? h : 1;
+}
+
+// Multilinear sum of up to TICK_KEYS words: the products do not depend on each other, so
+// the words go through at the multiplier's throughput instead of a multiply's latency each.
+// The keys are odd, so a change to any one word always changes the sum, but a change to a
+// word's high half only reaches the sum's high half: every hash goes through TickFinish.
+ALWAYS_INLINE uint64_t TickSum(uint64_t h, const uint64_t* w, int n)
+{
+    for (int i = 0; i < n; i++) h += (w[i] + tick_keys[i]) * tick_keys[i + 1];
+    return h;
+}
+
+// Any number of words, a block of TICK_KEYS at a time, mixed between blocks
+static uint64_t TickHashWords(uint64_t h, const uint64_t* w, size_t n)
+{
+    for (size_t at = 0; at < n; at += TICK_KEYS) {
+        size_t count = n - at < TICK_KEYS ? n - at : TICK_KEYS;
+        h = TickFinish(TickSum(h, w + at, (int)count));
+    }
+    return h;
+}
+
+// Left and right children, 0 for a missing right one: a tree over fewer ticks has the
+// same hashes as the left part of a bigger one, so runs of any length compare
+static inline uint64_t TickJoin(uint64_t left, uint64_t right)
+{
+    if (!right) return left;
+    uint64_t w[2] = { left, right };
+    return TickHashWords(TICK_MAGIC, w, 2);
+}
+
+static inline uint64_t TickHashGame(const GAME_SESSION* gs)
+{
+    const GameConfig* c = &gs->config;
+    uint64_t w[] = { TickBits(c->time_limit), TICK_PAIR(c->curr_level, c->hunter_num), TickBits(c->hunter_speed),
+                     TICK_PAIR(c->hunter_spawn_rate, c->available_taxis), TICK_PAIR(c->star_quota, c->taxi_bonus),
+                     TICK_PAIR(gs->flock.tick, gs->frame) };
+    return TickFinish(TickSum(TICK_GAME, w, sizeof(w) / sizeof(w[0])));
+}
+
+// Between steps a flying bird only adds its speed to its counter every frame, so it is
+// hashed with counter - speed * tick. Where it was before (last_x, path) was hashed then.
+static inline uint64_t TickHashBird(const BIRD* b, uint32_t tick)
+{
+    uint32_t counter = b->life > 0 && !b->on_taxi ? (uint32_t)b->counter - (uint32_t)b->speed * tick : (uint32_t)b->counter;
+    uint64_t w[] = { TICK_PAIR(b->x, b->y), TICK_PAIR(b->dx, b->dy), TICK_PAIR(b->speed, counter),
+                     TICK_PAIR(b->score, b->life), TICK_PAIR(b->max_life, b->on_taxi), TICK_PAIR(b->color, b->width) };
+    return TickFinish(TickSum(TICK_BIRDS, w, sizeof(w) / sizeof(w[0])));
+}
+
+static inline uint64_t TickHashTaxi(const TAXI* t, const FLOCK* flock)
+{
+    int rider = -1;
+    for (int i = 0; i < flock->count; i++) if (t->rider == flock->bird[i]) rider = i;
+    uint32_t bonus = 0;
+    for (int i = 0; i < BONUS_STARS; i++) bonus |= (uint32_t)(t->bonusa[i] != 0) << i;
+    uint64_t w[] = { TICK_PAIR(t->x, t->y), TICK_PAIR(t->dx, t->dy), TICK_PAIR(t->speed, t->counter_of_taxis),
+                     TICK_PAIR(t->active, t->state), TICK_PAIR(t->bonus, rider), TICK_PAIR(bonus, t->bonusx[0]) };
+    return TickFinish(TickSum(TICK_TAXI, w, sizeof(w) / sizeof(w[0])));
+}
+
+// A falling star counts down one a frame and goes a row down every interval frames, so the
+// tick it falls on next (counter + tick) grows by interval with every row: it is hashed with
+// y * interval - (counter + tick), which stays the same until it is caught or starts over at
+// the top. With the tick it gives back both y and the counter, as the counter is 1..interval.
+static inline uint64_t TickHashStar(const STAR* s, uint32_t tick)
+{
+    uint32_t fall = (uint32_t)s->y * (uint32_t)s->interval - ((uint32_t)s->counter + tick);
+    uint64_t w[] = { TICK_PAIR(s->x, s->interval), TICK_PAIR(s->dx, s->dy), fall };
+    return TickFinish(TickSum(TICK_STARS, w, sizeof(w) / sizeof(w[0])));
+}
+
+// The same for a waiting hunter: it is hashed with the tick its wait ends on
+static inline uint64_t TickHashHunter(const HUNTER* h, uint32_t tick)
+{
+    uint32_t wait = h->active && h->wait_dash > 0 ? (uint32_t)h->wait_dash + tick : (uint32_t)h->wait_dash;
+    uint64_t w[] = { TickBits(h->x), TickBits(h->y), TickBits(h->dx), TickBits(h->dy), TickBits(h->speed),
+                     TICK_PAIR(h->bounces, h->damage), TICK_PAIR(h->active, wait), TICK_PAIR(h->routed, h->color) };
+    return TickFinish(TickSum(TICK_HUNTERS, w, sizeof(w) / sizeof(w[0])));
+}
+
+// Row i of the planes, by its place in them and not by the screen row it is on: falling
+// only moves top[], so a row is hashed again only when a star left or joined it
+static inline uint64_t TickHashRainRow(const STAR_RAIN* r, long i)
+{
+    return TickHashWords(TICK_RAIN + (uint64_t)i * 0x9e3779b97f4a7c15ULL, r->plane + i * r->words, r->words);
+}
+
+// The header, and the sum of the row hashes kept up to date with the rows the rain touched.
+// Without memory for the row hashes every row is hashed every tick, to the same hash.
+static uint64_t TickHashRain(TICK_HISTORY* t, STAR_RAIN* r, int all)
+{
+    long rows = (long)RAIN_CLASSES * r->rows;
+    if (all || t->rain_rows != rows) {
+        if (t->rain_rows != rows) {
+            free(t->rain_row);
+            t->rain_row = (uint64_t*)malloc(rows * sizeof(uint64_t));
+            t->rain_rows = t->rain_row ? rows : 0;
+        }
+        t->rain_sum = 0;
+        for (long i = 0; i < rows; i++) {
+            uint64_t h = TickHashRainRow(r, i);
+            if (t->rain_row) t->rain_row[i] = h;
+            t->rain_sum += h;
+        }
+        memset(r->touched, 0, rows);
+    } else {
+        for (long c = 0; c < r->changes; c++) {
+            long i = r->changed[c];
+            uint64_t h = TickHashRainRow(r, i);
+            t->rain_sum += h - t->rain_row[i];
+            t->rain_row[i] = h;
+            r->touched[i] = 0;
+        }
+    }
+    r->changes = 0;
+    uint64_t w[2 + RAIN_CLASSES / 2] = { (uint64_t)r->frame, (uint64_t)r->stars };
+    for (int k = 0; k < RAIN_CLASSES; k += 2) w[2 + k / 2] = TICK_PAIR(r->top[k], r->top[k + 1]);
+    return TickFinish(TickSum(TICK_RAIN + t->rain_sum, w, sizeof(w) / sizeof(w[0])));
+}
+
+void TickHistoryFree(TICK_HISTORY* t)
+{
+    if (!t) return;
+    free(t->change);
+    free(t->rain_row);
+    free(t->leaf);
+    free(t->node);
+    free(t);
+}
+
+// Room for ticks ticks, NULL if memory runs out
+TICK_HISTORY* TickHistoryCreate(long ticks)
+{
+    uint64_t k = TICK_MAGIC;
+    for (int i = 0; i <= TICK_KEYS; i++) {
+        // splitmix64, odd so every product keeps the low bits of its word
+        uint64_t z = (k += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        tick_keys[i] = (z ^ (z >> 31)) | 1;
+    }
+    TICK_HISTORY* t = (TICK_HISTORY*)calloc(1, sizeof(TICK_HISTORY));
+    if (!t) return NULL;
+    t->capacity = ticks;
+    t->change = (TICK_CHANGE*)malloc(ticks * TICK_ENTITIES * sizeof(TICK_CHANGE));
+    t->leaf = (uint64_t*)malloc(ticks * TICK_ENTITIES * sizeof(uint64_t));
+    t->node = (uint64_t*)malloc(2 * ticks * sizeof(uint64_t) + sizeof(uint64_t));
+    if (!t->change || !t->leaf || !t->node) {
+        TickHistoryFree(t);
+        return NULL;
+    }
+    // touched now, not a page at a time in the middle of the game
+    memset(t->change, 0, ticks * TICK_ENTITIES * sizeof(TICK_CHANGE));
+    memset(t->node, 0, 2 * ticks * sizeof(uint64_t) + sizeof(uint64_t));
+    return t;
+}
+
+// A new game: every entity is hashed on its first tick
+void TickHistoryReset(TICK_HISTORY* t)
+{
+    t->ticks = 0;
+    t->full = 0;
+    t->rehash = 1;
+    t->changes = 0;
+    t->sum = 0;
+    memset(t->hash, 0, sizeof(t->hash));
+}
+
+// Entity i's hash after this tick, logged and folded into the tick hash if it changed
+static inline void TickSet(TICK_HISTORY* t , int i , uint64_t h)
+{
+    if (h == t->hash[i]) return;
+    t->sum += (h - t->hash[i]) * tick_keys[i];
+    t->hash[i] = h;
+    t->change[t->changes++] = (TICK_CHANGE){ (uint32_t)t->ticks, (uint32_t)i, h };
+}
+
+// After every SessionTick of the game
+void TickHistoryRecord(TICK_HISTORY* t , const GAME_SESSION* gs)
+{
+    if (t->ticks == t->capacity) {
+        t->full = 1;
+        return;
+    }
+    const FLOCK* f = &gs->flock;
+    int all = t->rehash;
+    TickSet(t, TICK_GAME, TickHashGame(gs));
+    for (int i = 0; i < f->count; i++) {
+        BIRD* b = f->bird[i];
+        if (b->dirty || all) TickSet(t, TICK_BIRDS + i, TickHashBird(b, f->tick));
+        b->dirty = 0;
+    }
+    if (gs->taxi->dirty || all) TickSet(t, TICK_TAXI, TickHashTaxi(gs->taxi, f));
+    gs->taxi->dirty = 0;
+    for (int i = 0; i < MAX_STARS; i++) {
+        STAR* s = gs->star[i];
+        if (s->dirty || all) TickSet(t, TICK_STARS + i, TickHashStar(s, f->tick));
+        s->dirty = 0;
+    }
+    for (int i = 0; i < MAX_HUNTERS; i++) {
+        HUNTER* h = gs->hunter[i];
+        if (h->dirty || all) TickSet(t, TICK_HUNTERS + i, TickHashHunter(h, f->tick));
+        h->dirty = 0;
+    }
+    if (gs->rain) TickSet(t, TICK_RAIN, TickHashRain(t, gs->rain, all));
+    t->rehash = 0;
+    t->node[t->ticks++] = TickFinish(TICK_MAGIC + t->sum);
+}
+
+// Writes every tick's row of entity hashes into leaf, from the changes
+void TickHistoryRows(TICK_HISTORY* t)
+{
+    uint64_t row[TICK_ENTITIES] = {0};
+    long c = 0;
+    for (long tick = 0; tick < t->ticks; tick++) {
+        for (; c < t->changes && t->change[c].tick == (uint32_t)tick; c++) row[t->change[c].entity] = t->change[c].hash;
+        memcpy(t->leaf + tick * TICK_ENTITIES, row, sizeof(row));
+    }
+}
+
+// Builds the tree above the tick hashes, returns its number of levels
+static int TickTree(uint64_t* node, long ticks)
+{
+    int levels = 1;
+    for (long n = ticks, at = 0; n > 1; n = (n + 1) / 2, levels++) {
+        uint64_t* up = node + at + n;
+        for (long i = 0; i < n; i += 2) up[i / 2] = TickJoin(node[at + i], i + 1 < n ? node[at + i + 1] : 0);
+        at += n;
+    }
+    return levels;
+}
+
+// Writes the game's history, seed and dt as played. Returns 0 if file cannot be written.
+int TickHistorySave(TICK_HISTORY* t , const char* file , unsigned int seed , int dt)
+{
+    if (t->ticks == 0) t->node[0] = 0;
+    TickHistoryRows(t);
+    TICK_FILE h = { TICK_MAGIC, TICK_VERSION, TICK_ENTITIES, 0, (uint64_t)t->ticks, seed, dt };
+    h.levels = (uint32_t)TickTree(t->node, t->ticks);
+    long nodes = 0;
+    for (long n = t->ticks, l = 0; l < (long)h.levels; l++, n = (n + 1) / 2) nodes += n ? n : 1;
+    FILE* out = fopen(file, "wb");
+    if (!out) return 0;
+    int ok = fwrite(&h, sizeof(h), 1, out) == 1 &&
+             fwrite(t->leaf, sizeof(uint64_t) * TICK_ENTITIES, t->ticks, out) == (size_t)t->ticks &&
+             fwrite(t->node, sizeof(uint64_t), nodes, out) == (size_t)nodes;
+    return fclose(out) == 0 && ok;
+}
+
+// Entity i of a row as text, "bird 2", "hunter 0" and so on
+static void TickEntityName(int i , char* out , size_t size)
+{
+    if (i == TICK_GAME) snprintf(out, size, "game (timer, level, settings)");
+    else if (i < TICK_TAXI) snprintf(out, size, "bird %d", i - TICK_BIRDS);
+    else if (i == TICK_TAXI) snprintf(out, size, "taxi");
+    else if (i < TICK_HUNTERS) snprintf(out, size, "star %d", i - TICK_STARS);
+    else if (i < TICK_RAIN) snprintf(out, size, "hunter %d", i - TICK_HUNTERS);
+    else snprintf(out, size, "rain");
+}
+
+
+//============================//
+// ACTORS AND PHYSICS        //
+//==========================//
+
+// ___________BIRD___________//
+
+
+void ResetBird(BIRD* b, WIN* w, int x, int y, int dx, int dy , GameConfig *config)
+{
+    // Set bird properties
+    b->win = w;            // window containing bird
+    b->x = x;            // initial x position
+    b->y = y;            // initial y position
+    b->dx = dx;            // direction: -1=left, 1=right
+    b->dy = dy;            // direction: -1=up, 1=down
+    b->speed = config->swallow_speed_min;  // movement speed from the configuration
+    b->counter = 0;
+    b->symbol = BIRD_SYMBOL;        // display character
+    b->width = BIRD_WIDTH;
+    b->color = BIRD_COLOR;    // color scheme
+    b->score = 0;
+    b->life = 100;
+    b->max_life = 100;
+    b->on_taxi = 0;
+    b->dirty = 1;
+    b->last_x = x;
+    b->last_y = y;
+    for (int f = 0; f < MAX_DT; f++) {
+        b->path_x[f] = x;
+        b->path_y[f] = y;
+    }
+}
+
+BIRD* InitBird(WIN* w, int x, int y, int dx, int dy , GameConfig *config)
+{
+    // Allocate memory for BIRD structure
+    BIRD* b = (BIRD*)malloc(sizeof(BIRD));
+    ResetBird(b, w, x, y, dx, dy, config);
+    return b;
+}
+
+void DrawBird(BIRD* b)
+{
+    if (HEADLESS(b->win)) return;
+    // Set bird color
+    wattron(b->win->window, COLOR_PAIR(b->color));
+
+    // Draw bird symbol at current position
+    mvwprintw(b->win->window, b->y, b->x, "%s", b->symbol);
+
+    // Restore window color
+    wattron(b->win->window, COLOR_PAIR(b->win->color));
+}
+
+void ClearBird(BIRD* b)
+{
+    if (HEADLESS(b->win)) return;
+    // Overwrite bird with a space character
+    mvwprintw(b->win->window, b->y, b->x,"     ");
+}
+
+void UpdateBirdColor(BIRD* b)
+{
+    // We change the color ID based on how much life is left.
+    // Note: These color pair IDs (4, 6, 5) must match what we defined in screen.c/Start()
+    
+    if (b->life > 66) {
+        b->color = BIRD_COLOR;
+    } else if (b->life > 33) {
+        b->color = INJURED_BIRD;
+    } else {
+        b->color = HUNTER_COLOR; // Pair 5 = Red (Critical)
+    }
+}
+
+// Moves the bird one cell, bouncing off the border
+// cols x rows is the bird's window and bird_size its width
+ALWAYS_INLINE void StepBirdWith(BIRD* b, int cols, int rows, int bird_size)
+{
+    // Step 1: Erase bird from old position
+    ClearBird(b);
+    int old_x = b->x;
+    int old_y = b->y;
+    b->dirty = 1;
+    // Step 2: Check if bird is already at boundary
+    // If at boundary, only reverse direction - don't move!
+    int at_x_boundary = (b->x <= BORDER) || (b->x >= cols - BORDER - 1);
+    int at_y_boundary = (b->y <= BORDER) || (b->y >= rows - BORDER - 1);
+    
+    // Step 3: Handle horizontal movement
+    if (at_x_boundary) {
+        // Already at X boundary - just reverse direction if needed
+        if (b->x <= BORDER) {
+            b->dx = 1;     // Change direction to right
+        }
+        else if (b->x >= cols - BORDER - bird_size) {
+            b->dx = -1;    // Change direction to left
+        }
+        // Don't change X position!
+    }
+    // Not at boundary - calculate new position
+    int new_x = b->x + b->dx;
+    
+    // Check if new position would hit boundary
+    if (new_x <= BORDER) {
+        b->x = BORDER;
+        b->dx = 1;
+    }
+    else if (new_x >= cols - BORDER - bird_size) {
+        b->x = cols - BORDER - bird_size;
+        b->dx = -1;
+    }
+    else {
+        b->x = new_x;    // Accept new position
+    }
+    
+    if (at_y_boundary) {
+        // Already at Y boundary - just reverse direction if needed
+        if (b->y <= BORDER) {
+            b->dy = 1;    // Change direction to down
+        }
+        else if (b->y >= rows - BORDER - 1) {
+            b->dy = -1;    // Change direction to up
+        }
+        // Don't change Y position!
+    }
+    // Not at boundary - calculate new position
+    int new_y = b->y + b->dy;
+    
+    // Check if new position would hit boundary
+    if (new_y <= BORDER) {
+        b->y = BORDER;
+        b->dy = 1;
+    }
+    else if (new_y >= rows - BORDER - 1) {
+        b->y = rows - BORDER - 1;
+        b->dy = -1;
+    }
+    else {
+        b->y = new_y;    // Accept new position
+    }
+    
+    // Step 4: Walls of the map stop the bird like the border, it turns back where it was
+    const MAP* map = b->win->map;
+    if (map) {
+        if (b->x != old_x && MapBlocked(map, b->x, old_y, bird_size, 1)) {
+            b->x = old_x;
+            b->dx = -b->dx;
+        }
+        if (b->y != old_y && MapBlocked(map, b->x, b->y, bird_size, 1)) {
+            b->y = old_y;
+            b->dy = -b->dy;
+        }
+    }
+    
+    // Step 5: Draw bird at new position
+    UpdateBirdColor(b);
+    DrawBird(b);
+}
+
+void StepBird(BIRD* b)
+{
+    StepBirdWith(b, b->win->cols, b->win->rows, b->width);
+}
+
+// dt is the number of frames simulated in this call (1 when playing)
+ALWAYS_INLINE void MoveBirdWith(BIRD* b , int dt , int cols , int rows , int bird_size)
+{
+    b->last_x = b->x;
+    b->last_y = b->y;
+    for (int f = 0; f < dt; f++) {
+        b->counter += b->speed;
+        while(b->counter >= THRESHOLD){
+            b->counter -= THRESHOLD;
+            StepBirdWith(b, cols, rows, bird_size);
+        }
+        // where the bird was at the end of every frame, so stars can be caught frame by frame
+        b->path_x[f] = b->x;
+        b->path_y[f] = b->y;
+    }
+}
+
+void MoveBird(BIRD* b , int dt)
+{
+    MoveBirdWith(b, dt, b->win->cols, b->win->rows, b->width);
+}
+
+void SpeedUp(BIRD* b , GameConfig *config)
+{
+    if(b->speed < config->swallow_speed_max){
+        b->speed++;
+    }
+}
+
+void SpeedDown(BIRD* b , GameConfig *config)
+{
+    if(b->speed > config->swallow_speed_min){
+        b->speed--;
+    }
+}
+
+void UpBird(BIRD* b)
+{
+    b->dy = -1;
+    b->dx = 0;
+}
+
+void DownBird(BIRD* b)
+{
+    b->dy = 1;
+    b->dx = 0;
+
+}
+
+void RightBird(BIRD* b)
+{
+    b->dx = 1;
+    b->dy = 0;
+}
+
+void LeftBird(BIRD* b)
+{
+    b->dx = -1;
+    b->dy = 0;
+}
+
+// Applies a player's key to their bird, keys as the first player has them
+void SteerBird(BIRD* bird , TAXI* taxi , GameConfig *config , int ch)
+{
+    int dx = bird->dx, dy = bird->dy, speed = bird->speed;
+    if (ch == UP) {
+        UpBird(bird);
+    }else if(ch == DOWN){
+        DownBird(bird);
+    }else if(ch == RIGHT){
+        RightBird(bird);
+    }else if(ch == LEFT){
+        LeftBird(bird);
+    }else if(ch == SPEED_UP){
+        SpeedUp(bird , config);
+    }else if(ch == SPEED_DOWN){
+        SpeedDown(bird , config);
+    }else if(ch == ACTIVATE_TAXI && !taxi->active && config->available_taxis > 0){
+        taxi->active = 1;
+        taxi->state = 0;
+        taxi->dirty = 1;
+        config->available_taxis--;
+    }
+    if (bird->dx != dx || bird->dy != dy || bird->speed != speed) bird->dirty = 1;
+}
+
+//_________________FLOCK________//
+
+// The other birds show their number instead of the O
+static const char* BIRD_SYMBOLS[MAX_BIRDS] = {
+    BIRD_SYMBOL, "/|2|\\", "/|3|\\", "/|4|\\", "/|5|\\", "/|6|\\", "/|7|\\", "/|8|\\"
+};
+
+static inline int BirdAlive(const BIRD* b)
+{
+    return b->life > 0;
+}
+
+void IndexFlock(FLOCK* f , int dt);
+
+// Sets up count birds, which f->bird[] must already point to, spread along the middle row
+// of w, and the grid over w
+void ResetFlock(FLOCK* f , int count , WIN* w , GameConfig *config)
+{
+    f->count = count;
+    f->flow = NULL;
+    f->tick = 0;
+    f->cell_w = (w->cols + BIRD_GRID - 1) / BIRD_GRID;
+    f->cell_h = (w->rows + BIRD_GRID - 1) / BIRD_GRID;
+    if (f->cell_w < BIRD_CELL) f->cell_w = BIRD_CELL;
+    if (f->cell_h < BIRD_CELL) f->cell_h = BIRD_CELL;
+    f->grid_cols = (w->cols + f->cell_w - 1) / f->cell_w;
+    f->grid_rows = (w->rows + f->cell_h - 1) / f->cell_h;
+    memset(f->grid, 0, sizeof(f->grid));
+    for (int i = 0; i < count; i++) {
+        ResetBird(f->bird[i], w, config->screen_width * (i + 1) / (count + 1), config->screen_height/2,
+                  i % 2 ? -1 : 1, 0 , config);
+        f->bird[i]->symbol = (char*)BIRD_SYMBOLS[i];
+        // a map may have a wall on the start, take the closest open row above or below
+        BIRD* b = f->bird[i];
+        for (int k = 1; w->map && MapBlocked(w->map, b->x, b->y, b->width, 1) && k < w->rows; k++) {
+            int y = config->screen_height/2 + (k % 2 ? -(k + 1) / 2 : k / 2);
+            if (y > BORDER && y < w->rows - BORDER - 1) b->y = b->last_y = y;
+        }
+        for (int k = 0; k < MAX_DT; k++) b->path_y[k] = b->y;
+        f->rect[i][0] = 0;
+        f->rect[i][2] = -1;
+    }
+    IndexFlock(f , 1);
+}
+
+static inline int FlockCell(int v , int size , int cells)
+{
+    v = v < 0 ? 0 : v / size;
+    return v < cells ? v : cells - 1;
+}
+
+// Puts every living bird into the grid cells its last move (dt frames) went through.
+// A single bird is not put anywhere, the lookups below go straight to it.
+void IndexFlock(FLOCK* f , int dt)
+{
+    for (int i = 0; i < f->count; i++) {
+        int* r = f->rect[i];
+        for (int y = r[1]; y <= r[3] && r[0] <= r[2]; y++) {
+            for (int x = r[0]; x <= r[2]; x++) f->grid[y * BIRD_GRID + x] &= ~(1u << i);
+        }
+        r[2] = -1;
+    }
+    if (f->count == 1) return;
+    for (int i = 0; i < f->count; i++) {
+        BIRD* b = f->bird[i];
+        if (!BirdAlive(b)) continue;
+        int x0 = b->x < b->last_x ? b->x : b->last_x, x1 = b->x > b->last_x ? b->x : b->last_x;
+        int y0 = b->y < b->last_y ? b->y : b->last_y, y1 = b->y > b->last_y ? b->y : b->last_y;
+        for (int k = 0; k < dt && !b->on_taxi; k++) {   // a bounce can take the path outside that box
+            if (b->path_x[k] < x0) x0 = b->path_x[k];
+            if (b->path_x[k] > x1) x1 = b->path_x[k];
+            if (b->path_y[k] < y0) y0 = b->path_y[k];
+            if (b->path_y[k] > y1) y1 = b->path_y[k];
+        }
+        int* r = f->rect[i];
+        r[0] = FlockCell(x0, f->cell_w, f->grid_cols);
+        r[1] = FlockCell(y0, f->cell_h, f->grid_rows);
+        r[2] = FlockCell(x1 + b->width - 1, f->cell_w, f->grid_cols);
+        r[3] = FlockCell(y1, f->cell_h, f->grid_rows);
+        for (int y = r[1]; y <= r[3]; y++) {
+            for (int x = r[0]; x <= r[2]; x++) f->grid[y * BIRD_GRID + x] |= 1u << i;
+        }
+    }
+}
+
+// Bits of the birds that may have been inside the board rectangle x0..x1 , y0..y1 this tick
+static inline unsigned int FlockNear(const FLOCK* f , int x0 , int y0 , int x1 , int y1)
+{
+    unsigned int near = 0;
+    x0 = FlockCell(x0, f->cell_w, f->grid_cols);
+    x1 = FlockCell(x1, f->cell_w, f->grid_cols);
+    y0 = FlockCell(y0, f->cell_h, f->grid_rows);
+    y1 = FlockCell(y1, f->cell_h, f->grid_rows);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) near |= f->grid[y * BIRD_GRID + x];
+    }
+    return near;
+}
+
+// The living bird closest to (x, y), the lowest number on a tie. The grid is searched in
+// rings of cells around (x, y) and stops once no unseen bird can be closer than the best.
+// With no bird left (the game is over then) it is the first one.
+BIRD* NearestBird(const FLOCK* f , double x , double y)
+{
+    if (f->count == 1) return f->bird[0];
+    int cx = FlockCell((int)x, f->cell_w, f->grid_cols);
+    int cy = FlockCell((int)y, f->cell_h, f->grid_rows);
+    int step = f->cell_w < f->cell_h ? f->cell_w : f->cell_h;
+    int rings = f->grid_cols > f->grid_rows ? f->grid_cols : f->grid_rows;
+    unsigned int seen = 0;
+    int best = -1;
+    double best_d = 0;
+    for (int r = 0; r < rings; r++) {
+        for (int gy = cy - r; gy <= cy + r; gy++) {
+            if (gy < 0 || gy >= f->grid_rows) continue;
+            int edge = gy == cy - r || gy == cy + r;
+            for (int gx = cx - r; gx <= cx + r; gx += edge ? 1 : 2 * r) {
+                if (gx < 0 || gx >= f->grid_cols) continue;
+                unsigned int m = f->grid[gy * BIRD_GRID + gx] & ~seen;
+                seen |= m;
+                while (m) {
+                    int i = __builtin_ctz(m);
+                    m &= m - 1;
+                    const BIRD* b = f->bird[i];
+                    double d = (b->x - x) * (b->x - x) + (b->y - y) * (b->y - y);
+                    if (best < 0 || d < best_d || (d == best_d && i < best)) {
+                        best = i;
+                        best_d = d;
+                    }
+                }
+            }
+        }
+        // unseen birds are in a cell outside ring r, so more than r cells away
+        if (best >= 0 && best_d <= (double)r * step * r * step) break;
+    }
+    return best >= 0 ? f->bird[best] : f->bird[0];
+}
+
+void DrawFlock(FLOCK* f)
+{
+    for (int i = 0; i < f->count; i++) {
+        if (BirdAlive(f->bird[i])) DrawBird(f->bird[i]);
+    }
+}
+
+//_________________FLOW FIELD________//
+
+#define FLOW_FAR 0xFFFF
+#define FLOW_DIRECT 8       // the straight line to the bird is a shortest route, aim at it
+#define FLOW_NONE 9         // no route, or a cell the hunter cannot be in
+
+static const int FLOW_DX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int FLOW_DY[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+// Bytes InitFlowField needs for a cols x rows board
+size_t FlowFieldSize(int cols , int rows)
+{
+    size_t cells = (size_t)cols * rows;
+    return sizeof(FLOW_FIELD) + cells * (4 * sizeof(uint8_t) + sizeof(uint16_t) + sizeof(int32_t)) + 4 * ARENA_ALIGN;
+}
+
+static inline int FlowOpen(const FLOW_FIELD* f , int x , int y)
+{
+    return x >= 0 && y >= 0 && x < f->cols && y < f->rows && f->open[y * f->cols + x];
+}
+
+// Lays the field out in mem (FlowFieldSize bytes) for hunters of config on w's board.
+// Which steps are possible is worked out here, once, so a search only reads bytes:
+// diagonals need both sides open too, so a route never cuts the corner of a wall.
+FLOW_FIELD* InitFlowField(void* mem , const WIN* w , const GameConfig* config)
+{
+    if (!mem) return NULL;
+    FLOW_FIELD* f = (FLOW_FIELD*)mem;
+    size_t cells = (size_t)w->cols * w->rows;
+    unsigned char* p = (unsigned char*)(f + 1);
+    f->queue = (int32_t*)(((uintptr_t)p + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+    f->dist = (uint16_t*)(f->queue + cells);
+    f->open = (uint8_t*)(f->dist + cells);
+    f->moves = f->open + cells;
+    f->target = f->moves + cells;
+    f->want = f->target + cells;
+    f->map = w->map;
+    f->cols = w->cols;
+    f->rows = w->rows;
+    f->hw = config->hunter_width;
+    f->hh = config->hunter_height;
+    f->count = -1;
+    f->head = f->tail = 0;
+    f->builds = 0;
+    memset(f->want, 0, cells);
+    for (int y = 0; y < f->rows; y++) {
+        for (int x = 0; x < f->cols; x++) {
+            // the same limits BounceWith keeps the hunter in
+            int inside = x >= BORDER && x <= f->cols - BORDER - f->hw && y >= BORDER && y <= f->rows - BORDER - f->hh;
+            f->open[y * f->cols + x] = inside && !(f->map && MapBlocked(f->map, x, y, f->hw, f->hh));
+        }
+    }
+    for (int k = 0; k < 8; k++) f->step[k] = FLOW_DY[k] * f->cols + FLOW_DX[k];
+    for (int y = 0; y < f->rows; y++) {
+        for (int x = 0; x < f->cols; x++) {
+            uint8_t m = 0;
+            for (int k = 0; k < 8 && f->open[y * f->cols + x]; k++) {
+                int nx = x + FLOW_DX[k], ny = y + FLOW_DY[k];
+                if (FlowOpen(f, nx, ny) && FlowOpen(f, nx, y) && FlowOpen(f, x, ny)) m |= 1u << k;
+            }
+            f->moves[y * f->cols + x] = m;
+        }
+    }
+    return f;
+}
+
+static inline int FlowCell(const FLOW_FIELD* f , const HUNTER* h)
+{
+    int x = (int)h->x, y = (int)h->y;
+    return x >= 0 && y >= 0 && x < f->cols && y < f->rows ? y * f->cols + x : -1;
+}
+
+// Brings the distances up to date for this tick: a new breadth first search from the birds
+// when one of them moved to another cell or died, and in any case the search goes on until
+// every active hunter's cell has its distance. Every step costs 1 and the search starts from
+// all birds at once, so each cell is reached once, from its closest bird, and the work per
+// tick is at most one pass over the board however many hunters read it.
+void UpdateFlowField(FLOW_FIELD* f , const FLOCK* flock , HUNTER* hunters[] , int n)
+{
+    int same = f->count == flock->count;
+    for (int i = 0; i < flock->count; i++) {
+        const BIRD* b = flock->bird[i];
+        int x = BirdAlive(b) ? b->x : -1, y = BirdAlive(b) ? b->y : -1;
+        same = same && f->key[i][0] == x && f->key[i][1] == y;
+        f->key[i][0] = x;
+        f->key[i][1] = y;
+    }
+    if (!same) {
+        f->count = flock->count;
+        f->builds++;
+        f->head = f->tail = 0;
+        memset(f->dist, 0xFF, (size_t)f->cols * f->rows * sizeof(uint16_t));
+        // a hunter at any of these corners overlaps the bird
+        for (int i = 0; i < flock->count; i++) {
+            const BIRD* b = flock->bird[i];
+            if (!BirdAlive(b)) continue;
+            for (int y = b->y - f->hh + 1; y <= b->y; y++) {
+                for (int x = b->x - f->hw + 1; x <= b->x + b->width - 1; x++) {
+                    if (!FlowOpen(f, x, y) || f->dist[y * f->cols + x] != FLOW_FAR) continue;
+                    f->dist[y * f->cols + x] = 0;
+                    f->target[y * f->cols + x] = (uint8_t)i;
+                    f->queue[f->tail++] = y * f->cols + x;
+                }
+            }
+        }
+    }
+    int pending = 0;
+    for (int i = 0; i < n; i++) {
+        int c = hunters[i]->active ? FlowCell(f, hunters[i]) : -1;
+        if (c < 0 || f->dist[c] != FLOW_FAR || !f->open[c] || f->want[c]) continue;
+        f->want[c] = 1;
+        pending++;
+    }
+    while (pending > 0 && f->head < f->tail) {
+        int c = f->queue[f->head++];
+        uint16_t d = f->dist[c] + 1;
+        for (unsigned int m = f->moves[c]; m; m &= m - 1) {
+            int next = c + f->step[__builtin_ctz(m)];
+            if (f->dist[next] != FLOW_FAR) continue;
+            f->dist[next] = d;
+            f->target[next] = f->target[c];
+            f->queue[f->tail++] = next;
+            if (f->want[next]) {
+                f->want[next] = 0;
+                pending--;
+            }
+        }
+    }
+    if (pending > 0) {      // cut off from every bird
+        for (int i = 0; i < n; i++) {
+            int c = FlowCell(f, hunters[i]);
+            if (c >= 0) f->want[c] = 0;
+        }
+    }
+}
+
+// The way on from (x, y): FLOW_DIRECT, FLOW_NONE or a direction of FLOW_DX / FLOW_DY, the
+// step closest to the straight line to the bird among those that shorten the route. All the
+// cells one step closer were reached before (x, y) was, so this only needs its neighbours.
+static inline int FlowDir(const FLOW_FIELD* f , const FLOCK* flock , int x , int y)
+{
+    if (x < 0 || y < 0 || x >= f->cols || y >= f->rows) return FLOW_NONE;
+    int c = y * f->cols + x;
+    if (f->dist[c] == FLOW_FAR) return FLOW_NONE;
+    if (f->dist[c] == 0) return FLOW_DIRECT;
+    const BIRD* b = flock->bird[f->target[c]];
+    float tx = (float)(b->x - x), ty = (float)(b->y - y);
+    int best = -1, line = -1;
+    float best_cos = -1e30f, line_cos = -1e30f;
+    unsigned int m = f->moves[c];
+    for (int k = 0; k < 8; k++) {
+        float cos = (FLOW_DX[k] * tx + FLOW_DY[k] * ty) * (k & 1 ? (float)M_SQRT1_2 : 1.0f);
+        if (cos > line_cos) {
+            line = k;
+            line_cos = cos;
+        }
+        if ((m >> k & 1) && f->dist[c + f->step[k]] < f->dist[c] && cos > best_cos) {
+            best = k;
+            best_cos = cos;
+        }
+    }
+    return best == line ? FLOW_DIRECT : best;
+}
+
+//_________________HUNTER________//
+
+//
+//  hunter.c
+//  project_test
+//
+//  Created by Mateusz Ciesielczyk on 29/11/2025.
+//
+
+
+// (Re)spawns h on a random side aimed at the nearest bird, drawing from the hunter's own stream
+// tick is the frame the hunter shows up on, its draws are keyed with it
+void SpawnHunter(HUNTER* h , WIN *w, const FLOCK* flock , GameConfig *config , uint32_t tick)
+{
+    h->win = w;
+    h->speed = config->hunter_speed;
+    h->color = HUNTER_COLOR;
+    h->damage = config->damage_penalty;
+    
+    // Using config value for bounces
+    h->bounces = (GameRandAt(h->seed, tick, h->id, RAND_HUNTER_BOUNCES, 0) % 3) + config->hunter_bounces;
+    h->width = config->hunter_width;
+    h->height = config->hunter_height;
+    h->solid = config->hunter_solid;
+    memcpy(h->mask, config->hunter_mask, sizeof(h->mask));
+    h->active = 1;
+    h->wait_dash = 0;
+    h->routed = 0;
+    h->dirty = 1;
+    
+    // Spawn Logic, again while the spot is inside a wall of the map
+    for (int tries = 0; tries == 0 || (w->map && tries < MAP_SPAWN_TRIES &&
+                                       MapBlocked(w->map, (int)h->x, (int)h->y, h->width, h->height)); tries++) {
+        int side = GameRandAt(h->seed, tick, h->id, RAND_HUNTER_SIDE, tries) % 4;
+        int spot = GameRandAt(h->seed, tick, h->id, RAND_HUNTER_SPOT, tries);
+        if(side == 0) {  // Top
+               h->y = BORDER + 1;
+               h->x = (spot % (w->cols - 2 * BORDER - 2 - h->width)) + BORDER + 1;
+           }
+           else if(side == 1) {  // Right
+               h->x = w->cols - BORDER - h->width;
+               h->y = (spot % (w->rows - 2 * BORDER - 2 - h->height)) + BORDER + 1;
+           }
+           else if(side == 2) {  // Bottom
+               h->y = w->rows - BORDER - h->height;
+               h->x = (spot % (w->cols - 2 * BORDER - 2 - h->width)) + BORDER + 1;
+           }
+           else {  // Left
+               h->x = BORDER + 1;
+               h->y = (spot % (w->rows - 2 * BORDER - 2 - h->height)) + BORDER + 1;
+           }
+    }
+    if (w->map && MapBlocked(w->map, (int)h->x, (int)h->y, h->width, h->height)) h->active = 0;
+    BIRD* b = NearestBird(flock , h->x , h->y);
+    double diffx = b->x - h->x;
+    double diffy = b->y - h->y;
+    double length = sqrt( (b->x - h->x)*(b->x - h->x) +  (b->y - h->y)*(b->y - h->y));
+    if (length != 0) {
+            h->dx = (diffx / length) ;
+            h->dy = (diffy / length) ;
+        } else {
+            h->dx = 0; h->dy = 0;
+        }
+}
+
+// id is the hunter's slot, which keys its random draws
+void ResetHunter(HUNTER* h , int id , WIN *w, const FLOCK* flock , GameConfig *config)
+{
+    h->seed = GameKey();
+    h->id = id;
+    SpawnHunter(h , w , flock , config , flock->tick);
+}
+
+HUNTER* InitHunter(int id , WIN *w, const FLOCK* flock , GameConfig *config)
+{
+    HUNTER* h = (HUNTER*)malloc(sizeof(HUNTER));
+    ResetHunter(h , id , w , flock , config);
+    return h;
+}
+
+// Sets up MAX_HUNTERS hunters in h[], which must already point to memory for them
+void ResetMultipleHunter(HUNTER* h[] , WIN* w , const FLOCK* flock , GameConfig *config){
+    for(int i =0 ; i < MAX_HUNTERS ; i++){
+        ResetHunter(h[i] , i , w , flock , config);
+        if (i >= config->hunter_num) {
+            h[i]->active = 0;    // the spawned ones stay active unless walls left them no spot
+        }
+    }
+}
+
+ALWAYS_INLINE void DrawHunterWith(HUNTER* h , int hw , int hh , int solid)
+{
+    if (HEADLESS(h->win)) return;
+    wattron(h->win->window, COLOR_PAIR(h->color));
+    int numposx = hw / 2;
+    int numposy = hh / 2;
+    for(int i =0 ; i < hh ; i++){
+        for(int j = 0; j < hw ; j++){
+            if(!solid && !(h->mask[i] >> j & 1)) continue; // hollow part of the shape
+            if(i == numposy && j == numposx){
+                mvwprintw(h->win->window, h->y + i, h->x + j, "%d", h->bounces);
+            }
+            else
+            {
+                mvwprintw(h->win->window, h->y + i, h->x + j, "#");
+            }
+        }
+    }
+    wattron(h->win->window, COLOR_PAIR(h->win->color));
+
+}
+
+void DrawHunter(HUNTER* h)
+{
+    DrawHunterWith(h , h->width , h->height , h->solid);
+}
+
+void DrawMultipleHunters(HUNTER* h[] , GameConfig *config){
+    for(int i =0 ; i < config->hunter_num ; i++){
+        DrawHunter(h[i]);
+    }
+}
+
+ALWAYS_INLINE void ClearHunterWith(HUNTER* h , int hw , int hh , int solid)
+{
+    if (HEADLESS(h->win)) return;
+    for(int i =0 ; i < hh ; i++){
+        for(int j = 0; j < hw ; j++){
+            if(!solid && !(h->mask[i] >> j & 1)) continue;
+            mvwprintw(h->win->window, (int)(h->y + i), (int)(h->x + j)," ");
+
+        }
+    }
+
+}
+
+void ClearHunter(HUNTER* h)
+{
+    ClearHunterWith(h , h->width , h->height , h->solid);
+}
+
+// (x0, y0) is where the hunter started this frame, id is the bird's number in the flock
+ALWAYS_INLINE void CheckHunterBirdWith(HUNTER* h , BIRD* b , int id , double x0 , double y0 , FRAME_EFFECTS* fx ,
+                                       int hw , int hh , int solid , int bird_width){
+    if(b->on_taxi == 1){
+        return;
+    }
+    else if (SweptHunterHitsBoxWith(h, x0, y0, b->last_x, b->last_y, b->x, b->y, bird_width, 1, hw, hh, solid)) {
+        h->active = 0;
+        h->dirty = 1;
+        fx->damage[id] += h->damage;
+        TraceEvent(TRACE_BIRD_DAMAGED, h->id, h->damage, b->x, b->y);
+        ClearHunterWith(h , hw , hh , solid);
+    }
+}
+
+void CheckHunterBird(HUNTER* h , BIRD* b , int id , double x0 , double y0 , FRAME_EFFECTS* fx){
+    CheckHunterBirdWith(h , b , id , x0 , y0 , fx , h->width , h->height , h->solid , b->width);
+}
+
+// Only the birds the grid has near the hunter's move are tested
+ALWAYS_INLINE void CheckHunterBirdsWith(HUNTER* h , FLOCK* flock , double x0 , double y0 , FRAME_EFFECTS* fx ,
+                                        int hw , int hh , int solid , int bird_width){
+    if (flock->count == 1) {
+        CheckHunterBirdWith(h , flock->bird[0] , 0 , x0 , y0 , fx , hw , hh , solid , bird_width);
+        return;
+    }
+    unsigned int near = FlockNear(flock , (int)fmin(x0, h->x) , (int)fmin(y0, h->y) ,
+                                  (int)fmax(x0, h->x) + hw , (int)fmax(y0, h->y) + hh);
+    while (near && h->active) {
+        int i = __builtin_ctz(near);
+        near &= near - 1;
+        CheckHunterBirdWith(h , flock->bird[i] , i , x0 , y0 , fx , hw , hh , solid , bird_width);
+    }
+}
+
+ALWAYS_INLINE void CheckHunterTaxiWith(HUNTER* h  , TAXI* t , double x0 , double y0 , int hw , int hh , int solid)
+{
+    if (!t->active || !t->state) return ;
+    if (SweptHunterHitsBoxWith(h, x0, y0, t->last_x, t->y, t->x, t->y, SAFE_ZONEW, SAFE_ZONEH, hw, hh, solid)){
+        h->active = 0;
+        h->dirty = 1;
+        ClearHunterWith(h , hw , hh , solid);
+    }
+}
+
+void CheckHunterTaxi(HUNTER* h  , TAXI* t , double x0 , double y0)
+{
+    CheckHunterTaxiWith(h , t , x0 , y0 , h->width , h->height , h->solid);
+}
+
+
+// The move from (x0, y0) is cast against the border so the hunter stops where it
+// actually reached the wall, even when a long frame carried it far past it.
+ALWAYS_INLINE void BounceWith(HUNTER* h, int width , int height , double x0 , double y0 , int dt , int hw , int hh){
+    double min_x = BORDER, max_x = width - BORDER - hw;
+    double min_y = BORDER, max_y = height - BORDER - hh;
+    double vx = h->x - x0;
+    double vy = h->y - y0;
+    double hit = 1;  // fraction of the move done when the first wall is reached
+    if (h->x < min_x && vx < 0) hit = fmin(hit, (min_x - x0) / vx);
+    else if (h->x > max_x && vx > 0) hit = fmin(hit, (max_x - x0) / vx);
+    if (h->y < min_y && vy < 0) hit = fmin(hit, (min_y - y0) / vy);
+    else if (h->y > max_y && vy > 0) hit = fmin(hit, (max_y - y0) / vy);
+    if (h->x >= min_x && h->x <= max_x && h->y >= min_y && h->y <= max_y) return;
+    if (hit < 0) hit = 0;
+    h->x = fmin(fmax(x0 + hit * vx, min_x), max_x);
+    h->y = fmin(fmax(y0 + hit * vy, min_y), max_y);
+    
+    // IF WE HIT A WALL: Stop and Start Timer, the rest of the frame already counts as waiting
+    h->dx = 0;
+    h->dy = 0;
+    h->wait_dash = HUNTER_WAIT - (int)((1 - hit) * dt);
+    if (h->wait_dash < 1) h->wait_dash = 1;
+    h->bounces--;
+}
+
+void Bounce(HUNTER* h, int width , int height , double x0 , double y0 , int dt){
+    BounceWith(h , width , height , x0 , y0 , dt , h->width , h->height);
+}
+
+// Moves the hunter frames frames through the walls of the map, reflecting off them (each
+// wall hit costs a bounce). When the box swept by the whole move holds no wall it is a single
+// lookup, otherwise the hunter goes at most one cell at a time, checking x and y apart.
+ALWAYS_INLINE void MoveHunterOnMapWith(HUNTER* h , const MAP* map , int frames , int hw , int hh)
+{
+    double vx = h->dx * h->speed * frames;
+    double vy = h->dy * h->speed * frames;
+    double x1 = h->x + vx, y1 = h->y + vy;
+    if (!MapWallsIn(map, (int)fmin(h->x, x1), (int)fmin(h->y, y1), (int)fmax(h->x, x1) + hw - 1, (int)fmax(h->y, y1) + hh - 1)) {
+        h->x = x1;
+        h->y = y1;
+        return;
+    }
+    int steps = (int)ceil(fmax(fabs(vx), fabs(vy)));
+    if (steps == 0) return;
+    double sx = vx / steps, sy = vy / steps;
+    for (int i = 0; i < steps; i++) {
+        if (MapBlocked(map, (int)(h->x + sx), (int)h->y, hw, hh)) {
+            sx = -sx;
+            h->dx = -h->dx;
+            h->bounces--;
+        } else {
+            h->x += sx;
+        }
+        if (MapBlocked(map, (int)h->x, (int)(h->y + sy), hw, hh)) {
+            sy = -sy;
+            h->dy = -h->dy;
+            h->bounces--;
+        } else {
+            h->y += sy;
+        }
+    }
+}
+
+// Aims the hunter in a straight line at the nearest bird
+static inline void AimHunter(HUNTER* h , const FLOCK* flock)
+{
+    BIRD* b = NearestBird(flock , h->x , h->y);
+    double length = sqrt( (b->x - h->x)*(b->x - h->x) +  (b->y - h->y)*(b->y - h->y));
+    if (length != 0) {
+        h->dx = ((b->x - h->x) / length) ;
+        h->dy = ((b->y - h->y) / length) ;
+    }
+}
+
+// A hunter cut off from the bird by a wall takes the step the flow field has for its cell,
+// and once the straight line is a shortest route again it goes back to dashing at the bird
+ALWAYS_INLINE void FollowFlowField(HUNTER* h , const FLOCK* flock)
+{
+    int d = FlowDir(flock->flow , flock , (int)h->x , (int)h->y);
+    if (d < FLOW_DIRECT) {
+        double norm = d & 1 ? M_SQRT1_2 : 1.0;
+        h->dx = FLOW_DX[d] * norm;
+        h->dy = FLOW_DY[d] * norm;
+        h->routed = 1;
+    } else if (d == FLOW_DIRECT && h->routed) {
+        AimHunter(h , flock);
+        h->routed = 0;
+    }
+}
+
+// cols x rows is the hunter's window
+ALWAYS_INLINE void MoveHunterWith(HUNTER* h , FLOCK* flock , TAXI* t , int dt , FRAME_EFFECTS* fx ,
+                                  int cols , int rows , int hw , int hh , int solid , int bird_width){
+    if(!h->active) return;
+    ClearHunterWith(h , hw , hh , solid);
+    double x0 = h->x;
+    double y0 = h->y;
+    int frames = dt;  // frames of this tick spent dashing
+    if(h->wait_dash > 0){
+        h->wait_dash -= dt;
+        frames = 0;
+        if(h->wait_dash <= 0){
+            frames = -h->wait_dash;  // a long tick keeps going after the wait ends
+            h->wait_dash = 0;
+            h->dirty = 1;
+            AimHunter(h , flock);
+        }
+    }
+    if (frames > 0 && flock->flow) FollowFlowField(h , flock);
+    if (frames > 0) {
+        h->dirty = 1;
+        if (h->win->map) {
+            MoveHunterOnMapWith(h , h->win->map , frames , hw , hh);
+        } else {
+            h->x += (h->dx * h->speed * frames);
+            h->y += (h->dy * h->speed * frames);
+        }
+        BounceWith(h, cols, rows, x0, y0, frames, hw, hh);
+    }
+    CheckHunterBirdsWith(h , flock , x0 , y0 , fx , hw , hh , solid , bird_width);
+    if(!h->active) return;
+    CheckHunterTaxiWith(h , t , x0 , y0 , hw , hh , solid);
+    if(!h->active) return;
+    if (h->bounces < 0) {
+        h->active = 0;
+        h->dirty = 1;
+    } else {
+        DrawHunterWith(h , hw , hh , solid);
+    }
+}
+
+void MoveHunter(HUNTER* h , FLOCK* flock , TAXI* t , int dt , FRAME_EFFECTS* fx){
+    MoveHunterWith(h , flock , t , dt , fx , h->win->cols , h->win->rows , h->width , h->height , h->solid ,
+                   flock->bird[0]->width);
+}
+
+//_________________HUNTER BOIDS________//
+
+// HUNTER_FLOCKING 1: the dashing hunters also steer by their neighbours, boids style. They keep
+// apart (separation), turn the way the others fly (alignment) and keep together (cohesion),
+// on top of the heading they got from aiming at the bird. The neighbours are found through a
+// cell list of the hunters as they were at the start of the tick, rebuilt every tick, so the
+// hunters can be updated in any order and on any thread.
+#define BOID_RADIUS 8           // board cells a hunter sees others in, and the side of a list cell
+#define BOID_SPACE 4            // closer than this they push each other away
+#define BOID_SEPARATION 1.5
+#define BOID_ALIGNMENT 0.5
+#define BOID_COHESION 0.3
+#define BOID_TURN 0.2           // share of the steering added to the heading per frame
+
+typedef struct{
+    double x, y;
+    double dx, dy;
+    int id;
+} BOID;
+
+// The active hunters sorted by list cell: the ones of cell c are boid[start[c]] .. boid[start[c + 1] - 1]
+typedef struct{
+    int cols, rows;                 // list cells
+    int count;                      // boids
+    int* start;                     // [cols * rows + 1]
+    BOID* boid;
+    int* cell;                      // scratch: list cell of hunter i
+    int cell_capacity, boid_capacity;
+} HUNTER_GRID;
+
+// What a hunter's neighbours add up to
+typedef struct{
+    int n;
+    double sep_x, sep_y;
+    double dir_x, dir_y;
+    double sum_x, sum_y;
+} BOID_SUM;
+
+// grows with the biggest scene this thread has built a list for, like the batch buffers
+static _Thread_local HUNTER_GRID boid_grid;
+
+static inline int BoidCell(double v , int cells)
+{
+    int c = v < 0 ? 0 : (int)v / BOID_RADIUS;
+    return c < cells ? c : cells - 1;
+}
+
+// Gives back this thread's cell list once its bench or session is over
+void FreeHunterGrid(void)
+{
+    free(boid_grid.start);
+    free(boid_grid.boid);
+    free(boid_grid.cell);
+    memset(&boid_grid, 0, sizeof(boid_grid));
+}
+
+// The cell list of the active hunters among h[0 .. count - 1] on w's board (a counting sort).
+// NULL if it cannot grow that far, the list it had is kept.
+const HUNTER_GRID* BuildHunterGrid(HUNTER* h[] , int count , const WIN* w)
+{
+    HUNTER_GRID* g = &boid_grid;
+    int cols = w->cols / BOID_RADIUS + 1;
+    int rows = w->rows / BOID_RADIUS + 1;
+    int cells = cols * rows;
+    if (cells + 1 > g->cell_capacity) {
+        int* start = (int*)realloc(g->start, (cells + 1) * sizeof(int));
+        if (!start) return NULL;
+        g->start = start;
+        g->cell_capacity = cells + 1;
+    }
+    if (count > g->boid_capacity) {
+        BOID* boid = (BOID*)realloc(g->boid, count * sizeof(BOID));
+        if (!boid) return NULL;
+        g->boid = boid;
+        int* cell = (int*)realloc(g->cell, count * sizeof(int));
+        if (!cell) return NULL;
+        g->cell = cell;
+        g->boid_capacity = count;
+    }
+    g->cols = cols;
+    g->rows = rows;
+    memset(g->start, 0, (cells + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        g->cell[i] = -1;
+        if (!h[i]->active) continue;
+        g->cell[i] = BoidCell(h[i]->y, g->rows) * g->cols + BoidCell(h[i]->x, g->cols);
+        g->start[g->cell[i] + 1]++;
+    }
+    for (int c = 0; c < cells; c++) g->start[c + 1] += g->start[c];
+    g->count = g->start[cells];
+    // fill from the back of each cell, going backwards, so a cell keeps the hunters in slot order
+    for (int i = count - 1; i >= 0; i--) {
+        if (g->cell[i] < 0) continue;
+        BOID* b = &g->boid[--g->start[g->cell[i] + 1]];
+        b->x = h[i]->x;
+        b->y = h[i]->y;
+        b->dx = h[i]->dx;
+        b->dy = h[i]->dy;
+        b->id = h[i]->id;
+    }
+    // start[c + 1] went back to the beginning of cell c, put it back to its end
+    memmove(g->start, g->start + 1, cells * sizeof(int));
+    g->start[cells] = g->count;
+    return g;
+}
+
+ALWAYS_INLINE void BoidPull(BOID_SUM* s , const HUNTER* h , const BOID* o)
+{
+    if (o->id == h->id) return;
+    double ox = h->x - o->x, oy = h->y - o->y;
+    double d2 = ox * ox + oy * oy;
+    if (d2 >= BOID_RADIUS * BOID_RADIUS) return;
+    s->n++;
+    s->dir_x += o->dx;
+    s->dir_y += o->dy;
+    s->sum_x += o->x;
+    s->sum_y += o->y;
+    if (d2 >= BOID_SPACE * BOID_SPACE) return;
+    if (d2 == 0) {
+        s->sep_x += h->id < o->id ? -1 : 1;    // on the same spot, the lower slot goes left
+    } else {
+        s->sep_x += ox / d2;
+        s->sep_y += oy / d2;
+    }
+}
+
+// Turns h's heading by what its neighbours add up to, over frames frames. The speed stays.
+ALWAYS_INLINE void BoidSteer(HUNTER* h , const BOID_SUM* s , int frames)
+{
+    if (s->n == 0) return;
+    double sx = BOID_SEPARATION * s->sep_x
+              + BOID_ALIGNMENT * (s->dir_x / s->n - h->dx)
+              + BOID_COHESION * (s->sum_x / s->n - h->x) / BOID_RADIUS;
+    double sy = BOID_SEPARATION * s->sep_y
+              + BOID_ALIGNMENT * (s->dir_y / s->n - h->dy)
+              + BOID_COHESION * (s->sum_y / s->n - h->y) / BOID_RADIUS;
+    double turn = BOID_TURN * frames;
+    double dx = h->dx + sx * turn, dy = h->dy + sy * turn;
+    double length = sqrt(dx * dx + dy * dy);
+    if (length < 1e-9) return;
+    h->dx = dx / length;
+    h->dy = dy / length;
+    h->dirty = 1;
+}
+
+// A dashing hunter steers by the hunters in its own and the eight list cells around it
+ALWAYS_INLINE void FlockHunter(HUNTER* h , const HUNTER_GRID* g , int dt)
+{
+    if (h->wait_dash > 0) return;
+    BOID_SUM s = {0};
+    int cx = BoidCell(h->x, g->cols), cy = BoidCell(h->y, g->rows);
+    for (int y = cy > 0 ? cy - 1 : 0; y <= cy + 1 && y < g->rows; y++) {
+        int row = y * g->cols;
+        int x0 = cx > 0 ? cx - 1 : 0, x1 = cx + 1 < g->cols ? cx + 1 : cx;
+        for (int k = g->start[row + x0]; k < g->start[row + x1 + 1]; k++) BoidPull(&s, h, &g->boid[k]);
+    }
+    BoidSteer(h, &s, dt);
+}
+
+// The same with every other hunter looked at, for --boids to compare against
+void FlockHunterNaive(HUNTER* h , const BOID* boid , int count , int dt)
+{
+    if (h->wait_dash > 0) return;
+    BOID_SUM s = {0};
+    for (int k = 0; k < count; k++) BoidPull(&s, h, &boid[k]);
+    BoidSteer(h, &s, dt);
+}
+
+// One update of hunters or stars, split into ENTITY_CHUNK sized jobs
+typedef struct{
+    HUNTER** hunters;
+    STAR** stars;
+    int count;
+    FLOCK* flock;
+    TAXI* t;
+    GameConfig* config;
+    int dt;
+    FRAME_EFFECTS* effects;  // one per chunk
+    int* spawned;            // chunk c lists its respawns from spawned[c * ENTITY_CHUNK]
+    const HUNTER_GRID* boids;   // the hunters' cell list with HUNTER_FLOCKING, else NULL
+} ENTITY_BATCH;
+
+// grows with the biggest scene this thread has updated, so steady frames do not allocate
+static _Thread_local FRAME_EFFECTS* batch_effects = NULL;
+static _Thread_local int* batch_spawned = NULL;
+static _Thread_local int batch_capacity = 0;
+// one chunk for when the first of them cannot be allocated
+static _Thread_local FRAME_EFFECTS batch_spare_effects;
+static _Thread_local int batch_spare_spawned[ENTITY_CHUNK];
+
+// Sets u up for the first count entities of its array and returns the number of chunks.
+// If the buffers cannot grow that far it takes only as many entities as they hold (one
+// chunk at least), u->count says how many, and the caller runs the rest as another batch.
+int StartEntityBatch(ENTITY_BATCH* u, int count)
+{
+    int chunks = (count + ENTITY_CHUNK - 1) / ENTITY_CHUNK;
+    if (chunks * ENTITY_CHUNK > batch_capacity) {
+        FRAME_EFFECTS* effects = (FRAME_EFFECTS*)realloc(batch_effects, chunks * sizeof(FRAME_EFFECTS));
+        if (effects) batch_effects = effects;
+        int* spawned = effects ? (int*)realloc(batch_spawned, chunks * ENTITY_CHUNK * sizeof(int)) : NULL;
+        if (spawned) {
+            batch_spawned = spawned;
+            batch_capacity = chunks * ENTITY_CHUNK;
+        }
+    }
+    u->effects = batch_capacity ? batch_effects : &batch_spare_effects;
+    u->spawned = batch_capacity ? batch_spawned : batch_spare_spawned;
+    int room = batch_capacity ? batch_capacity : ENTITY_CHUNK;
+    if (count > room) {
+        count = room;
+        chunks = room / ENTITY_CHUNK;
+    }
+    u->count = count;
+    return chunks;
+}
+
+// Runs every chunk, on the job system when the scene is headless and big enough
+void RunEntityBatch(ENTITY_BATCH* u, int chunks, JOB_FN fn, WIN* w)
+{
+    if (entity_jobs && HEADLESS(w) && chunks > 1 && chunks <= entity_jobs->deques[0].capacity) {
+        JobsParallelFor(entity_jobs, chunks, fn, u);
+    } else {
+        for (int c = 0; c < chunks; c++) fn(u, c);
+    }
+}
+
+void ApplyEffects(FLOCK* flock , FRAME_EFFECTS* fx)
+{
+    for (int i = 0; i < flock->count; i++) {
+        BIRD* b = flock->bird[i];
+        if (fx->damage[i]) {
+            MetricAdd(M_BIRD_HITS, 1);
+            b->life -= fx->damage[i];
+            if(b->life <= 0) {
+                b->life = 0;
+                ClearBird(b);   // out of the game, the others fly on
+            }
+        }
+        b->score += fx->score[i];
+        if (fx->damage[i] || fx->score[i]) b->dirty = 1;
+        if (fx->score[i]) MetricAdd(M_STARS_COLLECTED, fx->score[i]);
+    }
+}
+
+// Sizes of 0 are read from every hunter (and the birds) instead, that is the generic kernel
+ALWAYS_INLINE void MoveHunterChunkWith(void* arg , int chunk , int cols , int rows , int hw , int hh)
+{
+    ENTITY_BATCH* u = (ENTITY_BATCH*)arg;
+    FRAME_EFFECTS* fx = &u->effects[chunk];
+    int* spawned = u->spawned + chunk * ENTITY_CHUNK;
+    int end = (chunk + 1) * ENTITY_CHUNK < u->count ? (chunk + 1) * ENTITY_CHUNK : u->count;
+    memset(fx, 0, sizeof(*fx));
+    // one roll covers all dt frames: chance of at least one 1-in-rate success (1 in rate for one frame)
+    int rate = u->config->hunter_spawn_rate;
+    long spawn_below = u->dt == 1 ? 1 : lround((1 - pow(1 - 1.0 / rate, u->dt)) * rate);
+    for(int i = chunk * ENTITY_CHUNK ; i < end ; i++){
+        HUNTER* h = u->hunters[i];
+        if(h->active){
+            if (u->boids) FlockHunter(h , u->boids , u->dt);
+            if (hw) MoveHunterWith(h , u->flock , u->t , u->dt , fx , cols , rows , hw , hh , 1 , BIRD_WIDTH);
+            else MoveHunter(h , u->flock , u->t , u->dt , fx);
+        }else {
+            if(GameRandAt(h->seed , u->flock->tick , h->id , RAND_HUNTER_SPAWN , 0) % rate < spawn_below){
+                spawned[fx->spawns++] = i;
+            }
+        }
+    }
+}
+
+void MoveHunterChunk(void* arg , int chunk)
+{
+    MoveHunterChunkWith(arg , chunk , 0 , 0 , 0 , 0);
+}
+
+void MoveMultipleHunter(HUNTER* h[] , FLOCK* flock , TAXI* t, WIN* w , GameConfig *config , int dt)
+{
+    ENTITY_BATCH u = { h, NULL, 0, flock, t, config, dt, NULL, NULL, NULL };
+    // without memory for the cell list the hunters keep their heading this frame
+    if (config->hunter_flocking) u.boids = BuildHunterGrid(h, config->hunter_num, w);
+    for (int done = 0; done < config->hunter_num; done += u.count) {
+        u.hunters = h + done;
+        int chunks = StartEntityBatch(&u, config->hunter_num - done);
+        RunEntityBatch(&u, chunks, config->kernel->move_hunters, w);
+        for(int c = 0 ; c < chunks ; c++){
+            ApplyEffects(flock , &u.effects[c]);
+            for(int k = 0 ; k < u.effects[c].spawns ; k++){
+                HUNTER* spawn = u.hunters[u.spawned[c * ENTITY_CHUNK + k]];
+                ClearHunter(spawn);
+                SpawnHunter(spawn , w , flock , config , flock->tick + dt);
+                MetricAdd(M_HUNTER_SPAWNS, 1);
+                TraceEvent(TRACE_HUNTER_SPAWNED, spawn->id, (int)spawn->x, (int)spawn->y, 0);
+            }
+        }
+    }
+}
+
+//____________STARS_______________//
+
+//
+//  star.c
+//  project_test
+//
+//  Created by Mateusz Ciesielczyk on 29/11/2025.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ncurses.h>
+
+// id is the star's slot, which keys its random draws. Stars are set up before the first tick.
+// Column a star enters at for the random x: one of the map's lanes when the level has them,
+// else any column inside the border. cols is the width of w.
+ALWAYS_INLINE int StarColumn(const WIN* w , unsigned int x , int cols)
+{
+    if (w->map && w->map->lanes) return w->map->lane[x % w->map->lanes];
+    return (int)(x % (cols - 2)) + 1;
+}
+
+void ResetStar(STAR* s , int id , WIN* w)
+{
+    s->win = w;
+    s->seed = GameKey();
+    s->id = id;
+    unsigned int x = GameRandAt(s->seed, 0, id, RAND_STAR_X, 0);
+    s->x = StarColumn(w , x , w->cols);
+    s->y = 1;
+    s->dx = 0;
+    s->dy = 1;
+    s->symbol = '*';
+    s->interval = (GameRandAt(s->seed, 0, id, RAND_STAR_INTERVAL, 0) % 4) + 2; //random intervaal 1 to 4 1-fast , 4 - slow
+    s->counter = s->interval; //starting counter at full interval
+    s->color = STAR_COLOR;
+    s->dirty = 1;
+}
+
+STAR* InitStar(int id , WIN* w)
+{
+    STAR* s = (STAR*)malloc(sizeof(STAR));
+    ResetStar(s , id , w);
+    return s;
+}
+
+// Sets up MAX_STARS stars in s[], which must already point to memory for them
+void ResetMultipleStar(STAR* s[] , WIN* w)
+{
+    for(int i = 0; i < MAX_STARS ; i++){
+        ResetStar(s[i] , i , w);
+    }
+}
+
+void DrawStar(STAR* s)
+{
+    if (HEADLESS(s->win)) return;
+    if (s->win->map && MapSolid(s->win->map, s->x, s->y)) return;   // behind a wall
+    wattron(s->win->window, COLOR_PAIR(s->color));
+    mvwprintw(s->win->window , s->y , s->x , "%c" , s->symbol);
+    wattron(s->win->window, COLOR_PAIR(s->win->color));
+
+}
+
+void DrawMultipleStar(STAR* s[])
+{
+    for(int i =0 ; i<MAX_STARS ; i++){
+        DrawStar(s[i]);
+    }
+}
+
+void ClearStar(STAR* s)
+{
+    if (HEADLESS(s->win)) return;
+    if (s->win->map && MapSolid(s->win->map, s->x, s->y)) return;
+    mvwprintw(s->win->window, s->y, s->x," "); //clear star for movement
+}
+
+// frame is the frame of the current GameTick, the bird is checked where it was at that frame,
+// and tick the same frame counted from the start of the game.
+// id is the bird's number in the flock. Returns 1 if the bird caught the star.
+ALWAYS_INLINE int IfTouchedBirdWith(STAR* s , BIRD* b , int id , int frame , uint32_t tick , FRAME_EFFECTS* fx , int cols , int bird_width)
+{
+     int bx = b->on_taxi ? b->x : b->path_x[frame];
+     int by = b->on_taxi ? b->y : b->path_y[frame];
+     if(s->y == by || s->y == by + 1){
+         if(s->x >= bx  && s->x < bx + bird_width){
+             TraceEvent(TRACE_STAR_COLLECTED, s->id, s->x, s->y, 0);
+             ClearStar(s);
+             s->y = 1;
+             s->x = StarColumn(s->win , GameRandAt(s->seed , tick , s->id , RAND_STAR_CAUGHT_X , 0) , cols);
+             s->interval = (GameRandAt(s->seed , tick , s->id , RAND_STAR_CAUGHT_INTERVAL , 0) % 4) + 1;
+             s->counter = s->interval;
+             s->dirty = 1;
+             fx->score[id]++;
+             return 1;
+         }
+     }
+     return 0;
+ }
+
+ int IfTouchedBird(STAR* s , BIRD* b , int id , int frame , uint32_t tick , FRAME_EFFECTS* fx)
+{
+     return IfTouchedBirdWith(s , b , id , frame , tick , fx , s->win->cols , b->width);
+}
+
+// The birds the grid has on the star's cell or the one above get to catch it, lowest number first
+ALWAYS_INLINE void IfTouchedBirdsWith(STAR* s , FLOCK* flock , int frame , FRAME_EFFECTS* fx , int cols , int bird_width)
+{
+    if (flock->count == 1) {
+        IfTouchedBirdWith(s , flock->bird[0] , 0 , frame , flock->tick + frame , fx , cols , bird_width);
+        return;
+    }
+    unsigned int near = FlockNear(flock , s->x , s->y - 1 , s->x , s->y);
+    while (near) {
+        int i = __builtin_ctz(near);
+        near &= near - 1;
+        if (IfTouchedBirdWith(s , flock->bird[i] , i , frame , flock->tick + frame , fx , cols , bird_width)) return;
+    }
+}
+
+// Stars are cheap, so a long tick still walks them frame by frame against the bird's path.
+// cols x rows is the star's window
+ALWAYS_INLINE void MoveStarWith(STAR* s , FLOCK* flock , int dt , FRAME_EFFECTS* fx , int cols , int rows , int bird_width)
+{
+    for (int f = 0; f < dt; f++) {
+        s->counter--;
+        if(s->counter <= 0){
+            s->counter = s->interval;
+            ClearStar(s);
+            s->y +=1;
+            if(s->y >= rows - 1){
+                s->x = StarColumn(s->win , GameRandAt(s->seed , flock->tick + f , s->id , RAND_STAR_FALLEN , 0) , cols);
+                s->y = 1;
+                s->counter = s->interval;
+                s->dirty = 1;
+            }
+        }
+        IfTouchedBirdsWith(s , flock , f , fx , cols , bird_width);
+    }
+    DrawStar(s);
+}
+
+void MoveStar(STAR* s , FLOCK* flock , int dt , FRAME_EFFECTS* fx)
+{
+    MoveStarWith(s , flock , dt , fx , s->win->cols , s->win->rows , flock->bird[0]->width);
+}
+
+// Sizes of 0 are read from every star, that is the generic kernel
+ALWAYS_INLINE void MoveStarChunkWith(void* arg , int chunk , int cols , int rows)
+{
+    ENTITY_BATCH* u = (ENTITY_BATCH*)arg;
+    FRAME_EFFECTS* fx = &u->effects[chunk];
+    int end = (chunk + 1) * ENTITY_CHUNK < u->count ? (chunk + 1) * ENTITY_CHUNK : u->count;
+    memset(fx, 0, sizeof(*fx));
+    for(int i = chunk * ENTITY_CHUNK ; i < end ; i++){
+        if (cols) MoveStarWith(u->stars[i] , u->flock , u->dt , fx , cols , rows , BIRD_WIDTH);
+        else MoveStar(u->stars[i] , u->flock , u->dt , fx);
+    }
+}
+
+void MoveStarChunk(void* arg , int chunk)
+{
+    MoveStarChunkWith(arg , chunk , 0 , 0);
+}
+
+void MoveMultipleStar(STAR* s[] , int count , FLOCK* flock , GameConfig *config , int dt){
+    ENTITY_BATCH u = { NULL, s, 0, flock, NULL, NULL, dt, NULL, NULL, NULL };
+    for (int done = 0; done < count; done += u.count) {
+        u.stars = s + done;
+        int chunks = StartEntityBatch(&u, count - done);
+        RunEntityBatch(&u, chunks, config->kernel->move_stars, s[0]->win);
+        for(int c = 0 ; c < chunks ; c++){
+            ApplyEffects(flock , &u.effects[c]);
+        }
+    }
+}
+
+//____________STAR RAIN_______________//
+
+// STAR_RAIN stars are not entities but bits. Every speed class (an interval of 2 to 5 frames
+// and the frame within it the stars move on) has one bitset per falling row, kept as a ring
+// of rows: a class falls by moving the ring's top one row up, and the row that dropped out
+// at the bottom comes back at the top turned by a random number of columns, which respawns
+// all its stars at once. Catching is an AND of the rows under the bird with its footprint.
+
+static const int RAIN_INTERVAL[RAIN_CLASSES] = { 2, 2, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 5 };
+static const int RAIN_PHASE[RAIN_CLASSES]    = { 0, 1, 0, 1, 2, 0, 1, 2, 3, 0, 1, 2, 3, 4 };
+
+// Bytes InitRain needs for a cols x rows window
+size_t RainSize(int cols , int rows)
+{
+    size_t row = (size_t)(cols - 2 + 63) / 64 * sizeof(uint64_t);
+    size_t touched = RAIN_CLASSES * (size_t)(rows - 2) * (sizeof(int32_t) + 1);
+    return sizeof(STAR_RAIN) + (RAIN_CLASSES + 1) * (size_t)(rows - 2) * row + touched + ARENA_ALIGN;
+}
+
+// Ring row of screen row y of class k, counted over all classes
+static inline int RainIndex(const STAR_RAIN* r , int k , int y)
+{
+    return k * r->rows + (r->top[k] + y - 1) % r->rows;
+}
+
+static inline uint64_t* RainRow(const STAR_RAIN* r , int k , int y)
+{
+    return r->plane + (size_t)RainIndex(r, k, y) * r->words;
+}
+
+// Screen row y of class k gained or lost stars, for the tick hashes
+static inline void RainTouch(STAR_RAIN* r , int k , int y)
+{
+    int i = RainIndex(r, k, y);
+    if (r->touched[i]) return;
+    r->touched[i] = 1;
+    r->changed[r->changes++] = i;
+}
+
+// Sets the first free bit at or after column x (0 based, wrapping) of row, 0 if the row is full
+static int RainPut(uint64_t* row , int width , int x)
+{
+    for (int n = 0; n < width; n++, x = x + 1 < width ? x + 1 : 0) {
+        if (!(row[x >> 6] >> (x & 63) & 1)) {
+            row[x >> 6] |= 1ull << (x & 63);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// ORs in into out moved by shift bits (negative moves toward bit 0), what falls off is lost
+static inline void RainShift(const uint64_t* in , uint64_t* out , int words , int shift)
+{
+    for (int i = 0; i < words; i++) {
+        if (!in[i]) continue;
+        int bit = i * 64 + shift;           // where bit 0 of word i lands
+        int bs = (bit % 64 + 64) % 64;
+        int wo = (bit - bs) / 64;
+        if (wo >= 0 && wo < words) out[wo] |= in[i] << bs;
+        if (bs && wo + 1 >= 0 && wo + 1 < words) out[wo + 1] |= in[i] >> (64 - bs);
+    }
+}
+
+// Turns the width bits of row by n columns to the right, wrapping around (0 < n < width)
+static void RainRotate(uint64_t* row , int words , int width , int n)
+{
+    uint64_t out[RAIN_MAX_WORDS] = {0};
+    RainShift(row, out, words, n);
+    RainShift(row, out, words, n - width);
+    if (width & 63) out[words - 1] &= (1ull << (width & 63)) - 1;
+    memcpy(row, out, words * sizeof(uint64_t));
+}
+
+// Scatters stars stars over mem (RainSize bytes) for w's window, or as many as fit
+STAR_RAIN* InitRain(void* mem , WIN* w , long stars , unsigned int seed)
+{
+    if (!mem || (w->cols - 2 + 63) / 64 > RAIN_MAX_WORDS) return NULL;
+    STAR_RAIN* r = (STAR_RAIN*)mem;
+    r->win = w;
+    r->rows = w->rows - 2;
+    r->width = w->cols - 2;
+    r->words = (r->width + 63) / 64;
+    r->seed = seed;
+    r->frame = 0;
+    unsigned char* p = (unsigned char*)(r + 1);
+    r->plane = (uint64_t*)(((uintptr_t)p + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+    r->shown = r->plane + (size_t)RAIN_CLASSES * r->rows * r->words;
+    r->changed = (int32_t*)(r->shown + (size_t)r->rows * r->words);
+    r->touched = (uint8_t*)(r->changed + (size_t)RAIN_CLASSES * r->rows);
+    r->changes = 0;
+    memset(r->plane, 0, (RAIN_CLASSES + 1) * (size_t)r->rows * r->words * sizeof(uint64_t));
+    memset(r->touched, 0, (size_t)RAIN_CLASSES * r->rows);
+    for (int k = 0; k < RAIN_CLASSES; k++) r->top[k] = 0;
+    long room = (long)RAIN_CLASSES * r->rows * r->width;
+    r->stars = stars < room ? stars : room;
+    // the draws of four stars at a time
+    RAND_LANES word[4];
+    for (long i = 0; i < r->stars; i++) {
+        if (i % 4 == 0) PhiloxLanes(seed, 0, (uint32_t)i, RAND_RAIN_STAR, 0, word);
+        int k = word[0][i % 4] % RAIN_CLASSES;
+        int y = word[1][i % 4] % r->rows + 1;
+        int x = word[2][i % 4] % r->width;
+        // a full row passes the star on to the next row, and to the next class after the last
+        for (int n = 0; !RainPut(RainRow(r, k, y), r->width, x); n++) {
+            y = y < r->rows ? y + 1 : 1;
+            if (n % r->rows == r->rows - 1) k = (k + 1) % RAIN_CLASSES;
+        }
+    }
+    return r;
+}
+
+// Takes the stars under a bird of width bird_width at (x, y) off the rain, as a star is
+// caught on the bird's row and the one below. Returns how many.
+static int RainCatch(STAR_RAIN* r , int x , int y , int bird_width)
+{
+    int caught = 0;
+    int x0 = x - 1, x1 = x - 1 + bird_width - 1;     // bits of the bird's columns
+    if (x0 < 0) x0 = 0;
+    if (x1 >= r->width) x1 = r->width - 1;
+    if (x0 > x1) return 0;
+    for (int row = y; row <= y + 1; row++) {
+        if (row < 1 || row > r->rows) continue;
+        for (int wi = x0 >> 6; wi <= x1 >> 6; wi++) {
+            int lo = wi == x0 >> 6 ? x0 & 63 : 0, hi = wi == x1 >> 6 ? x1 & 63 : 63;
+            uint64_t mask = (hi == 63 ? ~0ull : (1ull << (hi + 1)) - 1) & ~((1ull << lo) - 1);
+            for (int k = 0; k < RAIN_CLASSES; k++) {
+                uint64_t* bits = RainRow(r, k, row) + wi;
+                uint64_t hit = *bits & mask;
+                if (!hit) continue;
+                *bits &= ~hit;
+                RainTouch(r, k, row);
+                caught += __builtin_popcountll(hit);
+            }
+        }
+    }
+    return caught;
+}
+
+// Back at the top row of a random class, anywhere there is room
+static void RainRespawn(STAR_RAIN* r , int count)
+{
+    for (int i = 0; i < count; i++) {
+        RAND4 d = Philox(r->seed, (uint32_t)r->frame, i, RAND_RAIN_RESPAWN, 0);
+        int k = d.word[0] % RAIN_CLASSES;
+        int x = d.word[1] % r->width;
+        int n = 0;
+        while (n < RAIN_CLASSES && !RainPut(RainRow(r, k, 1), r->width, x)) {
+            k = (k + 1) % RAIN_CLASSES;
+            n++;
+        }
+        if (n == RAIN_CLASSES) r->stars--;     // the whole top row is taken
+        else RainTouch(r, k, 1);
+    }
+}
+
+// Draws what changed since the last call: stars only go on empty cells and only stars are
+// erased, so the rain never paints over the actors (who may hide a star for a moment).
+void DrawRain(STAR_RAIN* r)
+{
+    if (HEADLESS(r->win)) return;
+    WINDOW* win = r->win->window;
+    wattron(win, COLOR_PAIR(STAR_COLOR));
+    for (int y = 1; y <= r->rows; y++) {
+        uint64_t* shown = r->shown + (size_t)(y - 1) * r->words;
+        for (int wi = 0; wi < r->words; wi++) {
+            uint64_t now = 0;
+            for (int k = 0; k < RAIN_CLASSES; k++) now |= RainRow(r, k, y)[wi];
+            for (uint64_t diff = now ^ shown[wi]; diff; diff &= diff - 1) {
+                int j = __builtin_ctzll(diff);
+                int x = 1 + wi * 64 + j;
+                if (r->win->map && MapSolid(r->win->map, x, y)) continue;
+                chtype c = mvwinch(win, y, x) & A_CHARTEXT;
+                if (now >> j & 1) {
+                    if (c == ' ') mvwaddch(win, y, x, '*');
+                } else if (c == '*') {
+                    mvwaddch(win, y, x, ' ');
+                }
+            }
+            shown[wi] = now;
+        }
+    }
+    wattron(win, COLOR_PAIR(r->win->color));
+}
+
+// dt frames of rain: the classes due fall, then every bird catches what is under it where it
+// was at that frame. The catches go straight to the birds' scores.
+void RainTick(STAR_RAIN* r , FLOCK* flock , int dt)
+{
+    for (int f = 0; f < dt; f++) {
+        r->frame++;
+        for (int k = 0; k < RAIN_CLASSES; k++) {
+            if ((r->frame + RAIN_PHASE[k]) % RAIN_INTERVAL[k]) continue;
+            r->top[k] = (r->top[k] + r->rows - 1) % r->rows;
+            uint64_t* row = RainRow(r, k, 1);
+            int any = 0;
+            for (int wi = 0; wi < r->words; wi++) any |= row[wi] != 0;
+            if (any && r->width > 1) {
+                RainRotate(row, r->words, r->width, GameRandAt(r->seed, (uint32_t)r->frame, k, RAND_RAIN_TURN, 0) % (r->width - 1) + 1);
+                RainTouch(r, k, 1);
+            }
+        }
+        int caught = 0;
+        for (int i = 0; i < flock->count; i++) {
+            BIRD* b = flock->bird[i];
+            if (!BirdAlive(b)) continue;
+            int n = RainCatch(r, b->on_taxi ? b->x : b->path_x[f], b->on_taxi ? b->y : b->path_y[f], b->width);
+            if (n) {
+                TraceEvent(TRACE_STAR_COLLECTED, -1, b->x, b->y, n);
+                MetricAdd(M_STARS_COLLECTED, n);
+                b->dirty = 1;
+            }
+            b->score += n;
+            caught += n;
+        }
+        RainRespawn(r, caught);
+    }
+    DrawRain(r);
+}
+
+//____________TAXI_____________//
+
+//
+//  taxi.c
+//  project_test
+//
+//  Created by Mateusz Ciesielczyk on 03/12/2025.
+//
+
+void ResetTaxi(TAXI* t , WIN* w , GameConfig* config)
+{
+    t->win = w;
+    t->y = config->screen_height - SAFE_ZONEH - 1;
+    t->x = 2;
+    t->dx = 1;
+    t->dy = 0;
+    t->symbol = "o\\__/o" ;
+    t->width = strlen(t->symbol);
+    t->speed = 1;
+    t->color = TAXI_COLOR;
+    t->counter_of_taxis = 0;
+    t->active = 0;
+    t->state = 0;
+    t->last_x = t->x;
+    t->rider = NULL;
+    t->bonus = config->taxi_bonus;
+    for(int i=0; i<BONUS_STARS; i++) t->bonusx[i] = t->bonusa[i] = 0;
+    t->dirty = 1;
+}
+
+TAXI* InitTaxi(WIN* w , GameConfig* config)
+{
+    TAXI* t = (TAXI*)malloc(sizeof(TAXI));
+    ResetTaxi(t , w , config);
+    return t;
+}
+
+void InitBonus(TAXI* t)
+{
+    for(int i = 0 ; i < t->bonus ; i++){
+        t->bonusx[i] = t->x + 20 + (i*10);
+        t->bonusa[i] = 1;
+    }
+}
+
+void CheckTaxiBonus(TAXI* t , BIRD* b)
+{
+    for(int i = 0 ; i< BONUS_STARS ; i++){
+        if (t->bonusa[i] == 1) {
+            if(t->x + SAFE_ZONEW >= t->bonusx[i]){
+                b->score++;
+                MetricAdd(M_STARS_COLLECTED, 1);
+                t->bonusa[i] = 0;
+            }
+        }
+    }
+}
+
+void DrawBonus(TAXI* t)
+{
+    if (HEADLESS(t->win)) return;
+    wattron(t->win->window, COLOR_PAIR(INJURED_BIRD));
+    for(int i = 0 ; i < BONUS_STARS ; i++)
+    {
+        if(t->bonusa[i] == 1){
+            mvwprintw(t->win->window, t->y + SAFE_ZONEH/2 , t->bonusx[i], "*");
+        }
+    }
+    wattroff(t->win->window, COLOR_PAIR(INJURED_BIRD));
+}
+
+void DrawTaxiSafeZone(TAXI* t)
+{
+    if (HEADLESS(t->win)) return;
+    // Only draw if the shield is active
+    if (!t->active || !t->state) return;
+   wattron(t->win->window, COLOR_PAIR(BIRD_COLOR)); // Use a specific color (e.g., Green or Cyan)
+
+        // Draw Top and Bottom borders
+    for (int i = 0; i < SAFE_ZONEW ; i++) {
+        // Top Edge
+        mvwprintw(t->win->window, t->y, t->x + i, "-");
+        // Bottom Edge
+        mvwprintw(t->win->window, t->y + SAFE_ZONEH - 1, t->x + i, "-");
+    }
+
+        // Draw Left and Right borders
+    for (int i = 0; i < SAFE_ZONEH ; i++) {
+        // Left Edge
+        mvwprintw(t->win->window, t->y + i, t->x, "|");
+        // Right Edge
+        mvwprintw(t->win->window, t->y + i, t->x + SAFE_ZONEW - 1, "|");
+    }
+    wattroff(t->win->window, COLOR_PAIR(BIRD_COLOR));
+}
+
+void DrawTaxi(TAXI* t)
+{
+    if (HEADLESS(t->win)) return;
+    int taxi_width = t->width;
+    wattron(t->win->window, COLOR_PAIR(t->color));
+    wattron(t->win->window, A_BOLD);
+    mvwprintw(t->win->window , t->y + SAFE_ZONEH - 2, t->x + SAFE_ZONEW/2 - taxi_width/2, "%s" , t->symbol);
+    wattroff(t->win->window, A_BOLD);
+    wattroff(t->win->window, COLOR_PAIR(t->win->color));
+}
+
+void ClearTaxi(TAXI* t)
+{
+    if (HEADLESS(t->win)) return;
+    for(int i = 0; i < SAFE_ZONEH; i++) {
+            for(int j = 0; j < SAFE_ZONEW; j++) {
+                 mvwprintw(t->win->window, t->y + i, t->x + j, " ");
+            }
+        }
+}
+
+// Returns 1 if b got on the taxi
+int SafeBirdTaxi(TAXI* t , BIRD* b)
+{
+    int bird_width = b->width;
+    // swept box of the bird's last move, so a long frame cannot carry it over the zone
+    int left = b->x < b->last_x ? b->x : b->last_x;
+    int right = b->x > b->last_x ? b->x : b->last_x;
+    int top = b->y < b->last_y ? b->y : b->last_y;
+    int bottom = b->y > b->last_y ? b->y : b->last_y;
+    if (right + bird_width >= t->x && left <= t->x + SAFE_ZONEW) {
+        if(bottom >= t->y && top <= t->y + SAFE_ZONEH) {
+            t->state = 1;    // Switch Taxi to MOVING mode
+            b->on_taxi = 1;  // Tell Bird it is riding
+            t->rider = b;
+            t->dirty = b->dirty = 1;
+            InitBonus(t);
+            TraceEvent(TRACE_TAXI_BOARDED, -1, b->x, b->y, 0);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Any living bird can board the waiting taxi, the lowest number first
+void MoveTaxi(TAXI* t, FLOCK* flock , int dt)
+{
+    if (!t->active) return;
+    ClearTaxi(t);
+    t->last_x = t->x;
+    
+    if(t->state == 0) //waiting mode
+    {
+        int x = t->x, y = t->y;
+        t->x = 2;
+        t->y = t->win->rows - SAFE_ZONEH - 1;
+        if (t->x != x || t->y != y) t->dirty = 1;
+        DrawTaxi(t);
+        for (int i = 0; i < flock->count; i++) {
+            if (BirdAlive(flock->bird[i]) && SafeBirdTaxi(t , flock->bird[i])) break;
+        }
+    }
+    else if(t->state == 1){
+        BIRD* b = t->rider;
+        t->x += (t->dx * t->speed * dt);
+        t->dirty = b->dirty = 1;
+        ClearBird(b);
+        b->life += dt;  // +1 HP every frame (gradual healing)
+        if (b->life > 100) b->life = 100;
+        CheckTaxiBonus(t , b);
+        int bird_width = b->width;
+        b->x = t->x + (SAFE_ZONEW / 2) - (bird_width / 2); // attaching the bird to sit on the taxi
+        b->y = t->y + SAFE_ZONEH - 3;
+        if(t->x >= t->win->cols - SAFE_ZONEW - 1){
+            int collected = 0;
+            for(int i = 0 ; i < t->bonus ; i++) collected += t->bonusa[i] == 0;
+            TraceEvent(TRACE_TAXI_FINISHED, -1, collected, 0, 0);
+            t->active = 0;
+            t->state = 0;
+            b->on_taxi = 0;
+            t->rider = NULL;
+            ClearTaxi(t);
+            return;
+        }
+        DrawTaxiSafeZone(t);
+        DrawTaxi(t);
+        DrawBonus(t);
+    }
+}
+
+
+//____________SPECIALISED KERNELS_____________//
+
+// The update loops with the board and hunter shape as constants, for the common configs.
+// Each X(cols, rows, hunter width, hunter height) below becomes one kernel; the sizes fold
+// into the bounds checks and the shape loops, and the hollow mask tests drop out.
+#define GAME_KERNEL_SIZES(X) \
+    X(180, 50, 1, 3)   /* config.txt */ \
+    X(100, 35, 1, 3)   /* DefaultValues */
+
+#define DEFINE_GAME_KERNEL(C, R, W, H) \
+    static void MoveBird_##C##x##R##_##W##x##H(BIRD* b , int dt) { MoveBirdWith(b , dt , C , R , BIRD_WIDTH); } \
+    static void MoveStarChunk_##C##x##R##_##W##x##H(void* arg , int chunk) { MoveStarChunkWith(arg , chunk , C , R); } \
+    static void MoveHunterChunk_##C##x##R##_##W##x##H(void* arg , int chunk) { MoveHunterChunkWith(arg , chunk , C , R , W , H); }
+#define GAME_KERNEL_ENTRY(C, R, W, H) \
+    { C, R, W, H, MoveBird_##C##x##R##_##W##x##H, MoveStarChunk_##C##x##R##_##W##x##H, MoveHunterChunk_##C##x##R##_##W##x##H, #C "x" #R " " #W "x" #H },
+
+GAME_KERNEL_SIZES(DEFINE_GAME_KERNEL)
+
+static const GAME_KERNEL GAME_KERNELS[] = {
+    { 0, 0, 0, 0, MoveBird, MoveStarChunk, MoveHunterChunk, "generic" },
+    GAME_KERNEL_SIZES(GAME_KERNEL_ENTRY)
+};
+#define NUM_GAME_KERNELS ((int)(sizeof(GAME_KERNELS) / sizeof(GAME_KERNELS[0])))
+
+// The specialised kernel for config if there is one, otherwise the generic one
+const GAME_KERNEL* SelectKernel(const GameConfig* config)
+{
+    for (int i = 1; i < NUM_GAME_KERNELS; i++) {
+        const GAME_KERNEL* k = &GAME_KERNELS[i];
+        if (k->cols == config->screen_width && k->rows == config->screen_height && config->hunter_solid
+            && k->hunter_width == config->hunter_width && k->hunter_height == config->hunter_height) {
+            return k;
+        }
+    }
+    return &GAME_KERNELS[0];
+}
+
+//__________RANKING SYSTEM_____________//
+
+
+//
+//  ranking.c
+//  project_test
+//
+//  Created by Mateusz Ciesielczyk on 05/12/2025.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ncurses.h>
+
+//helper function for sorting the rankings
+int CompareScores(const void* x, const void* y){
+    RANKING* scorex = (RANKING*)x;
+    RANKING* scorey = (RANKING*)y;
+    return scorey->total_score - scorex->total_score;
+}
+
+int CalculateScore(BIRD* b , GameConfig* config)
+{
+    return (int)(config->time_limit * 50) + b->score * 100 + b->life * 5 + config->curr_level * 500 ;
+}
+
+int FindPlayerIndex(RANKING scores[], int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(scores[i].name, name) == 0) {
+            return i; // Player found at this index
+        }
+    }
+    return -1; // Player not found
+}
+
+void SetPlayerStats(RANKING* r, BIRD* b, GameConfig* cfg, double t_used, int score) {
+    r->stars_collected = b->score;
+    r->star_quota = cfg->star_quota;
+    r->time_used = t_used;
+    r->total_score = score;
+}
+
+void UpdateRanking(BIRD* b, GameConfig* config, double time_used, int total_score)
+{
+    RANKING scores[NUM_PLAYERS + 1];
+    int count = 0;
+    FILE* file = fopen(RANKING_FILE, "r");
+    if(file){
+        while(count < NUM_PLAYERS && fscanf(file, "%s %d %d %lf %d",scores[count].name,&scores[count].stars_collected,&scores[count].star_quota,&scores[count].time_used,&scores[count].total_score) == 5){
+            count++;
+        }
+        fclose(file);
+    }
+    int found_index = FindPlayerIndex(scores, count, config->player_name);
+    if(found_index != -1) {
+        // Player found! Only update if the NEW score is better.
+        if(total_score > scores[found_index].total_score) {
+            SetPlayerStats(&scores[found_index], b, config, time_used, total_score);
+        }
+    }
+    else{
+        strcpy(scores[count].name, config->player_name);
+        SetPlayerStats(&scores[count], b, config, time_used, total_score);
+        count++;
+    }
+    
+    qsort(scores, count, sizeof(RANKING), CompareScores);
+    file = fopen(RANKING_FILE, "w");
+        if (!file) return;
+    int limit;
+    if (count < NUM_PLAYERS) {
+        limit = count;
+    } else {
+        limit = NUM_PLAYERS;
+    }
+    for (int i = 0; i < limit; i++) {
+        fprintf(file, "%s %d %d %.2f %d\n",
+                scores[i].name,
+                scores[i].stars_collected,
+                scores[i].star_quota,
+                scores[i].time_used,
+                scores[i].total_score);
+    }
+    fclose(file);
+    
+}
+
+void ShowRanking(WINDOW* ranking, int rows, int cols)
+{
+    int h = 16, w = 60;
+    int y = (rows - h) / 2;
+    int x = (cols - w) / 2;
+    WINDOW* win = newwin(h, w, y, x);
+    box(win, 0, 0);
+    wbkgd(win, COLOR_PAIR(1));
+    wattron(win, A_BOLD | A_UNDERLINE);
+    mvwprintw(win, 1, 20, "BEST OF THE BEST");
+    wattroff(win, A_BOLD | A_UNDERLINE);
+    wattron(win, A_REVERSE);
+    mvwprintw(win, 3, 2, "RK  NAME         STARS   TIME(s)  SCORE  ");
+    wattroff(win, A_REVERSE);
+    FILE* file = fopen(RANKING_FILE, "r");
+    char name[50];
+    int s, q, score;
+    double t;
+    int line = 4;
+    if (file) {
+           int rank = 1;
+           while (fscanf(file, "%s %d %d %lf %d", name, &s, &q, &t, &score) == 5 && rank <= NUM_PLAYERS) {
+               mvwprintw(win, line, 2, "#%-2d %-12s %2d/%-2d   %6.1f   %6d",
+                         rank, name, s, q, t, score);
+               line++;
+               rank++;
+           }
+           fclose(file);
+       }else {
+           mvwprintw(win, 6, 20, "No Records Yet!");
+       }
+    mvwprintw(win, h-2, 18, "Press Any Key");
+    wrefresh(win);
+    nodelay(win, FALSE);
+    wgetch(win);
+    delwin(win);
+    
+}
+
+
+
+
+
+
+//--------------------------------------//
+//          CONFIGURATION INPUT
+//--------------------------------------//
+
+
+//Loads configuration of a text file
+//will return 1 if succesfull and 0 if failed
+
+int LoadConfig(const char* filename, GameConfig* config);
+void DefaultValues(GameConfig* config);
+
+void AssignValue(GameConfig* config, const char* key, int value)
+{
+    if (strcmp(key, "SCREEN_WIDTH") == 0) config->screen_width = value;
+    else if (strcmp(key, "SCREEN_HEIGHT") == 0) config->screen_height = value;
+    else if (strcmp(key, "STAR_QUOTA") == 0) config->star_quota = value;
+    else if (strcmp(key, "TIME_LIMIT") == 0) config->time_limit = value;
+    else if (strcmp(key, "SWALLOW_SPEED_MIN") == 0) config->swallow_speed_min = value;
+    else if (strcmp(key, "SWALLOW_SPEED_MAX") == 0) config->swallow_speed_max = value;
+    else if (strcmp(key, "HUNTER_SPAWN_RATE") == 0) config->hunter_spawn_rate = value;
+    else if (strcmp(key, "SEED") == 0) config->seed = value;
+    else if (strcmp(key, "DAMAGE_PENALTY") == 0) config->damage_penalty = value;
+    else if (strcmp(key, "HUNTER_SPEED") == 0) config->hunter_speed = value;
+    else if (strcmp(key, "LEVEL") == 0) config->curr_level = value;
+    else if (strcmp(key, "HUNTER_BOUNCES") == 0) config->hunter_bounces = value;
+    else if (strcmp(key, "HUNTER_NUM") == 0) config->hunter_num = value;
+    else if (strcmp(key, "AVAILABLE_TAXIS") == 0) config->available_taxis = value;
+    else if (strcmp(key, "RECORD") == 0) config->record = value;
+    else if (strcmp(key, "SHARED_STATE") == 0) config->shared_state = value;
+    else if (strcmp(key, "BIRDS") == 0) config->birds = value;
+    else if (strcmp(key, "PLAYERS") == 0) config->players = value;
+    else if (strcmp(key, "PLANNER") == 0) config->planner = value;
+    else if (strcmp(key, "PLANNER_THREADS") == 0) config->planner_threads = value;
+    else if (strcmp(key, "STAR_RAIN") == 0) config->star_rain = value;
+    else if (strcmp(key, "TAXI_BONUS") == 0) config->taxi_bonus = value;
+    else if (strcmp(key, "HUNTER_FLOCKING") == 0) config->hunter_flocking = value;
+    else if (strcmp(key, "HEATMAP") == 0) config->heatmap = value;
+    else if (strcmp(key, "METRICS") == 0) config->metrics = value;
+    else if (strcmp(key, "AUTOSAVE") == 0) config->autosave = value;
+}
+
+int LoadConfig(const char* filename, GameConfig* config) {
+    FILE* file = fopen(filename, "r");
+    
+    // Safety check: Make sure the file actually exists
+    if (!file) {
+        fprintf(stderr, "Error: Could not open config file %s\n", filename);
+        return 0; // Return 0 to indicate failure
+    }
+    DefaultValues(config);
+    char key[MAX_COMMAND_SIZE];
+    char mask[MAX_SHAPE_TEXT];
+    int has_mask = 0;
+    while (fscanf(file, "%s", key) == 1) {
+        if (strcmp(key, "PLAYER_NAME") == 0) {
+            fscanf(file, "%s", config->player_name);}
+        else if (strcmp(key, "MAP") == 0) {
+            fscanf(file, "%255s", config->map_file);
+        }
+        else if (strcmp(key, "PACK") == 0) {
+            fscanf(file, "%255s", config->pack_file);
+        }
+        else if (strcmp(key, "HUNTER_SPEED") == 0) {
+            fscanf(file, "%lf", &config->hunter_speed);
+                    }
+        else if (strcmp(key, "TIME_LIMIT") == 0) {
+            fscanf(file, "%lf", &config->time_limit);
+                    }
+        else if (strcmp(key , "HUNTER_SHAPE") == 0){
+            fscanf(file, "%dx%d" , &config->hunter_width , &config->hunter_height);
+        }
+        else if (strcmp(key , "HUNTER_MASK") == 0){
+            fscanf(file, "%1099s" , mask);
+            has_mask = 1;
+        }
+        else{
+            int value;
+            fscanf(file , "%d" , &value);
+            AssignValue(config , key , value);
+
+        }
+        }
+    fclose(file);
+    if (config->hunter_width < 1) config->hunter_width = 1;
+    if (config->hunter_width > 64) config->hunter_width = 64;
+    if (config->hunter_height < 1) config->hunter_height = 1;
+    if (config->hunter_height > MAX_SHAPE_ROWS) config->hunter_height = MAX_SHAPE_ROWS;
+    SolidMask(config->hunter_mask, config->hunter_width, config->hunter_height);
+    if (has_mask && !ParseMask(mask, config->hunter_mask, &config->hunter_width, &config->hunter_height)) {
+        fprintf(stderr, "Error: HUNTER_MASK %s is not a valid shape, using HUNTER_SHAPE\n", mask);
+        SolidMask(config->hunter_mask, config->hunter_width, config->hunter_height);
+    }
+    config->hunter_solid = MaskIsSolid(config->hunter_mask, config->hunter_width, config->hunter_height);
+    config->kernel = SelectKernel(config);
+    if (config->birds < 1) config->birds = 1;
+    if (config->birds > MAX_BIRDS) config->birds = MAX_BIRDS;
+    if (config->players < 0) config->players = 0;
+    if (config->players > MAX_PLAYERS) config->players = MAX_PLAYERS;
+    if (config->planner < 0) config->planner = 0;
+    if (config->star_rain < 0) config->star_rain = 0;
+    if (config->autosave < 0) config->autosave = 0;
+    if (config->taxi_bonus < 0) config->taxi_bonus = 0;
+    if (config->taxi_bonus > BONUS_STARS) config->taxi_bonus = BONUS_STARS;
+    if (config->planner_threads <= 0) config->planner_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (config->map_file[0]) {
+        config->map = LoadMap(config->map_file, config->screen_width, config->screen_height);
+        if (!config->map) fprintf(stderr, "Error: Could not read map %s, playing without walls\n", config->map_file);
+    }
+    if (config->pack_file[0]) {
+        config->pack = OpenPack(config->pack_file, config->screen_width, config->screen_height);
+        if (!config->pack) fprintf(stderr, "Error: playing config.txt's settings without the level pack\n");
+    }
+    return 1;
+    
+}
+
+void DefaultValues(GameConfig* config)
+{
+    //default values if the fil doesnt work or is incomplete
+    config->screen_width = 100;
+    config->screen_height = 35;
+    config->star_quota = 10;
+    config->time_limit = 60;
+    config->swallow_speed_min = 1;
+    config->swallow_speed_max = 5;
+    config->hunter_spawn_rate = 100;
+    config->seed = 1234;
+    config->damage_penalty = 1;
+    config->hunter_speed = 1;
+    strcpy(config->player_name , "PLAYER1");
+    config->hunter_bounces = 3;
+    config->curr_level = 1;
+    config->hunter_width = 1;
+    config->hunter_height = 3;
+    config->hunter_num = 2;
+    config->available_taxis = 1;
+    config->record = 0;
+    config->shared_state = 0;
+    config->birds = 1;
+    config->players = 1;
+    config->map_file[0] = '\0';
+    config->map = NULL;
+    config->planner = 0;
+    config->planner_threads = 0;
+    config->star_rain = 0;
+    config->pack_file[0] = '\0';
+    config->pack = NULL;
+    config->pack_level = 0;
+    config->taxi_bonus = BONUS_STARS;
+    config->hunter_flocking = 0;
+    config->heatmap = 0;
+    config->metrics = 0;
+    config->autosave = 0;
+    SolidMask(config->hunter_mask, config->hunter_width, config->hunter_height);
+    config->hunter_solid = 1;
+    config->kernel = SelectKernel(config);
+}
+
+//-----------------------------------//
+//  SCREEN SETTINGS AND I/O          //
+//-----------------------------------//
+
+
+WINDOW* Start();
+void CleanWin(WIN* W, int bo);
+WIN* InitWin(WINDOW* parent, int rows, int cols, int y, int x, int color, int bo, int delay);
+void ShowStatus(WIN* W, FLOCK* flock , GameConfig *config );
+int EndGameWin(WIN* W);
+int EndGameLose(WIN* W);
+int EndGameQuit(WIN* W);
+
+
+WINDOW* Start(){
+    WINDOW* win;
+
+    // Initialize ncurses - sets up terminal for text UI
+    if ( (win = initscr()) == NULL ) {
+        fprintf(stderr, "Error initialising ncurses.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Initialize color system
+    start_color();
+
+    // Define color pairs: init_pair(ID, FOREGROUND, BACKGROUND)
+    init_pair(MAIN_COLOR, COLOR_WHITE, COLOR_BLACK);
+    init_pair(PLAY_COLOR, COLOR_CYAN, COLOR_BLACK);
+    init_pair(STAT_COLOR, COLOR_YELLOW, COLOR_BLUE);
+    //ACTORS
+    init_pair(BIRD_COLOR, COLOR_GREEN, COLOR_BLACK);
+    init_pair(STAR_COLOR, COLOR_MAGENTA , COLOR_BLACK);
+    init_pair(HUNTER_COLOR , COLOR_RED , COLOR_BLACK);
+    init_pair(INJURED_BIRD, COLOR_YELLOW, COLOR_BLACK);
+    init_pair(TAXI_COLOR , COLOR_CYAN , COLOR_BLACK);
+    // Don't echo typed characters to screen
+    noecho();
+    
+    // Make cursor invisible (curs_set: 0=invisible, 1=normal, 2=very visible)
+    curs_set(0);
+
+    return win;
+}
+
+void CleanWin(WIN* W, int bo)
+{
+    int i, j;
+
+    // Set window color
+    wattron(W->window, COLOR_PAIR(W->color));
+
+    // Draw border if requested
+    if (bo) box(W->window, 0, 0);
+
+    // Fill window with spaces (clearing it)
+    for (i = bo; i < W->rows - bo; i++)
+        for (j = bo; j < W->cols - bo; j++)
+            mvwprintw(W->window, i, j, " ");
+
+    // Refresh to show changes
+    wrefresh(W->window);
+}
+
+WIN* InitWin(WINDOW* parent, int rows, int cols, int y, int x, int color, int bo, int delay)
+{
+    // Allocate memory for WIN structure
+    WIN* W = (WIN*)malloc(sizeof(WIN));
 
     // Store window properties
     W->x = x;
@@ -1087,273 +5224,4126 @@ WIN* InitWin(WINDOW* parent, int rows, int cols, int y, int x, int color, int bo
     W->rows = rows;
     W->cols = cols;
     W->color = color;
+    W->map = NULL;
+
+    // Create ncurses subwindow
+    W->window = subwin(parent, rows, cols, y, x);
+
+    // Clear the window
+    CleanWin(W, bo);
+
+    // Set input mode: delay==0 means non-blocking (for real-time games)
+    if (delay == 0) nodelay(W->window, TRUE);
+    keypad(W->window, TRUE);    // arrow keys, see PLAYER_KEYS
+
+    // Display the window
+    wrefresh(W->window);
+
+    return W;
+}
+
+void ShowStatus(WIN* W, FLOCK* flock , GameConfig* config)
+{
+    BIRD* b = flock->bird[0];
+    int score = 0;  // the birds collect for the quota together
+    for (int i = 0; i < flock->count; i++) score += flock->bird[i]->score;
+    // Set status bar color
+    
+    wattron(W->window, COLOR_PAIR(BIRD_COLOR) | A_BOLD | A_REVERSE);
+    mvwprintw(W->window, 1, 2, "   SCORE: %d/%d     Time Left : %.1f  Life = %d   ", score , config->star_quota , config->time_limit ,  b->life);
+    wattroff(W->window, COLOR_PAIR(BIRD_COLOR) | A_BOLD | A_REVERSE);
+    
+    wattron(W->window, COLOR_PAIR(W->color));
+
+    // Draw border around status bar
+    box(W->window, 0, 0);
+    const char* controls = "[W]Up [S]Dn [A]Lft [D]Rgt [Q]Quit";
+    int pos_x = W->cols - strlen(controls) - 2; // -2 for right margin
+    mvwprintw(W->window, 1, pos_x, "%s", controls);
+    
+    // Display controls
+    
+    mvwprintw(W->window, 2, pos_x, "Position: x=%d y=%d " ,b->x, b->y  );
+    mvwprintw(W->window, 3, pos_x - 30, "Press t to activate shield taxi and bonus points");
+    mvwprintw(W->window, 2, 2, "PLAYER: %s   LEVEL: %d  TAXIS AVAILABLE: %d", config->player_name, config->curr_level , config->available_taxis);
+    if (config->pack_level) wprintw(W->window, "  PACK LEVEL: %d ", config->pack_level);
+    
+    mvwprintw(W->window , 3 , 2 , "SPEED = %d" , b->speed );
+    // life and stars of the other birds, as many as fit before the taxi hint
+    for (int i = 1, x = 16; i < flock->count && x + 12 < pos_x - 30; i++, x += 12) {
+        mvwprintw(W->window, 3, x, "%d:%3d %-3d", i + 1, flock->bird[i]->life, flock->bird[i]->score);
+    }
+    // Update display
+    wrefresh(W->window);
+    //sleep(2);
+}
+
+// Waits for q (exit) or r (play again) on the end screen and returns it
+int WaitAgainOrQuit(WIN* W)
+{
+    int ch;
+    while((ch = wgetch(W->window)) != QUIT && ch != PLAY_AGAIN) {
+        }
+    return ch;
+}
+
+int EndGameWin(WIN* W)
+{
+    // Clear the window
+    CleanWin(W, 1);
+    nodelay(W->window , FALSE);
+    // Display goodbye message
+    wattron(W->window, COLOR_PAIR(STAT_COLOR));
+    mvwprintw(W->window, W->rows / 2 - 1 , W->cols / 2 - 18, "MISSION ACCOMPLISHED! SWALLOW SAVED!");
+    wattroff(W->window, COLOR_PAIR(STAT_COLOR));
+    sleep(1);
+    mvwprintw(W->window, W->rows / 2 + 1 , W->cols / 2 - 18, "Press r to play again or q to exit ");
+    wrefresh(W->window);
+
+    return WaitAgainOrQuit(W);
+  
+}
+
+int EndGameLose(WIN* W)
+{
+    CleanWin(W, 1);
+    nodelay(W->window , FALSE);
+    wattron(W->window, COLOR_PAIR(HUNTER_COLOR));
+    mvwprintw(W->window, W->rows / 2 - 1 , W->cols / 2 - 18 , "GAME OVER.");
+    wattroff(W->window, COLOR_PAIR(HUNTER_COLOR));
+    sleep(1);
+
+    mvwprintw(W->window, W->rows / 2 + 1 , W->cols / 2 - 18, "Press r to play again or q to exit ");
+    wrefresh(W->window);
+   
+
+    return WaitAgainOrQuit(W);
+
+}
+
+int EndGameQuit(WIN* W)
+{
+    CleanWin(W, 1);
+    mvwprintw(W->window, 2, 2, "Game Aborted.");
+    wrefresh(W->window);
+    sleep(1);
+    return QUIT;
+}
+
+//__MAIN_GAME_LOOP_AND_MECHANICS___//
+//==================================//
+//--------------------------------//
+
+void ApplyLevel(GameConfig *config , const LEVEL *level , int number)
+{
+    config->hunter_spawn_rate = level->hunter_spawn_rate;
+    config->hunter_bounces = level->hunter_bounces;
+    config->curr_level = number;
+    config->hunter_num = level->hunter_num;
+    if (level->hunter_speed > 0) config->hunter_speed = level->hunter_speed;
+}
+
+void Difficulty(GameConfig *config , const DIFFICULTY_TABLE *table , double time)
+{
+    double time_passed = time - config->time_limit;
+    // 4 levels , level 1 from 10 to 35 level 2 : from 35 to 60 level 3 : from 60 to 85 and level 4 : from 85 to 90
+    //spaw rate of hunter lowers , and the bounces increases so the live longer at the last level speed also increases
+    if (time_passed > 0 && time_passed <= config->time_limit/6.0) {
+            ApplyLevel(config , &table->level[0] , 1);
+        }
+        else if (time_passed > config->time_limit/6.0 && time_passed <= 2*config->time_limit/6.0) {
+            ApplyLevel(config , &table->level[1] , 2);
+        }
+        else if (time_passed > 2*config->time_limit/4.0 && time_passed <= 3.5 * config->time_limit/4.0) {
+            ApplyLevel(config , &table->level[2] , 3);
+        }
+        else if(time_passed > 3.5 * config->time_limit/4.0){
+            ApplyLevel(config , &table->level[3] , 4);
+        }
+}
+
+//Loads the per level settings written by --calibrate, same KEY VALUE format as config.txt
+//returns 1 if the file was read and 0 if the defaults are kept
+int LoadDifficulty(const char* filename, DIFFICULTY_TABLE* table)
+{
+    *table = DEFAULT_DIFFICULTY;
+    FILE* file = fopen(filename, "r");
+    if (!file) return 0;
+    char key[MAX_COMMAND_SIZE];
+    int level = 0;
+    while (fscanf(file, "%49s", key) == 1) {
+        if (strcmp(key, "LEVEL") == 0) {
+            if (fscanf(file, "%d", &level) != 1 || level < 1 || level > NUM_LEVELS) break;
+        }
+        else if (level == 0) {
+            break; // settings before the first LEVEL line
+        }
+        else if (strcmp(key, "HUNTER_SPEED") == 0) {
+            fscanf(file, "%lf", &table->level[level - 1].hunter_speed);
+        }
+        else {
+            int value = 0;
+            fscanf(file, "%d", &value);
+            if (strcmp(key, "HUNTER_SPAWN_RATE") == 0) table->level[level - 1].hunter_spawn_rate = value;
+            else if (strcmp(key, "HUNTER_BOUNCES") == 0) table->level[level - 1].hunter_bounces = value;
+            else if (strcmp(key, "HUNTER_NUM") == 0) table->level[level - 1].hunter_num = value;
+        }
+    }
+    fclose(file);
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        LEVEL* l = &table->level[i];
+        if (l->hunter_spawn_rate < 1) l->hunter_spawn_rate = 1;
+        if (l->hunter_num < 0) l->hunter_num = 0;
+        if (l->hunter_num > MAX_HUNTERS) l->hunter_num = MAX_HUNTERS;
+    }
+    return 1;
+}
+
+int SaveDifficulty(const char* filename, const DIFFICULTY_TABLE* table)
+{
+    FILE* file = fopen(filename, "w");
+    if (!file) return 0;
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        const LEVEL* l = &table->level[i];
+        fprintf(file, "LEVEL %d\n", i + 1);
+        fprintf(file, "HUNTER_SPAWN_RATE %d\n", l->hunter_spawn_rate);
+        fprintf(file, "HUNTER_BOUNCES %d\n", l->hunter_bounces);
+        fprintf(file, "HUNTER_NUM %d\n", l->hunter_num);
+        fprintf(file, "HUNTER_SPEED %.3f\n", l->hunter_speed);
+    }
+    fclose(file);
+    return 1;
+}
+
+// Takes the arena and copies config and table (the table must outlive the session).
+// playwin and statwin stay owned by the caller. Returns NULL if out of memory.
+GAME_SESSION* SessionCreate(const GameConfig* config, const DIFFICULTY_TABLE* table, WIN* playwin, WIN* statwin)
+{
+    GAME_SESSION* gs = (GAME_SESSION*)calloc(1, sizeof(GAME_SESSION));
+    if (!gs) return NULL;
+    size_t flow = config->map || config->pack ? FlowFieldSize(playwin->cols, playwin->rows) : 0;
+    size_t rain = config->star_rain ? RainSize(playwin->cols, playwin->rows) : 0;
+    size_t heat = config->heatmap ? HeatmapSize(playwin->cols, playwin->rows) : 0;
+    if (!ArenaInit(&gs->arena, SESSION_ARENA_SIZE + flow + rain + heat)) {
+        free(gs);
+        return NULL;
+    }
+    gs->base = *config;
+    gs->table = table;
+    gs->level_table = table;
+    gs->pack_level = 1;
+    gs->playwin = playwin;
+    gs->statwin = statwin;
+    return gs;
+}
+
+// Takes the settings of pack level gs->pack_level for the game about to start, and has
+// the level after it decoded in the background. Without it the game keeps config.txt's.
+static void EnterPackLevel(GAME_SESSION* gs)
+{
+    GameConfig* config = &gs->config;
+    PackRelease(config->pack, gs->level);
+    gs->level = PackLevel(config->pack, gs->pack_level);
+    gs->level_table = gs->table;
+    if (!gs->level) return;
+    const PACK_LEVEL* l = gs->level;
+    config->pack_level = gs->pack_level;
+    config->star_quota = l->star_quota;
+    config->time_limit = l->time_limit;
+    config->available_taxis = l->available_taxis;
+    config->taxi_bonus = l->taxi_bonus;
+    config->map = l->map;
+    gs->level_table = &l->table;
+    PackPrefetch(config->pack, gs->pack_level + 1);
+}
+
+// Starts a new game from seed: the arena is emptied and the actors are set up again in
+// it, in the same order (and so from the same random draws) as a fresh process would.
+void SessionReset(GAME_SESSION* gs, unsigned int seed)
+{
+    ArenaReset(&gs->arena);
+    gs->config = gs->base;
+    gs->seed = seed;
+    gs->games++;
+    gs->frame_allocs = 0;
+    GameSeed(seed);
+    GameConfig* config = &gs->config;
+    if (config->pack) EnterPackLevel(gs);
+    WIN* w = gs->playwin;
+    w->map = config->map;
+    for (int i = 0; i < config->birds; i++) gs->flock.bird[i] = (BIRD*)ArenaAlloc(&gs->arena, sizeof(BIRD));
+    gs->bird = gs->flock.bird[0];
+    gs->frame = 0;
+    gs->taxi = (TAXI*)ArenaAlloc(&gs->arena, sizeof(TAXI));
+    for (int i = 0; i < MAX_STARS; i++) gs->star[i] = (STAR*)ArenaAlloc(&gs->arena, sizeof(STAR));
+    for (int i = 0; i < MAX_HUNTERS; i++) gs->hunter[i] = (HUNTER*)ArenaAlloc(&gs->arena, sizeof(HUNTER));
+    ResetFlock(&gs->flock, config->birds, w, config);
+    if (w->map && w->map->walls) gs->flock.flow = InitFlowField(ArenaAlloc(&gs->arena, FlowFieldSize(w->cols, w->rows)), w, config);
+    ResetTaxi(gs->taxi, w, config);
+    ResetMultipleStar(gs->star, w);
+    ResetMultipleHunter(gs->hunter, w, &gs->flock, config);
+    gs->rain = config->star_rain ? InitRain(ArenaAlloc(&gs->arena, RainSize(w->cols, w->rows)), w, config->star_rain, seed) : NULL;
+    gs->heat = config->heatmap ? InitHeatmap(ArenaAlloc(&gs->arena, HeatmapSize(w->cols, w->rows)), w, &gs->flock) : NULL;
+    gs->max_time = config->time_limit;
+}
+
+void PlannerDestroy(PLANNER* p);
+
+void SessionDestroy(GAME_SESSION* gs)
+{
+    if (!gs) return;
+    PlannerDestroy(gs->planner);
+    PackRelease(gs->base.pack, gs->level);
+    ArenaFree(&gs->arena);
+    free(gs);
+    FreeHunterGrid();   // built again by the next session that flocks
+}
+
+// GAME_RUNNING, or 1 if the game is lost and 2 if it is won.
+// The birds play together: the stars of all of them count, and the game is lost when none is left.
+int GameResult(FLOCK* flock , GameConfig *config)
+{
+    int alive = 0, score = 0;
+    for (int i = 0; i < flock->count; i++) {
+        alive += BirdAlive(flock->bird[i]);
+        score += flock->bird[i]->score;
+    }
+    if (alive == 0 || config->time_limit <= 0) return 1; //defeat
+    if(score >= config->star_quota) return 2; //win
+    return GAME_RUNNING;
+}
+
+// One frame of game logic without any terminal I/O, shared by MainLoop and the headless games.
+// keys[i] is the key for bird i this frame (NOKEY for none), as the first player has them;
+// QUIT for the first bird ends the game. Returns GAME_RUNNING or the result of MainLoop.
+// dt frames are simulated at once (1 when playing); the swept collisions keep outcomes the
+// same for the longer steps used by headless games.
+int GameTick(WIN* playwin, FLOCK* flock , TAXI* taxi, STAR* star[] , HUNTER* hunter[] , GameConfig *config , const DIFFICULTY_TABLE *table , double max_time , const int keys[] , int dt)
+{
+    trace_tick++;
+    Difficulty(config , table , max_time);
+    if (dt > MAX_DT) dt = MAX_DT;
+    config->time_limit -= (FRAME_TIME / 1000.0) * dt;
+    // Check if player wants to quit
+    if (keys[0] == QUIT) return 0;
+    int result = GameResult(flock , config);
+    if (result != GAME_RUNNING) return result;
+    for (int i = 0; i < flock->count; i++) {
+        if (BirdAlive(flock->bird[i])) SteerBird(flock->bird[i] , taxi , config , keys[i]);
+    }
+    
+    // Move birds (automatic movement every frame)
+    if (taxi->active) {
+        MoveTaxi(taxi, flock , dt);
+    }
+    for (int i = 0; i < flock->count; i++) {
+        BIRD* bird = flock->bird[i];
+        if (!BirdAlive(bird)) continue;
+        if (bird->on_taxi == 0) {
+            config->kernel->move_bird(bird , dt);
+        } else {
+            UpdateBirdColor(bird);
+            DrawBird(bird);
+        }
+    }
+    IndexFlock(flock , dt);
+    PerfPhase(PHASE_BIRD);
+    
+    MoveMultipleStar(star , MAX_STARS , flock , config , dt);
+    PerfPhase(PHASE_STARS);
+    if (flock->flow) UpdateFlowField(flock->flow , flock , hunter , MAX_HUNTERS);
+    MoveMultipleHunter(hunter , flock , taxi, playwin , config , dt);
+    PerfPhase(PHASE_HUNTERS);
+    flock->tick += dt;
+    return GAME_RUNNING;
+}
+
+// GameTick on the session's game, keys[i] for bird i
+int SessionTick(GAME_SESSION* gs , const int keys[] , int dt)
+{
+    gs->frame += dt;
+    int result = GameTick(gs->playwin, &gs->flock , gs->taxi, gs->star , gs->hunter , &gs->config , gs->level_table , gs->max_time , keys , dt);
+    if (gs->rain && result == GAME_RUNNING) {
+        RainTick(gs->rain , &gs->flock , dt > MAX_DT ? MAX_DT : dt);
+        PerfPhase(PHASE_STARS);
+    }
+    if (gs->heat && result == GAME_RUNNING) {
+        HeatTick(gs->heat , &gs->flock , gs->hunter , MAX_HUNTERS);
+        PerfPhase(PHASE_HEAT);
+    }
+    return result;
+}
+
+//============================//
+//  WORLD SNAPSHOTS           //
+//==========================//
+
+// A whole game in one flat block, for code that plays possible futures: every actor is
+// stored by value and points only into the block (its window is the block's own headless
+// copy of the play window), so a clone is one memcpy plus relinking a few pointers, and
+// a step never draws. The map, the kernel and the difficulty table are shared read only.
+// STAR_RAIN is not part of it, a snapshot plays on as if the rain had stopped.
+typedef struct{
+    WIN win;                        // the play window without its ncurses window
+    GameConfig config;
+    const DIFFICULTY_TABLE* table;
+    double max_time;
+    long frame;
+    FLOCK flock;                    // flock.flow is scratch owned by whoever owns the block
+    TAXI taxi;
+    BIRD bird[MAX_BIRDS];
+    STAR star[MAX_STARS];
+    HUNTER hunter[MAX_HUNTERS];
+    STAR* stars[MAX_STARS];         // the arrays GameTick takes
+    HUNTER* hunters[MAX_HUNTERS];
+} WORLD;
+
+// Points every actor of w back into w, rider is the bird on the taxi or -1
+static void WorldLink(WORLD* w , int rider)
+{
+    for (int i = 0; i < w->flock.count; i++) {
+        w->bird[i].win = &w->win;
+        w->flock.bird[i] = &w->bird[i];
+    }
+    for (int i = 0; i < MAX_STARS; i++) {
+        w->star[i].win = &w->win;
+        w->stars[i] = &w->star[i];
+    }
+    for (int i = 0; i < MAX_HUNTERS; i++) {
+        w->hunter[i].win = &w->win;
+        w->hunters[i] = &w->hunter[i];
+    }
+    w->taxi.win = &w->win;
+    w->taxi.rider = rider >= 0 ? &w->bird[rider] : NULL;
+}
+
+// Snapshot of the session's game. flow is scratch for the hunters' routes, from
+// InitFlowField, when the board has walls (NULL otherwise).
+void WorldSave(WORLD* w , const GAME_SESSION* gs , FLOW_FIELD* flow)
+{
+    w->win = *gs->playwin;
+    w->win.window = NULL;
+    w->config = gs->config;
+    w->table = gs->level_table;
+    w->max_time = gs->max_time;
+    w->frame = gs->frame;
+    w->flock = gs->flock;
+    w->flock.flow = flow;
+    w->taxi = *gs->taxi;
+    int rider = -1;
+    for (int i = 0; i < gs->flock.count; i++) {
+        w->bird[i] = *gs->flock.bird[i];
+        if (gs->taxi->rider == gs->flock.bird[i]) rider = i;
+    }
+    for (int i = 0; i < MAX_STARS; i++) w->star[i] = *gs->star[i];
+    for (int i = 0; i < MAX_HUNTERS; i++) w->hunter[i] = *gs->hunter[i];
+    WorldLink(w , rider);
+}
+
+// dst becomes src, keeping its own flow field scratch
+void WorldClone(WORLD* dst , const WORLD* src)
+{
+    FLOW_FIELD* flow = dst->flock.flow;
+    memcpy(dst , src , sizeof(WORLD));
+    WorldLink(dst , src->taxi.rider ? (int)(src->taxi.rider - src->bird) : -1);
+    dst->flock.flow = flow;
+}
+
+// Puts a snapshot back into the session's game, the other way round from WorldSave. The
+// session keeps its windows, map, pack and flow field, the rest is the snapshot's. It must
+// have as many birds as the snapshot.
+void WorldRestore(GAME_SESSION* gs , const WORLD* w)
+{
+    GameConfig* config = &gs->config;
+    const MAP* map = config->map;
+    LEVEL_PACK* pack = config->pack;
+    *config = w->config;
+    config->map = map;
+    config->pack = pack;
+    config->kernel = SelectKernel(config);
+    gs->max_time = w->max_time;
+    gs->frame = w->frame;
+    FLOCK* f = &gs->flock;
+    BIRD* bird[MAX_BIRDS];
+    memcpy(bird, f->bird, sizeof(bird));
+    FLOW_FIELD* flow = f->flow;
+    *f = w->flock;
+    f->flow = flow;
+    for (int i = 0; i < f->count; i++) {
+        char* symbol = bird[i]->symbol;
+        *bird[i] = w->bird[i];
+        bird[i]->win = gs->playwin;
+        bird[i]->symbol = symbol;
+        bird[i]->dirty = 1;
+        f->bird[i] = bird[i];
+    }
+    char* symbol = gs->taxi->symbol;
+    *gs->taxi = w->taxi;
+    gs->taxi->win = gs->playwin;
+    gs->taxi->symbol = symbol;
+    gs->taxi->rider = w->taxi.rider ? bird[w->taxi.rider - w->bird] : NULL;
+    gs->taxi->dirty = 1;
+    for (int i = 0; i < MAX_STARS; i++) {
+        *gs->star[i] = w->star[i];
+        gs->star[i]->win = gs->playwin;
+        gs->star[i]->dirty = 1;
+    }
+    for (int i = 0; i < MAX_HUNTERS; i++) {
+        *gs->hunter[i] = w->hunter[i];
+        gs->hunter[i]->win = gs->playwin;
+        gs->hunter[i]->dirty = 1;
+    }
+}
+
+// GameTick on the snapshot, without drawing, tracing or perf counting. Safe on any thread.
+int WorldStep(WORLD* w , const int keys[] , int dt)
+{
+    PERF* perf = phase_perf;
+    uint32_t tick = trace_tick;
+    phase_perf = NULL;
+    trace_muted = 1;
+    w->frame += dt;
+    int result = GameTick(&w->win, &w->flock , &w->taxi , w->stars , w->hunters , &w->config , w->table , w->max_time , keys , dt);
+    trace_muted = 0;
+    trace_tick = tick;
+    phase_perf = perf;
+    return result;
+}
+
+// Keys of the local players: the first player's are the ones GameTick knows, the others'
+// are translated to them. Up, down, left, right, speed up, speed down, taxi.
+static const int PLAYER_KEYS[MAX_PLAYERS][7] = {
+    { UP, DOWN, LEFT, RIGHT, SPEED_UP, SPEED_DOWN, ACTIVATE_TAXI },
+    { KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, '.', ',', '/' },
+    { 'i', 'k', 'j', 'l', 'u', 'h', 'n' },
+};
+
+// Every key pressed since the last frame, the first one for each player counts
+void ReadPlayerKeys(WINDOW* w , int keys[] , int players)
+{
+    for (int i = 0; i < MAX_BIRDS; i++) keys[i] = NOKEY;
+    int ch;
+    while ((ch = wgetch(w)) != ERR) {
+        if (ch == QUIT) keys[0] = QUIT;
+        for (int p = 0; p < players; p++) {
+            for (int k = 0; k < 7; k++) {
+                if (ch == PLAYER_KEYS[p][k] && keys[p] == NOKEY) keys[p] = PLAYER_KEYS[0][k];
+            }
+        }
+    }
+}
+
+void BotKeys(GAME_SESSION* gs , int keys[] , int first , int dt);
+void AutosaveTick(const GAME_SESSION* gs);
+
+int MainLoop(GAME_SESSION* gs)
+{
+    int keys[MAX_BIRDS];    // key for every bird this frame
+    int players = gs->config.players < gs->flock.count ? gs->config.players : gs->flock.count;
+    WIN* playwin = gs->playwin;
+    WIN* statwin = gs->statwin;
+    long first_frame_allocs = -1;
+    uint64_t last_start = 0;
+    ShmNewGame();
+    // Infinite loop - runs until player quits
+    while (1)
+    {
+        uint64_t start = TraceWallNs();
+        TraceEvent(TRACE_FRAME_BEGIN, -1, 0, 0, 0);
+        PerfStartTick();
+        // Read keyboard input (non-blocking due to nodelay(TRUE)), the bot flies the other birds
+        ReadPlayerKeys(statwin->window , keys , players);
+        BotKeys(gs , keys , players , 1);
+        PerfPhase(PHASE_INPUT);
+        int result = SessionTick(gs , keys , 1);
+        ShmPublish(gs, result);
+        PerfPhase(PHASE_EXPORT);
+        if (result != GAME_RUNNING) {
+            TraceEvent(TRACE_FRAME_END, -1, 0, 0, 0);
+            if (first_frame_allocs >= 0) gs->frame_allocs = alloc_count - first_frame_allocs;
+            return result;
+        }
+        mvwprintw(playwin->window, 1, playwin->cols - 2, "Z");
+        
+        // Update status bar with current position
+        ShowStatus(statwin, &gs->flock , &gs->config);
+        
+        // Refresh play window to show changes
+        wrefresh(playwin->window);
+
+        // Clear input buffer to avoid key press accumulation
+        flushinp();
+        PerfPhase(PHASE_RENDER);
+        RecordFrame();
+        AutosaveTick(gs);
+        PerfPhase(PHASE_RECORD);
+        TraceEvent(TRACE_FRAME_END, -1, 0, 0, 0);
+        // the first frame may still set things up (trace ring, entity batch), the rest must not allocate
+        if (first_frame_allocs < 0) first_frame_allocs = alloc_count;
+        MetricsFrame(gs, TraceWallNs() - start, last_start ? start - last_start : 0);
+        last_start = start;
+
+        // Sleep to control frame rate
+        // FRAME_TIME is in milliseconds, usleep needs microseconds
+        usleep(FRAME_TIME * 1000);
+    }
+}
+
+// Shows the end screen, returns 1 if the player wants another game
+int EndGameResult(int result, WIN* statwin)
+{
+    int ch = QUIT;
+    if (result == 2) {
+            ch = EndGameWin(statwin);
+        }
+        else if (result == 1) {
+            ch = EndGameLose(statwin);
+        }
+        else if(result == 0){
+            ch = EndGameQuit(statwin);
+        }
+    return ch == PLAY_AGAIN;
+}
+
+// Next game on the same screen: a new seed, the arena reset and the windows redrawn
+void PlayAgain(WINDOW* mainwin, GAME_SESSION* gs)
+{
+    SessionReset(gs, gs->seed + 1);
+    werase(mainwin);
+    wnoutrefresh(mainwin);
+    CleanWin(gs->playwin, BORDER);
+    CleanWin(gs->statwin, BORDER);
+    nodelay(gs->statwin->window, TRUE);
+    DrawMap(gs->playwin);
+    DrawFlock(&gs->flock);
+    ShowStatus(gs->statwin, &gs->flock , &gs->config);
+    wrefresh(gs->playwin->window);
+}
+
+void CleanUpMemory(WINDOW* mainwin, GAME_SESSION* gs){
+    WIN* playwin = gs->playwin;
+    WIN* statwin = gs->statwin;
+    // Delete ncurses windows
+    delwin(playwin->window);
+    delwin(statwin->window);
+    delwin(mainwin);
+
+    // Close ncurses
+    endwin();
+    refresh();
+    // Free allocated memory
+    SessionDestroy(gs);
+    free(playwin);
+    free(statwin);
+}
+
+
+
+//__AUTOSAVE__________________________//
+//====================================//
+//------------------------------------//
+
+// AUTOSAVE <seconds> in config.txt checkpoints the game that often into AUTOSAVE_FILE, and
+// when the process died in the middle of a game (a dropped SSH session, a rebooted kiosk)
+// the next start offers to go on from there. A checkpoint is a WORLD snapshot plus what a
+// snapshot leaves out: the seeds, the rain and the pack level. Double buffered: the game
+// thread copies it into whichever of the two slots is free, a few microseconds, and a
+// writer thread puts it on disk through a temporary file and a rename, so a crash during a
+// write keeps the checkpoint before it. With both slots still being written the checkpoint
+// is skipped, the game never waits. A game that ends, quit included, removes the file.
+#define AUTOSAVE_FILE    "autosave.bin"
+#define AUTOSAVE_TMP     ".tmp"         // after the file's name while it is written
+#define AUTOSAVE_MAGIC   0x56535753     // "SWSV"
+#define AUTOSAVE_VERSION 1
+#define AUTOSAVE_SLOTS   2
+#define AUTOSAVE_POLL_US 20000
+
+typedef struct{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                  // sizeof(CHECKPOINT), other builds' checkpoints are refused
+    uint32_t crc;                   // crc32 of the checkpoint with crc 0, then of the rain
+    int64_t saved;                  // time(NULL)
+    unsigned int seed;              // of the game, its random draws are keyed by it
+    unsigned int rng;               // rng_state of the game thread
+    int games;
+    int pack_level;
+    int rider;                      // bird on the taxi, -1 for none
+    uint32_t rain_bytes;            // rain planes after the checkpoint, 0 without STAR_RAIN
+    long rain_stars, rain_frame;
+    int rain_top[RAIN_CLASSES];
+    WORLD world;                    // its pointers mean nothing on disk, they are linked again on load
+} CHECKPOINT;
+
+typedef struct{
+    CHECKPOINT c;
+    uint64_t* rain;
+} AUTOSAVE_SLOT;
+
+typedef struct{
+    atomic_int running;
+    atomic_uint head, tail;         // slots taken by the game thread and written by the writer
+    atomic_uint skipped;            // checkpoints dropped because both slots were busy
+    long frames;                    // between checkpoints, 0 while off
+    const char* file;               // AUTOSAVE_FILE, --autosave-check has its own
+    size_t rain_bytes;
+    pthread_t writer;
+    AUTOSAVE_SLOT slot[AUTOSAVE_SLOTS];
+} AUTOSAVER;
+
+static AUTOSAVER autosaver;
+
+static size_t RainPlaneBytes(const STAR_RAIN* r)
+{
+    return r ? (size_t)RAIN_CLASSES * r->rows * r->words * sizeof(uint64_t) : 0;
+}
+
+// Game thread, once a frame: copies the game into a free slot every autosaver.frames
+void AutosaveTick(const GAME_SESSION* gs)
+{
+    if (!autosaver.frames || gs->frame % autosaver.frames) return;
+    unsigned int head = atomic_load_explicit(&autosaver.head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&autosaver.tail, memory_order_acquire) >= AUTOSAVE_SLOTS) {
+        atomic_fetch_add_explicit(&autosaver.skipped, 1, memory_order_relaxed);
+        return;
+    }
+    AUTOSAVE_SLOT* s = &autosaver.slot[head % AUTOSAVE_SLOTS];
+    CHECKPOINT* c = &s->c;
+    WorldSave(&c->world, gs, NULL);
+    c->saved = time(NULL);
+    c->seed = gs->seed;
+    c->rng = rng_state;
+    c->games = gs->games;
+    c->pack_level = gs->pack_level;
+    c->rider = c->world.taxi.rider ? (int)(c->world.taxi.rider - c->world.bird) : -1;
+    c->rain_bytes = 0;
+    if (gs->rain && s->rain) {
+        c->rain_bytes = (uint32_t)autosaver.rain_bytes;
+        c->rain_stars = gs->rain->stars;
+        c->rain_frame = gs->rain->frame;
+        memcpy(c->rain_top, gs->rain->top, sizeof(c->rain_top));
+        memcpy(s->rain, gs->rain->plane, autosaver.rain_bytes);
+    }
+    atomic_store_explicit(&autosaver.head, head + 1, memory_order_release);
+}
+
+static uint32_t CheckpointCrc(CHECKPOINT* c, const uint64_t* rain)
+{
+    uint32_t crc = c->crc;
+    c->crc = 0;
+    uLong sum = crc32(0L, (const Bytef*)c, sizeof(*c));
+    if (c->rain_bytes) sum = crc32(sum, (const Bytef*)rain, c->rain_bytes);
+    c->crc = crc;
+    return (uint32_t)sum;
+}
+
+static int WriteAll(int fd, const void* p, size_t n)
+{
+    const char* b = (const char*)p;
+    while (n > 0) {
+        ssize_t w = write(fd, b, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return 0;
+        b += w;
+        n -= w;
+    }
+    return 1;
+}
+
+// Writer thread: the slot to the file + AUTOSAVE_TMP, on disk before it replaces the file
+static void AutosaveWrite(AUTOSAVE_SLOT* s)
+{
+    CHECKPOINT* c = &s->c;
+    c->magic = AUTOSAVE_MAGIC;
+    c->version = AUTOSAVE_VERSION;
+    c->size = sizeof(CHECKPOINT);
+    c->crc = CheckpointCrc(c, s->rain);
+    char tmp[MAX_MAP_PATH + sizeof(AUTOSAVE_TMP)];
+    snprintf(tmp, sizeof(tmp), "%s" AUTOSAVE_TMP, autosaver.file);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    int ok = WriteAll(fd, c, sizeof(*c)) && (!c->rain_bytes || WriteAll(fd, s->rain, c->rain_bytes));
+    ok = fdatasync(fd) == 0 && ok;
+    close(fd);
+    if (ok) rename(tmp, autosaver.file);
+    else unlink(tmp);
+}
+
+static void AutosaveDrain(void)
+{
+    unsigned int tail = atomic_load_explicit(&autosaver.tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&autosaver.head, memory_order_acquire);
+    while (tail != head) {
+        AutosaveWrite(&autosaver.slot[tail % AUTOSAVE_SLOTS]);
+        atomic_store_explicit(&autosaver.tail, ++tail, memory_order_release);
+    }
+}
+
+void* AutosaveWriter(void* arg)
+{
+    (void)arg;
+    while (atomic_load(&autosaver.running)) {
+        usleep(AUTOSAVE_POLL_US);
+        AutosaveDrain();
+    }
+    return NULL;
+}
+
+// Checkpoints every seconds of gs's games into file from now on. Returns 0 if memory runs out.
+int AutosaveStart(const GAME_SESSION* gs, int seconds, const char* file)
+{
+    autosaver.frames = 0;
+    autosaver.file = file;
+    autosaver.rain_bytes = RainPlaneBytes(gs->rain);
+    // touched now, so the first checkpoints do not take page faults in the middle of a frame
+    for (int i = 0; i < AUTOSAVE_SLOTS; i++) {
+        memset(&autosaver.slot[i].c, 0, sizeof(CHECKPOINT));
+        autosaver.slot[i].rain = autosaver.rain_bytes ? (uint64_t*)malloc(autosaver.rain_bytes) : NULL;
+        if (autosaver.rain_bytes && !autosaver.slot[i].rain) return 0;
+        if (autosaver.slot[i].rain) memset(autosaver.slot[i].rain, 0, autosaver.rain_bytes);
+    }
+    atomic_store(&autosaver.head, 0);
+    atomic_store(&autosaver.tail, 0);
+    atomic_store(&autosaver.skipped, 0);
+    atomic_store(&autosaver.running, 1);
+    if (pthread_create(&autosaver.writer, NULL, AutosaveWriter, NULL) != 0) {
+        atomic_store(&autosaver.running, 0);
+        return 0;
+    }
+    autosaver.frames = seconds * 1000L / FRAME_TIME;
+    if (autosaver.frames < 1) autosaver.frames = 1;
+    return 1;
+}
+
+// Waits until the checkpoints taken so far are on disk
+static void AutosaveFlush(void)
+{
+    while (atomic_load(&autosaver.tail) != atomic_load(&autosaver.head)) usleep(AUTOSAVE_POLL_US / 4);
+}
+
+// The game is over, there is nothing to resume: waits for the checkpoint being written
+// (the game has ended, no frame waits) and removes the file
+void AutosaveDiscard(void)
+{
+    if (!autosaver.frames) return;
+    AutosaveFlush();
+    unlink(autosaver.file);
+}
+
+void AutosaveStop(void)
+{
+    if (!autosaver.frames) return;
+    autosaver.frames = 0;
+    atomic_store(&autosaver.running, 0);
+    pthread_join(autosaver.writer, NULL);
+    AutosaveDrain();
+    for (int i = 0; i < AUTOSAVE_SLOTS; i++) {
+        free(autosaver.slot[i].rain);
+        autosaver.slot[i].rain = NULL;
+    }
+}
+
+// Reads the autosave file into the slot, 0 if there is none, it is damaged or it was saved
+// with other settings than gs's (board, birds, map, pack or rain)
+static int AutosaveLoad(AUTOSAVE_SLOT* s, const GAME_SESSION* gs)
+{
+    CHECKPOINT* c = &s->c;
+    FILE* file = fopen(autosaver.file, "rb");
+    if (!file) return 0;
+    int ok = fread(c, sizeof(*c), 1, file) == 1 && c->magic == AUTOSAVE_MAGIC &&
+             c->version == AUTOSAVE_VERSION && c->size == sizeof(CHECKPOINT) &&
+             c->rain_bytes == autosaver.rain_bytes &&
+             (!c->rain_bytes || fread(s->rain, c->rain_bytes, 1, file) == 1);
+    fclose(file);
+    if (!ok || c->crc != CheckpointCrc(c, s->rain)) return 0;
+    const GameConfig* base = &gs->base;
+    const WORLD* w = &c->world;
+    return w->win.cols == gs->playwin->cols && w->win.rows == gs->playwin->rows &&
+           w->flock.count == base->birds && c->rider < w->flock.count &&
+           w->config.star_rain == base->star_rain &&
+           strcmp(w->config.map_file, base->map_file) == 0 &&
+           strcmp(w->config.pack_file, base->pack_file) == 0;
+}
+
+// Asks on the status bar whether to go on with the saved game, 1 for yes
+static int AskResume(WIN* W, const CHECKPOINT* c)
+{
+    int score = 0;
+    for (int i = 0; i < c->world.flock.count; i++) score += c->world.bird[i].score;
+    time_t saved = (time_t)c->saved;
+    struct tm* t = localtime(&saved);
+    char when[16] = "";
+    if (t) snprintf(when, sizeof(when), " at %02d:%02d", t->tm_hour, t->tm_min);
+    CleanWin(W, 1);
+    nodelay(W->window, FALSE);
+    mvwprintw(W->window, 1, 2, "Game saved%s: level %d, %d stars, %.0f s left. Resume it? (y/n)",
+              when, c->world.config.curr_level, score, c->world.config.time_limit);
+    wrefresh(W->window);
+    int ch;
+    while ((ch = wgetch(W->window)) != 'y' && ch != 'n' && ch != QUIT) {
+    }
+    nodelay(W->window, TRUE);
+    CleanWin(W, 1);
+    return ch == 'y';
+}
+
+// Puts gs back to the checkpoint AutosaveLoad read into s
+static void AutosaveResume(GAME_SESSION* gs, AUTOSAVE_SLOT* s)
+{
+    CHECKPOINT* c = &s->c;
+    WorldLink(&c->world, c->rider);
+    gs->pack_level = c->pack_level;
+    gs->games = c->games - 1;
+    SessionReset(gs, c->seed);
+    WorldRestore(gs, &c->world);
+    rng_state = c->rng;
+    if (gs->heat) InitHeatmap(gs->heat, gs->playwin, &gs->flock);   // counts from here on
+    if (gs->rain && c->rain_bytes) {
+        STAR_RAIN* r = gs->rain;
+        r->stars = c->rain_stars;
+        r->frame = c->rain_frame;
+        memcpy(r->top, c->rain_top, sizeof(r->top));
+        memcpy(r->plane, s->rain, c->rain_bytes);
+        memset(r->shown, 0, (size_t)r->rows * r->words * sizeof(uint64_t));   // the screen is blank
+    }
+}
+
+// After AutosaveStart: if a game was left behind, offers it and puts gs back to it.
+// Returns 1 if the game was resumed.
+int AutosaveOffer(GAME_SESSION* gs)
+{
+    AUTOSAVE_SLOT* s = &autosaver.slot[0];   // free until the first checkpoint
+    if (!AutosaveLoad(s, gs)) return 0;
+    if (!AskResume(gs->statwin, &s->c)) {
+        unlink(autosaver.file);
+        return 0;
+    }
+    AutosaveResume(gs, s);
+    return 1;
+}
+
+
+
+//__HEADLESS GAMES AND CALIBRATION___//
+//====================================//
+//------------------------------------//
+
+// Reference bot for the headless games: dodges hunters that are close,
+// calls the taxi when hurt and otherwise chases the nearest star.
+#define BOT_DANGER_X   8
+#define BOT_DANGER_Y   4
+#define BOT_TAXI_LIFE  40
+#define BOT_REACTION_FRAMES 8   // the bot only decides every 8 frames (400ms), like a player would
+
+int BotKeyToward(BIRD* b, int tx, int ty)
+{
+    int bird_width = b->width;
+    if (tx < b->x) return LEFT;
+    if (tx >= b->x + bird_width) return RIGHT;
+    if (ty < b->y) return UP;
+    if (ty > b->y) return DOWN;
+    return NOKEY;
+}
+
+int BotKey(BIRD* b, TAXI* t, STAR* s[], HUNTER* h[], GameConfig* config)
+{
+    if (b->on_taxi) return NOKEY;
+    if (b->speed < config->swallow_speed_max) return SPEED_UP;
+    if (b->life <= BOT_TAXI_LIFE && !t->active && config->available_taxis > 0) return ACTIVATE_TAXI;
+
+    int bird_width = b->width;
+    double bx = b->x + bird_width / 2.0;
+    double by = b->y;
+    for (int i = 0; i < config->hunter_num; i++) {
+        if (!h[i]->active) continue;
+        double hx = h[i]->x + h[i]->width / 2.0;
+        double hy = h[i]->y + h[i]->height / 2.0;
+        if (fabs(hx - bx) > BOT_DANGER_X || fabs(hy - by) > BOT_DANGER_Y) continue;
+        // step out of the hunter's line of flight
+        if (fabs(h[i]->dx) >= fabs(h[i]->dy)) {
+            int key = (by <= hy) ? UP : DOWN;
+            if (key == UP && b->y <= BORDER + 1) key = DOWN;
+            else if (key == DOWN && b->y >= b->win->rows - BORDER - 2) key = UP;
+            return key;
+        }
+        int key = (bx <= hx) ? LEFT : RIGHT;
+        if (key == LEFT && b->x <= BORDER + 1) key = RIGHT;
+        else if (key == RIGHT && b->x >= b->win->cols - BORDER - bird_width - 1) key = LEFT;
+        return key;
+    }
+
+    if (t->active && t->state == 0) {
+        return BotKeyToward(b, t->x + SAFE_ZONEW / 2, t->y + SAFE_ZONEH / 2);
+    }
+
+    STAR* target = NULL;
+    int best = 0;
+    for (int i = 0; i < MAX_STARS; i++) {
+        int dist = abs(s[i]->x - (int)bx) + abs(s[i]->y - b->y);
+        if (target == NULL || dist < best) {
+            target = s[i];
+            best = dist;
+        }
+    }
+    return BotKeyToward(b, target->x, target->y);
+}
+
+// Lookahead bot: Monte Carlo tree search over snapshots of the game. Every node is a
+// choice of key for the bird, held for PLAN_HOLD frames, and every iteration replays a path
+// from a clone of the current game, adds a node and plays on with the reference bot
+// (with some random keys) for PLAN_ROLLOUT more choices. With more than one thread, every
+// thread grows its own tree from the same snapshot and their root counts are added up.
+#define PLAN_HOLD        4      // frames a key is held, the planner decides this often
+#define PLAN_DEPTH       12     // tree levels
+#define PLAN_ROLLOUT     6      // choices played out after the tree
+#define PLAN_EXPLORE     1.5
+#define PLAN_RANDOM      4      // one rollout key in 4 is random
+#define PLAN_HIT_COST    2.0    // value of a hit, in stars
+#define PLAN_DEATH_COST  20.0
+#define PLAN_WIN_VALUE   20.0
+#define PLAN_STAR_PULL   0.01   // per cell to the nearest star at the end of a rollout
+#define PLAN_ACTIONS     6
+#define PLAN_MAX_THREADS 64
+
+static const int PLAN_KEYS[PLAN_ACTIONS] = { NOKEY, UP, DOWN, LEFT, RIGHT, ACTIVATE_TAXI };
+
+typedef struct{
+    int32_t child[PLAN_ACTIONS];    // node index, 0 for not expanded yet (0 is the root)
+    int32_t count[PLAN_ACTIONS];
+    float total[PLAN_ACTIONS];
+    int32_t visits;
+} PLAN_NODE;
+
+typedef struct{
+    WORLD world;                    // the iteration's game
+    PLAN_NODE* nodes;
+    int used, capacity;
+    unsigned int rng;
+    long ticks;                     // simulated this decision
+    FLOW_FIELD* flow;
+    char pad[64];                   // trees are written by different threads
+} PLAN_TREE;
+
+struct PLANNER{
+    int threads;
+    long budget;                    // simulated ticks per decision, all trees together
+    int bird;                       // bird of the current decision
+    WORLD root;
+    PLAN_TREE* tree;
+    JOB_SYSTEM* jobs;               // NULL for one thread
+    int games;                      // session game the trees' flow fields were laid out for
+    long decisions;
+    long ticks;                     // simulated in all decisions
+    uint64_t ns;                    // spent in all decisions
+};
+
+void PlannerDestroy(PLANNER* p)
+{
+    if (!p) return;
+    for (int i = 0; i < p->threads && p->tree; i++) {
+        free(p->tree[i].nodes);
+        free(p->tree[i].flow);
+    }
+    free(p->tree);
+    if (p->jobs) JobsDestroy(p->jobs);
+    free(p);
+}
+
+// budget simulated ticks per decision on threads threads, for games of config on the board of w.
+// Everything is allocated here, deciding does not touch the heap. NULL if out of memory.
+PLANNER* PlannerCreate(const GameConfig* config , const WIN* w , long budget , int threads)
+{
+    if (threads < 1) threads = 1;
+    if (threads > PLAN_MAX_THREADS) threads = PLAN_MAX_THREADS;
+    PLANNER* p = (PLANNER*)calloc(1, sizeof(PLANNER));
+    if (!p) return NULL;
+    p->threads = threads;
+    p->budget = budget;
+    p->tree = (PLAN_TREE*)calloc(threads, sizeof(PLAN_TREE));
+    if (!p->tree) {
+        PlannerDestroy(p);
+        return NULL;
+    }
+    WIN board = *w;
+    board.map = config->map;
+    int walls = config->map || config->pack;     // every pack level may have its own
+    for (int i = 0; i < threads; i++) {
+        PLAN_TREE* t = &p->tree[i];
+        // every iteration simulates at least one held key and adds at most one node
+        t->capacity = (int)(budget / threads / PLAN_HOLD) + 2;
+        t->nodes = (PLAN_NODE*)malloc(t->capacity * sizeof(PLAN_NODE));
+        if (walls) t->flow = InitFlowField(malloc(FlowFieldSize(board.cols, board.rows)), &board, config);
+        if (!t->nodes || (walls && !t->flow)) {
+            PlannerDestroy(p);
+            return NULL;
+        }
+    }
+    if (threads > 1) p->jobs = JobsCreate(threads, threads);   // NULL: the trees take turns on this thread
+    return p;
+}
+
+static inline int PlanActions(const WORLD* w)
+{
+    return !w->taxi.active && w->config.available_taxis > 0 ? PLAN_ACTIONS : PLAN_ACTIONS - 1;
+}
+
+// Holds key for PLAN_HOLD frames (a direction stays until changed, so it is pressed once)
+static int PlanStep(PLAN_TREE* t , int bird , int key)
+{
+    int keys[MAX_BIRDS];
+    for (int i = 0; i < MAX_BIRDS; i++) keys[i] = NOKEY;
+    int result = GAME_RUNNING;
+    for (int f = 0; f < PLAN_HOLD && result == GAME_RUNNING && BirdAlive(&t->world.bird[bird]); f++) {
+        keys[bird] = f == 0 ? key : NOKEY;
+        result = WorldStep(&t->world , keys , 1);
+        t->ticks++;
+    }
+    return result;
+}
+
+static float PlanValue(const WORLD* w , const BIRD* start , int bird , int result)
+{
+    const BIRD* b = &w->bird[bird];
+    double v = (b->score - start->score) - PLAN_HIT_COST * (start->life - b->life) / w->config.damage_penalty;
+    if (!BirdAlive(b)) return (float)(v - PLAN_DEATH_COST);
+    if (result == 2) return (float)(v + PLAN_WIN_VALUE);
+    int best = -1;
+    for (int i = 0; i < MAX_STARS; i++) {
+        int d = abs(w->star[i].x - b->x) + abs(w->star[i].y - b->y);
+        if (best < 0 || d < best) best = d;
+    }
+    return (float)(v - PLAN_STAR_PULL * best);
+}
+
+static int PlanSelect(const PLAN_NODE* n , int actions)
+{
+    int best = 0;
+    double best_ucb = -1e30;
+    double log_n = log((double)n->visits + 1);
+    for (int a = 0; a < actions; a++) {
+        double ucb = n->total[a] / n->count[a] + PLAN_EXPLORE * sqrt(log_n / n->count[a]);
+        if (ucb > best_ucb) {
+            best = a;
+            best_ucb = ucb;
+        }
+    }
+    return best;
+}
+
+// Grows tree i for its share of the budget, a JOB_FN
+void PlanTreeJob(void* arg , int i)
+{
+    PLANNER* p = (PLANNER*)arg;
+    PLAN_TREE* t = &p->tree[i];
+    long budget = p->budget / p->threads;
+    const BIRD* start = &p->root.bird[p->bird];
+    int path_node[PLAN_DEPTH + 1], path_action[PLAN_DEPTH + 1];
+    t->ticks = 0;
+    t->used = 1;
+    memset(&t->nodes[0], 0, sizeof(PLAN_NODE));
+    while (t->ticks < budget) {
+        WorldClone(&t->world , &p->root);
+        int node = 0, depth = 0, result = GAME_RUNNING;
+        // down the tree while every key of the node has been tried
+        while (depth < PLAN_DEPTH && result == GAME_RUNNING && BirdAlive(&t->world.bird[p->bird])) {
+            PLAN_NODE* n = &t->nodes[node];
+            int actions = PlanActions(&t->world);
+            int a = 0;
+            while (a < actions && n->count[a] > 0) a++;
+            int expand = a < actions;
+            if (expand && t->used >= t->capacity) break;
+            if (!expand) a = PlanSelect(n , actions);
+            path_node[depth] = node;
+            path_action[depth] = a;
+            depth++;
+            result = PlanStep(t , p->bird , PLAN_KEYS[a]);
+            if (expand) {
+                memset(&t->nodes[t->used], 0, sizeof(PLAN_NODE));
+                n->child[a] = t->used++;
+                break;
+            }
+            node = n->child[a];
+        }
+        // and on with the reference bot
+        for (int r = 0; r < PLAN_ROLLOUT && result == GAME_RUNNING && BirdAlive(&t->world.bird[p->bird]); r++) {
+            WORLD* w = &t->world;
+            int key = GameRandFrom(&t->rng) % PLAN_RANDOM == 0 ?
+                      PLAN_KEYS[GameRandFrom(&t->rng) % PlanActions(w)] :
+                      BotKey(&w->bird[p->bird] , &w->taxi , w->stars , w->hunters , &w->config);
+            result = PlanStep(t , p->bird , key);
+        }
+        float v = PlanValue(&t->world , start , p->bird , result);
+        for (int d = 0; d < depth; d++) {
+            PLAN_NODE* n = &t->nodes[path_node[d]];
+            n->visits++;
+            n->count[path_action[d]]++;
+            n->total[path_action[d]] += v;
+        }
+        if (depth == 0) break;      // the game ends right away, nothing to choose
+    }
+}
+
+// The key for bird of gs, chosen by searching futures of the current game
+int PlannerKey(PLANNER* p , const GAME_SESSION* gs , int bird)
+{
+    const BIRD* b = gs->flock.bird[bird];
+    if (b->on_taxi) return NOKEY;
+    if (b->speed < gs->config.swallow_speed_max) return SPEED_UP;
+    uint64_t start = TraceWallNs();
+    p->bird = bird;
+    WorldSave(&p->root , gs , NULL);
+    int walls = p->root.win.map && p->root.win.map->walls;
+    for (int i = 0; i < p->threads; i++) {
+        PLAN_TREE* t = &p->tree[i];
+        // a new game may be a pack level with other walls
+        if (t->flow && p->games != gs->games) InitFlowField(t->flow , &p->root.win , &p->root.config);
+        t->world.flock.flow = walls ? t->flow : NULL;
+        t->rng = (unsigned int)(gs->seed * 2654435761u) ^ (unsigned int)(gs->frame * 40503u) ^ (unsigned int)(i * 69069u + bird);
+    }
+    p->games = gs->games;
+    if (p->jobs) JobsParallelFor(p->jobs , p->threads , PlanTreeJob , p);
+    else for (int i = 0; i < p->threads; i++) PlanTreeJob(p , i);
+    int actions = PlanActions(&p->root);
+    int best = 0;
+    long best_count = -1;
+    double best_mean = 0;
+    for (int a = 0; a < actions; a++) {
+        long count = 0;
+        double total = 0;
+        for (int i = 0; i < p->threads; i++) {
+            count += p->tree[i].nodes[0].count[a];
+            total += p->tree[i].nodes[0].total[a];
+        }
+        double mean = count ? total / count : 0;
+        if (count > best_count || (count == best_count && mean > best_mean)) {
+            best = a;
+            best_count = count;
+            best_mean = mean;
+        }
+    }
+    for (int i = 0; i < p->threads; i++) p->ticks += p->tree[i].ticks;
+    p->decisions++;
+    p->ns += TraceWallNs() - start;
+    return PLAN_KEYS[best];
+}
+
+// Keys of the birds from first on, decided by the bot every BOT_REACTION_FRAMES, or by the
+// session's planner every PLAN_HOLD frames
+void BotKeys(GAME_SESSION* gs , int keys[] , int first , int dt)
+{
+    for (int i = first; i < gs->flock.count; i++) {
+        BIRD* b = gs->flock.bird[i];
+        if (gs->planner) {
+            keys[i] = (gs->frame % PLAN_HOLD < dt && BirdAlive(b)) ? PlannerKey(gs->planner, gs, i) : NOKEY;
+            continue;
+        }
+        keys[i] = (gs->frame % BOT_REACTION_FRAMES < dt && BirdAlive(b)) ?
+                  BotKey(b, gs->taxi, gs->star, gs->hunter, &gs->config) : NOKEY;
+    }
+}
+
+// Plays one full game from seed on a headless session with the reference bot, dt frames
+// per tick. Also records how long the restart took, up to the end of the first frame.
+// Returns the MainLoop result: 1 lost, 2 won.
+int RunHeadlessGame(GAME_SESSION* gs, unsigned int seed, int dt)
+{
+    uint64_t start = TraceWallNs();
+    SessionReset(gs, seed);
+    long first_frame_allocs = -1;
+    int keys[MAX_BIRDS];
+    int result;
+    do {
+        PerfStartTick();
+        BotKeys(gs, keys, 0, dt);
+        PerfPhase(PHASE_INPUT);
+        result = SessionTick(gs, keys, dt);
+        if (first_frame_allocs < 0) {
+            first_frame_allocs = alloc_count;
+            gs->restart_ns = TraceWallNs() - start;
+        }
+    } while (result == GAME_RUNNING);
+    gs->frame_allocs = alloc_count - first_frame_allocs;
+    return result;
+}
+
+// Calibration searches one level at a time. Every candidate is played as a whole game
+// at that level's settings, so its win rate can be compared directly with the target.
+#define CALIBRATE_SAMPLES      48   // Latin hypercube samples per level
+#define CALIBRATE_GAMES        64   // games per candidate in the sweep
+#define CALIBRATE_REFINE_STEPS 6    // rounds of local refinement
+#define CALIBRATE_DT           5    // frames per simulated tick, see SweptHunterHitsBox
+
+typedef struct{
+    const GameConfig* config;
+    const LEVEL* candidates;
+    int num_candidates;
+    int games;
+    unsigned int seed;
+    atomic_int next_job;
+    atomic_int* wins;
+} CALIBRATION_BATCH;
+
+void* CalibrationWorker(void* arg)
+{
+    CALIBRATION_BATCH* batch = (CALIBRATION_BATCH*)arg;
+    int total = batch->num_candidates * batch->games;
+    int job;
+    const GameConfig* base = batch->config;
+    WIN playwin = { NULL, OFFX, OFFY, base->screen_height, base->screen_width, PLAY_COLOR, NULL };
+    DIFFICULTY_TABLE table = DEFAULT_DIFFICULTY;   // filled in for each candidate
+    GAME_SESSION* gs = SessionCreate(base, &table, &playwin, NULL);
+    if (!gs) return NULL;
+    while ((job = atomic_fetch_add(&batch->next_job, 1)) < total) {
+        int c = job / batch->games;
+        for (int i = 0; i < NUM_LEVELS; i++) table.level[i] = batch->candidates[c];
+        gs->base = *base;
+        ApplyLevel(&gs->base, &batch->candidates[c], base->curr_level);
+        // same seeds for every candidate so they are compared on the same games
+        if (RunHeadlessGame(gs, batch->seed + job % batch->games, CALIBRATE_DT) == 2) {
+            atomic_fetch_add(&batch->wins[c], 1);
+        }
+    }
+    SessionDestroy(gs);
+    return NULL;
+}
+
+// Plays games x candidates headless games spread over all cores and fills win_rate
+void EvaluateCandidates(const GameConfig* config, const LEVEL* candidates, int n, int games, unsigned int seed, double* win_rate, int threads)
+{
+    CALIBRATION_BATCH batch;
+    batch.config = config;
+    batch.candidates = candidates;
+    batch.num_candidates = n;
+    batch.games = games;
+    batch.seed = seed;
+    atomic_init(&batch.next_job, 0);
+    batch.wins = (atomic_int*)malloc(n * sizeof(atomic_int));
+    for (int i = 0; i < n; i++) atomic_init(&batch.wins[i], 0);
+
+    pthread_t* workers = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) pthread_create(&workers[i], NULL, CalibrationWorker, &batch);
+    for (int i = 0; i < threads; i++) pthread_join(workers[i], NULL);
+
+    for (int i = 0; i < n; i++) win_rate[i] = atomic_load(&batch.wins[i]) / (double)games;
+    free(workers);
+    free(batch.wins);
+}
+
+// Search space of every LEVEL field: lowest value, highest value and refinement step
+static const double CALIBRATE_MIN[4]  = { 1, 0, 1, 0.4 };
+static const double CALIBRATE_MAX[4]  = { 120, 12, MAX_HUNTERS, 3.0 };
+static const double CALIBRATE_STEP[4] = { 16, 2, 1, 0.2 };
+
+void SetLevelParam(LEVEL* l, int dim, double value)
+{
+    if (value < CALIBRATE_MIN[dim]) value = CALIBRATE_MIN[dim];
+    if (value > CALIBRATE_MAX[dim]) value = CALIBRATE_MAX[dim];
+    if (dim == 0) l->hunter_spawn_rate = (int)lround(value);
+    else if (dim == 1) l->hunter_bounces = (int)lround(value);
+    else if (dim == 2) l->hunter_num = (int)lround(value);
+    else l->hunter_speed = value;
+}
+
+double GetLevelParam(const LEVEL* l, int dim)
+{
+    if (dim == 0) return l->hunter_spawn_rate;
+    if (dim == 1) return l->hunter_bounces;
+    if (dim == 2) return l->hunter_num;
+    return l->hunter_speed;
+}
+
+LEVEL CalibrateLevel(const GameConfig* config, int level, double target, int samples, int games, int threads)
+{
+    GameConfig level_config = *config;
+    level_config.curr_level = level;
+    LEVEL* cands = (LEVEL*)malloc((samples > 9 ? samples : 9) * sizeof(LEVEL));
+    double* rate = (double*)malloc((samples > 9 ? samples : 9) * sizeof(double));
+    int* perm = (int*)malloc(samples * sizeof(int));
+
+    // Latin hypercube: every dimension is cut into `samples` strata and each stratum is used once
+    for (int dim = 0; dim < 4; dim++) {
+        for (int i = 0; i < samples; i++) perm[i] = i;
+        for (int i = samples - 1; i > 0; i--) {
+            int j = GameRand() % (i + 1);
+            int tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp;
+        }
+        for (int i = 0; i < samples; i++) {
+            double u = (perm[i] + GameRand() / 32768.0) / samples;
+            SetLevelParam(&cands[i], dim, CALIBRATE_MIN[dim] + u * (CALIBRATE_MAX[dim] - CALIBRATE_MIN[dim]));
+        }
+    }
+    EvaluateCandidates(&level_config, cands, samples, games, config->seed, rate, threads);
+    int best = 0;
+    for (int i = 1; i < samples; i++) {
+        if (fabs(rate[i] - target) < fabs(rate[best] - target)) best = i;
+    }
+    LEVEL current = cands[best];
+    double current_rate = rate[best];
+    printf("  level %d sweep: best win rate %.2f (target %.2f)\n", level, current_rate, target);
+
+    // Local refinement around the best sample with twice the games, halving the step when stuck
+    double step[4];
+    for (int dim = 0; dim < 4; dim++) step[dim] = CALIBRATE_STEP[dim];
+    for (int round = 0; round < CALIBRATE_REFINE_STEPS; round++) {
+        int n = 0;
+        cands[n++] = current;
+        for (int dim = 0; dim < 4; dim++) {
+            cands[n] = current;
+            SetLevelParam(&cands[n++], dim, GetLevelParam(&current, dim) + step[dim]);
+            cands[n] = current;
+            SetLevelParam(&cands[n++], dim, GetLevelParam(&current, dim) - step[dim]);
+        }
+        EvaluateCandidates(&level_config, cands, n, games * 2, config->seed + 7919 * (round + 1), rate, threads);
+        best = 0;
+        for (int i = 1; i < n; i++) {
+            if (fabs(rate[i] - target) < fabs(rate[best] - target)) best = i;
+        }
+        if (best == 0) {
+            for (int dim = 0; dim < 4; dim++) {
+                step[dim] /= 2;
+                if (dim < 3 && step[dim] < 1) step[dim] = 1;
+            }
+        }
+        current = cands[best];
+        current_rate = rate[best];
+        printf("  level %d round %d: win rate %.2f\n", level, round + 1, current_rate);
+    }
+    free(cands);
+    free(rate);
+    free(perm);
+    return current;
+}
+
+// ./game --calibrate [samples] [games] [target1 target2 target3 target4]
+int RunCalibration(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    int samples = argc > 2 ? atoi(argv[2]) : CALIBRATE_SAMPLES;
+    int games = argc > 3 ? atoi(argv[3]) : CALIBRATE_GAMES;
+    double target[NUM_LEVELS] = { 0.9, 0.7, 0.5, 0.3 };
+    for (int i = 0; i < NUM_LEVELS && 4 + i < argc; i++) target[i] = atof(argv[4 + i]);
+    if (samples < 1 || games < 1) {
+        fprintf(stderr, "Error: samples and games must be positive\n");
+        return EXIT_FAILURE;
+    }
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+
+    GameSeed(config.seed);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    DIFFICULTY_TABLE table;
+    printf("Calibrating %d levels on %d threads (%d samples, %d games each)\n", NUM_LEVELS, threads, samples, games);
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        table.level[i] = CalibrateLevel(&config, i + 1, target[i], samples, games, threads);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    long total_games = (long)NUM_LEVELS * (samples * games + CALIBRATE_REFINE_STEPS * 9 * games * 2);
+    printf("%ld games in %.1f s (%.0f games/s)\n", total_games, seconds, total_games / seconds);
+
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        LEVEL* l = &table.level[i];
+        printf("LEVEL %d  spawn rate %3d  bounces %2d  hunters %d  speed %.2f\n",
+               i + 1, l->hunter_spawn_rate, l->hunter_bounces, l->hunter_num, l->hunter_speed);
+    }
+    if (!SaveDifficulty(DIFFICULTY_FILE, &table)) {
+        fprintf(stderr, "Error: Could not write %s\n", DIFFICULTY_FILE);
+        return EXIT_FAILURE;
+    }
+    printf("Written to %s\n", DIFFICULTY_FILE);
+    return EXIT_SUCCESS;
+}
+
+
+// Stress scene for the job system: thousands of hunters and stars around one bird.
+// Every thread count must end in exactly the same state as the serial update.
+#define STRESS_HUNTERS 20000
+#define STRESS_STARS   20000
+#define STRESS_TICKS   200
+
+// FNV-1a over everything the update phase writes
+uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t HashScene(BIRD* b, HUNTER* h[], int hunters, STAR* s[], int stars)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    hash = HashBytes(hash, &b->life, sizeof(b->life));
+    hash = HashBytes(hash, &b->score, sizeof(b->score));
+    for (int i = 0; i < hunters; i++) {
+        hash = HashBytes(hash, &h[i]->x, sizeof(double) * 4);
+        hash = HashBytes(hash, &h[i]->bounces, sizeof(int));
+        hash = HashBytes(hash, &h[i]->active, sizeof(int) * 2);
+    }
+    for (int i = 0; i < stars; i++) {
+        hash = HashBytes(hash, &s[i]->x, sizeof(int) * 2);
+        hash = HashBytes(hash, &s[i]->interval, sizeof(int) * 2);
+    }
+    return hash;
+}
+
+// The headless board of the benches: config's birds, which no hit can kill, on its map
+// with their flow field, and the taxi. Each bench adds its own hunters, stars or rain.
+typedef struct{
+    WIN playwin;
+    FLOCK* flock;
+    TAXI* taxi;
+} BENCH_SCENE;
+
+void BenchSceneFree(BENCH_SCENE* scene)
+{
+    FLOCK* flock = scene->flock;
+    if (flock) {
+        for (int i = 0; i < flock->count; i++) free(flock->bird[i]);
+        free(flock->flow);
+        free(flock);
+    }
+    free(scene->taxi);
+    scene->flock = NULL;
+    scene->taxi = NULL;
+}
+
+// Seeds the game from config and sets the board up, 0 if memory runs out
+int BenchSceneCreate(BENCH_SCENE* scene, GameConfig* config)
+{
+    GameSeed(config->seed);
+    scene->playwin = (WIN){ NULL, OFFX, OFFY, config->screen_height, config->screen_width, PLAY_COLOR, config->map };
+    scene->taxi = NULL;
+    scene->flock = (FLOCK*)calloc(1, sizeof(FLOCK));
+    if (!scene->flock) return 0;
+    for (int i = 0; i < config->birds; i++) {
+        scene->flock->bird[i] = (BIRD*)malloc(sizeof(BIRD));
+        if (!scene->flock->bird[i]) {
+            scene->flock->count = i;
+            BenchSceneFree(scene);
+            return 0;
+        }
+    }
+    ResetFlock(scene->flock, config->birds, &scene->playwin, config);
+    for (int i = 0; i < config->birds; i++) {
+        scene->flock->bird[i]->life = INT32_MAX;  // the scene keeps going however often the birds are hit
+    }
+    if (config->map) {
+        size_t size = FlowFieldSize(scene->playwin.cols, scene->playwin.rows);
+        scene->flock->flow = InitFlowField(malloc(size), &scene->playwin, config);
+    }
+    scene->taxi = InitTaxi(&scene->playwin, config);
+    if (!scene->taxi || (config->map && !scene->flock->flow)) {
+        BenchSceneFree(scene);
+        return 0;
+    }
+    return 1;
+}
+
+// Moves every bird one tick. Every 25 ticks each one turns a quarter, the birds out of step.
+void BenchSceneFly(BENCH_SCENE* scene, GameConfig* config, int tick)
+{
+    static const int turns[4] = { UP, LEFT, DOWN, RIGHT };
+    FLOCK* flock = scene->flock;
+    for (int i = 0; i < flock->count; i++) {
+        BIRD* bird = flock->bird[i];
+        if (tick % 25 == 0) SteerBird(bird, NULL, config, turns[(tick / 25 + i) % 4]);
+        config->kernel->move_bird(bird, 1);
+    }
+}
+
+// Runs the stress scene, returns seconds per tick and the final state hash
+double RunStressScene(const GameConfig* base, int hunters, int stars, int ticks, uint64_t* hash)
+{
+    GameConfig config = *base;
+    config.hunter_num = hunters;
+    BENCH_SCENE scene;
+    if (!BenchSceneCreate(&scene, &config)) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    WIN playwin = scene.playwin;
+    FLOCK* flock = scene.flock;
+    TAXI* t = scene.taxi;
+    BIRD* b = flock->bird[0];
+    HUNTER** h = (HUNTER**)malloc(hunters * sizeof(HUNTER*));
+    STAR** s = (STAR**)malloc(stars * sizeof(STAR*));
+    for (int i = 0; i < hunters; i++) {
+        h[i] = InitHunter(i, &playwin, flock, &config);
+    }
+    for (int i = 0; i < stars; i++) {
+        s[i] = InitStar(i, &playwin);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int tick = 0; tick < ticks; tick++) {
+        PerfStartTick();
+        BenchSceneFly(&scene, &config, tick);
+        IndexFlock(flock, 1);
+        PerfPhase(PHASE_BIRD);
+        MoveMultipleStar(s, stars, flock, &config, 1);
+        PerfPhase(PHASE_STARS);
+        if (flock->flow) UpdateFlowField(flock->flow, flock, h, hunters);
+        MoveMultipleHunter(h, flock, t, &playwin, &config, 1);
+        PerfPhase(PHASE_HUNTERS);
+        flock->tick++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *hash = HashScene(b, h, hunters, s, stars);
+
+    for (int i = 0; i < hunters; i++) free(h[i]);
+    for (int i = 0; i < stars; i++) free(s[i]);
+    free(h);
+    free(s);
+    BenchSceneFree(&scene);
+    FreeHunterGrid();
+    return ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9) / ticks;
+}
+
+// ./game --stress [hunters] [stars] [ticks] [max threads]
+int RunStress(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    int hunters = argc > 2 ? atoi(argv[2]) : STRESS_HUNTERS;
+    int stars = argc > 3 ? atoi(argv[3]) : STRESS_STARS;
+    int ticks = argc > 4 ? atoi(argv[4]) : STRESS_TICKS;
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 5 ? atoi(argv[5]) : cores;
+    if (hunters < 0 || stars < 0 || ticks < 1 || max_threads < 1) {
+        fprintf(stderr, "Error: counts must be positive\n");
+        return EXIT_FAILURE;
+    }
+    int max_chunks = ((hunters > stars ? hunters : stars) + ENTITY_CHUNK - 1) / ENTITY_CHUNK;
+    uint64_t serial_hash;
+    PERF counters;
+    PerfOpen(&counters);
+    phase_perf = &counters;   // only the serial run, the counters cannot see the job workers
+    double serial = RunStressScene(&config, hunters, stars, ticks, &serial_hash);
+    phase_perf = NULL;
+    PerfClose(&counters);
+    printf("%d hunters, %d stars, %d birds, %d ticks, cores online: %d\n", hunters, stars, config.birds, ticks, cores);
+    printf("threads   ms/tick  speedup  state\n");
+    printf(" serial  %8.3f     1.00  %016llx\n", serial * 1000, (unsigned long long)serial_hash);
+    int failed = 0;
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+        uint64_t hash;
+        entity_jobs = JobsCreate(threads, max_chunks > 0 ? max_chunks : 1);
+        if (!entity_jobs) {
+            fprintf(stderr, "Error: Could not start %d worker threads\n", threads);
+            failed = 1;
+            break;
+        }
+        double tick = RunStressScene(&config, hunters, stars, ticks, &hash);
+        JobsDestroy(entity_jobs);
+        entity_jobs = NULL;
+        printf("%7d  %8.3f  %7.2f  %016llx %s\n", threads, tick * 1000, serial / tick,
+               (unsigned long long)hash, hash == serial_hash ? "identical" : "DIFFERENT");
+        if (hash != serial_hash) failed = 1;
+        if (threads == max_threads) break;
+    }
+    // more threads than cores take turns, those runs only show the state does not change
+    if (max_threads > cores) printf("runs with more than %d thread(s) share the cores, their speedup says nothing\n", cores);
+    printf("\nSerial run:\n");
+    PerfReport(&counters, stdout);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// ./game --boids [max hunters] [ticks]
+// HUNTER_FLOCKING's cell list against every hunter looking at every other one, for 1/16 up to
+// all of max hunters. The board grows with the hunters so they stay as crowded.
+#define BOIDS_HUNTERS 20000
+#define BOIDS_TICKS   100
+#define BOIDS_AREA    24        // board cells per hunter
+#define BOIDS_REPEAT  3         // steering passes timed, the fastest counts
+
+// Hunters the cell list makes one hunter look at, added up over all of them
+static long BoidCandidates(const HUNTER_GRID* g)
+{
+    long total = 0;
+    for (int cy = 0; cy < g->rows; cy++) {
+        for (int cx = 0; cx < g->cols; cx++) {
+            int c = cy * g->cols + cx;
+            long near = 0;
+            for (int y = cy > 0 ? cy - 1 : 0; y <= cy + 1 && y < g->rows; y++) {
+                int x0 = cx > 0 ? cx - 1 : 0, x1 = cx + 1 < g->cols ? cx + 1 : cx;
+                near += g->start[y * g->cols + x1 + 1] - g->start[y * g->cols + x0];
+            }
+            total += near * (g->start[c + 1] - g->start[c]);
+        }
+    }
+    return total;
+}
+
+// Steers every active hunter from the same start, through the cell list or naively.
+// Returns the microseconds the fastest of BOIDS_REPEAT passes took, the headings are left in dir.
+// -1 if the cell list could not be built.
+static double SteerBoids(HUNTER** h , int n , const WIN* w , const double* start , double* dir , int naive)
+{
+    double best = 0;
+    for (int r = 0; r < BOIDS_REPEAT; r++) {
+        for (int i = 0; i < n; i++) {
+            h[i]->dx = start[2 * i];
+            h[i]->dy = start[2 * i + 1];
+        }
+        uint64_t t0 = TraceWallNs();
+        const HUNTER_GRID* g = BuildHunterGrid(h, n, w);
+        if (!g) return -1;
+        for (int i = 0; i < n; i++) {
+            if (!h[i]->active) continue;
+            if (naive) FlockHunterNaive(h[i], g->boid, g->count, 1);
+            else FlockHunter(h[i], g, 1);
+        }
+        double us = (TraceWallNs() - t0) / 1e3;
+        if (r == 0 || us < best) best = us;
+    }
+    for (int i = 0; i < n; i++) {
+        dir[2 * i] = h[i]->dx;
+        dir[2 * i + 1] = h[i]->dy;
+    }
+    return best;
+}
+
+int RunBoidsBench(int argc, char* argv[])
+{
+    GameConfig base;
+    if (!LoadConfig("config.txt", &base)) return EXIT_FAILURE;
+    int max_hunters = argc > 2 ? atoi(argv[2]) : BOIDS_HUNTERS;
+    int ticks = argc > 3 ? atoi(argv[3]) : BOIDS_TICKS;
+    if (max_hunters < 16 || ticks < 1) {
+        fprintf(stderr, "Error: at least 16 hunters and 1 tick\n");
+        return EXIT_FAILURE;
+    }
+    printf("%d ticks of flocking hunters, then the steering of the last one timed both ways\n", ticks);
+    printf("hunters      board  tick us  list us  naive us  speedup  looked at  list ns/look  headings\n");
+    int failed = 0;
+    for (int n = max_hunters / 16; n <= max_hunters; n = n * 2 > max_hunters && n < max_hunters ? max_hunters : n * 2) {
+        GameConfig config = base;
+        config.hunter_num = n;
+        config.hunter_flocking = 1;
+        config.hunter_bounces = 1 << 20;     // nobody leaves the board
+        config.birds = 1;
+        config.map = NULL;
+        config.screen_width = (int)sqrt(2.0 * n * BOIDS_AREA);
+        config.screen_height = config.screen_width / 2;
+        if (config.screen_width < 40) config.screen_width = 40;
+        if (config.screen_height < 20) config.screen_height = 20;
+        config.kernel = SelectKernel(&config);
+        BENCH_SCENE scene;
+        if (!BenchSceneCreate(&scene, &config)) {
+            fprintf(stderr, "Error: Out of memory\n");
+            return EXIT_FAILURE;
+        }
+        WIN playwin = scene.playwin;
+        FLOCK* flock = scene.flock;
+        TAXI* t = scene.taxi;
+        HUNTER** h = (HUNTER**)malloc(n * sizeof(HUNTER*));
+        for (int i = 0; i < n; i++) h[i] = InitHunter(i, &playwin, flock, &config);
+        uint64_t t0 = TraceWallNs();
+        for (int tick = 0; tick < ticks; tick++) {
+            BenchSceneFly(&scene, &config, tick);
+            IndexFlock(flock, 1);
+            MoveMultipleHunter(h, flock, t, &playwin, &config, 1);
+            flock->tick++;
+        }
+        double tick_us = (TraceWallNs() - t0) / 1e3 / ticks;
+
+        double* start = (double*)malloc(6 * n * sizeof(double));
+        double* list = start + 2 * n, *naive = start + 4 * n;
+        for (int i = 0; i < n; i++) {
+            start[2 * i] = h[i]->dx;
+            start[2 * i + 1] = h[i]->dy;
+        }
+        double list_us = SteerBoids(h, n, &playwin, start, list, 0);
+        double naive_us = SteerBoids(h, n, &playwin, start, naive, 1);
+        const HUNTER_GRID* g = list_us < 0 || naive_us < 0 ? NULL : BuildHunterGrid(h, n, &playwin);
+        if (!g) {
+            fprintf(stderr, "Error: Out of memory for the cell list of %d hunters\n", n);
+            failed = 1;
+        } else {
+            double looked = g->count ? (double)BoidCandidates(g) / g->count : 0;
+            int same = memcmp(list, naive, 2 * n * sizeof(double)) == 0;
+            if (!same) failed = 1;
+            printf("%7d  %4dx%-4d %8.1f %8.1f  %8.1f  %7.1f  %9.1f  %12.2f  %s\n", n, config.screen_width, config.screen_height,
+                   tick_us, list_us, naive_us, naive_us / list_us, looked,
+                   g->count ? list_us * 1e3 / (looked * g->count) : 0.0, same ? "identical" : "DIFFERENT");
+        }
+        free(start);
+        for (int i = 0; i < n; i++) free(h[i]);
+        free(h);
+        BenchSceneFree(&scene);
+    }
+    FreeHunterGrid();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// ./game --heat-merge <out> <files...>
+// Sums every heatmap record of the files into one record of out, on all cores. out may be
+// one of the files, it is replaced once the sum is written.
+int RunHeatMerge(int argc, char* argv[])
+{
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s --heat-merge <out> <files...>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    HEAT_TOTAL t;
+    uint64_t start = TraceWallNs();
+    if (!HeatLoad(argv + 3, argc - 3, threads, &t)) {
+        fprintf(stderr, "Error: no heatmap to merge\n");
+        return EXIT_FAILURE;
+    }
+    double seconds = (TraceWallNs() - start) / 1e9;
+    char tmp[MAX_MAP_PATH + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", argv[2]);
+    unlink(tmp);
+    int ok = HeatAppend(tmp, t.cols, t.rows, t.games, t.ticks, t.count) && rename(tmp, argv[2]) == 0;
+    if (ok) {
+        printf("%llu games (%llu ticks) on a %dx%d board summed in %.2f s on %d threads into %s\n",
+               (unsigned long long)t.games, (unsigned long long)t.ticks, t.cols, t.rows, seconds, threads, argv[2]);
+    } else {
+        fprintf(stderr, "Error: Could not write %s\n", argv[2]);
+    }
+    free(t.count);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ./game --heat-show [file] [layer] [width]
+// Draws the sum of every record of file (HEATMAP_FILE) as text: one layer (bird, damage,
+// stars or hunters) or all of them, at most width columns wide (the board's width).
+int RunHeatShow(int argc, char* argv[])
+{
+    char* file = argc > 2 ? argv[2] : (char*)HEATMAP_FILE;
+    int layer = -1;
+    if (argc > 3 && strcmp(argv[3], "all") != 0) {
+        for (int i = 0; i < HEAT_LAYERS; i++) if (strcmp(argv[3], HEAT_NAMES[i]) == 0) layer = i;
+        if (layer < 0) {
+            fprintf(stderr, "Error: the layers are bird, damage, stars and hunters\n");
+            return EXIT_FAILURE;
+        }
+    }
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    HEAT_TOTAL t;
+    if (!HeatLoad(&file, 1, threads < 1 ? 1 : threads, &t)) {
+        fprintf(stderr, "Error: no heatmap to show in %s\n", file);
+        return EXIT_FAILURE;
+    }
+    int width = argc > 4 ? atoi(argv[4]) : t.cols;
+    if (width < 1) width = t.cols;
+    printf("%llu games, %llu ticks, %dx%d board\n", (unsigned long long)t.games, (unsigned long long)t.ticks,
+           t.cols, t.rows);
+    for (int i = 0; i < HEAT_LAYERS; i++) {
+        if (layer < 0 || layer == i) HeatRender(&t, i, width, stdout);
+    }
+    free(t.count);
+    return EXIT_SUCCESS;
+}
+
+// ./game --tick-hash <out> [seed] [dt]
+// Plays one game with the reference bot, hashes every tick into a history for --tick-diff,
+// and times the hashing against the ticks themselves. The ticks draw to a screen nobody
+// sees (a terminal on /dev/null), as a game's ticks draw to the terminal, so the share is
+// of a tick as it is played. Without a terminal description for $TERM the game is headless.
+int RunTickHash(int argc, char* argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s --tick-hash <out> [seed] [dt]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    DIFFICULTY_TABLE table;
+    LoadDifficulty(DIFFICULTY_FILE, &table);
+    unsigned int seed = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : (unsigned int)config.seed;
+    int dt = argc > 4 ? atoi(argv[4]) : 1;
+    if (dt < 1 || dt > MAX_DT) {
+        fprintf(stderr, "Error: dt must be between 1 and %d\n", MAX_DT);
+        return EXIT_FAILURE;
+    }
+    FILE* null_out = fopen("/dev/null", "w");
+    FILE* null_in = fopen("/dev/null", "r");
+    SCREEN* screen = null_out && null_in ? newterm(NULL, null_out, null_in) : NULL;
+    WIN headless = { NULL, OFFX, OFFY, config.screen_height, config.screen_width, PLAY_COLOR, NULL };
+    WIN* playwin = &headless;
+    WIN* statwin = NULL;
+    if (screen) {
+        resizeterm(config.screen_height + STAT_HEIGHT + OFFY + 1, config.screen_width + OFFX + 1);
+        playwin = InitWin(stdscr, config.screen_height, config.screen_width, OFFY, OFFX, PLAY_COLOR, BORDER, 0);
+        statwin = InitWin(stdscr, STAT_HEIGHT, config.screen_width, config.screen_height + OFFY, OFFX, STAT_COLOR, BORDER, 0);
+    }
+    GAME_SESSION* gs = SessionCreate(&config, &table, playwin, statwin);
+    if (gs) SessionReset(gs, seed);
+    // the timer runs out after this many ticks at the latest
+    TICK_HISTORY* t = gs ? TickHistoryCreate((long)(gs->max_time * 1000 / FRAME_TIME) / dt + 2) : NULL;
+    int ok = t != NULL;
+    int result = GAME_RUNNING;
+    uint64_t tick_cycles = 0, hash_cycles = 0, clock_cycles = UINT64_MAX;
+    if (ok) {
+        TickHistoryReset(t);
+        // what reading the clock twice costs, taken off every hashing time
+        for (int i = 0; i < 1000; i++) {
+            uint64_t start = TraceClock();
+            uint64_t end = TraceClock();
+            if (end - start < clock_cycles) clock_cycles = end - start;
+        }
+        int keys[MAX_BIRDS];
+        do {
+            uint64_t start = TraceClock();
+            BotKeys(gs, keys, 0, dt);
+            result = SessionTick(gs, keys, dt);
+            if (statwin) {
+                ShowStatus(statwin, &gs->flock, &gs->config);
+                wrefresh(playwin->window);
+            }
+            uint64_t ticked = TraceClock();
+            TickHistoryRecord(t, gs);
+            uint64_t hashed = TraceClock();
+            tick_cycles += ticked - start;
+            hash_cycles += hashed - ticked > clock_cycles ? hashed - ticked - clock_cycles : 0;
+        } while (result == GAME_RUNNING);
+    }
+    if (screen) {
+        endwin();
+        delwin(playwin->window);
+        delwin(statwin->window);
+        free(playwin);
+        free(statwin);
+        delscreen(screen);
+    }
+    if (null_out) fclose(null_out);
+    if (null_in) fclose(null_in);
+    if (!ok) {
+        fprintf(stderr, "Error: Out of memory\n");
+        SessionDestroy(gs);
+        return EXIT_FAILURE;
+    }
+    ok = TickHistorySave(t, argv[2], seed, dt);
+    if (ok) {
+        printf("%ld ticks (seed %u, dt %d, %s) written to %s\n", t->ticks, seed, dt,
+               result == 2 ? "won" : result == 1 ? "lost" : "quit", argv[2]);
+        printf("hashing: %.0f cycles per tick, %.2f%% of the %.0f cycles of a %s tick\n", (double)hash_cycles / t->ticks,
+               100.0 * hash_cycles / tick_cycles, (double)tick_cycles / t->ticks, screen ? "drawn" : "headless");
+        if (t->full) printf("the game went on after the history was full, only its first %ld ticks are in it\n", t->ticks);
+    } else {
+        fprintf(stderr, "Error: Could not write %s\n", argv[2]);
+    }
+    TickHistoryFree(t);
+    SessionDestroy(gs);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+typedef struct{
+    TICK_FILE h;
+    const uint64_t* leaf;           // [ticks][TICK_ENTITIES]
+    const uint64_t* level[64];
+    uint64_t count[64];             // nodes on each level
+    void* map;
+    size_t size;
+} TICK_RUN;
+
+// Maps a --tick-hash history, 0 with a message if it is not one of this build's layout
+static int TickOpen(const char* file , TICK_RUN* r)
+{
+    memset(r, 0, sizeof(*r));
+    int fd = open(file, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TICK_FILE)) {
+        fprintf(stderr, "Error: Could not read %s\n", file);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return 0;
+    r->map = p;
+    r->size = st.st_size;
+    memcpy(&r->h, p, sizeof(r->h));
+    uint64_t words = (r->size - sizeof(TICK_FILE)) / sizeof(uint64_t);
+    uint64_t need = r->h.ticks * TICK_ENTITIES;
+    int ok = r->h.magic == TICK_MAGIC && r->h.version == TICK_VERSION && r->h.entities == TICK_ENTITIES &&
+             r->h.levels >= 1 && r->h.levels < 64 && r->h.ticks <= words / TICK_ENTITIES;
+    const uint64_t* at = (const uint64_t*)((const char*)p + sizeof(TICK_FILE));
+    r->leaf = at;
+    for (uint64_t l = 0, n = r->h.ticks; ok && l < r->h.levels; l++, n = (n + 1) / 2) {
+        r->level[l] = at + need;
+        r->count[l] = n;
+        need += n ? n : 1;
+        ok = need <= words;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: %s is not a tick history of this build\n", file);
+        munmap(p, r->size);
+        return 0;
+    }
+    return 1;
+}
+
+// Node i of a level, also above the run's root (the root, or empty) and past its end (empty)
+static uint64_t TickNode(const TICK_RUN* r , int level , uint64_t i)
+{
+    if (level >= (int)r->h.levels) return i == 0 ? r->level[r->h.levels - 1][0] : 0;
+    return i < r->count[level] ? r->level[level][i] : 0;
+}
+
+// ./game --tick-diff <a> <b>
+// Goes down both trees from the root to the first tick where the histories differ, one
+// comparison per level, then names the entities that differ in it. Exits with 1 if they do.
+int RunTickDiff(int argc, char* argv[])
+{
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s --tick-diff <a> <b>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    TICK_RUN a, b;
+    if (!TickOpen(argv[2], &a)) return EXIT_FAILURE;
+    if (!TickOpen(argv[3], &b)) return EXIT_FAILURE;
+    if (a.h.seed != b.h.seed || a.h.dt != b.h.dt) {
+        printf("note: %s played seed %u at dt %d, %s seed %u at dt %d\n", argv[2], a.h.seed, a.h.dt,
+               argv[3], b.h.seed, b.h.dt);
+    }
+    int top = (int)(a.h.levels > b.h.levels ? a.h.levels : b.h.levels) - 1;
+    int compared = 1;
+    int same = TickNode(&a, top, 0) == TickNode(&b, top, 0);
+    uint64_t tick = 0;
+    for (int level = top; !same && level > 0; level--) {
+        compared++;
+        tick = TickNode(&a, level - 1, 2 * tick) != TickNode(&b, level - 1, 2 * tick) ? 2 * tick : 2 * tick + 1;
+    }
+    int status = EXIT_SUCCESS;
+    if (same) {
+        printf("identical: %llu ticks, 1 comparison\n", (unsigned long long)a.h.ticks);
+    } else if (tick >= a.h.ticks || tick >= b.h.ticks) {
+        const char* shorter = tick >= a.h.ticks ? argv[2] : argv[3];
+        printf("identical for %llu ticks, then %s ended and the other went on (%d comparisons)\n",
+               (unsigned long long)tick, shorter, compared);
+        status = 1;
+    } else {
+        printf("first difference at tick %llu (frame %llu), found in %d comparisons of %llu and %llu ticks\n",
+               (unsigned long long)tick, (unsigned long long)(tick + 1) * a.h.dt, compared,
+               (unsigned long long)a.h.ticks, (unsigned long long)b.h.ticks);
+        const uint64_t* ra = a.leaf + tick * TICK_ENTITIES;
+        const uint64_t* rb = b.leaf + tick * TICK_ENTITIES;
+        char name[64];
+        for (int i = 0; i < TICK_ENTITIES; i++) {
+            if (ra[i] == rb[i]) continue;
+            TickEntityName(i, name, sizeof(name));
+            printf("  %-44s %016llx %016llx\n", name, (unsigned long long)ra[i], (unsigned long long)rb[i]);
+        }
+        status = 1;
+    }
+    munmap(a.map, a.size);
+    munmap(b.map, b.size);
+    return status;
+}
+
+// ./game --autosave-check [seconds] [frames]
+// Plays a headless bot game, checkpoints it after seconds through the autosave writer and
+// plays on for frames frames. A second session then loads the checkpoint the way a restart
+// does and plays the same frames. Every tick of the two must hash the same.
+#define AUTOSAVE_CHECK_FILE    "autosave-check.bin"
+#define AUTOSAVE_CHECK_SECONDS 5
+#define AUTOSAVE_CHECK_FRAMES  1000
+
+// Up to frames frames of gs with the reference bot, hashed into t. Returns the game result.
+static int PlayHashed(GAME_SESSION* gs , TICK_HISTORY* t , int frames)
+{
+    int keys[MAX_BIRDS];
+    int result = GAME_RUNNING;
+    TickHistoryReset(t);
+    for (int f = 0; f < frames && result == GAME_RUNNING; f++) {
+        BotKeys(gs, keys, 0, 1);
+        result = SessionTick(gs, keys, 1);
+        TickHistoryRecord(t, gs);
+    }
+    return result;
+}
+
+int RunAutosaveCheck(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    DIFFICULTY_TABLE table;
+    LoadDifficulty(DIFFICULTY_FILE, &table);
+    int seconds = argc > 2 ? atoi(argv[2]) : AUTOSAVE_CHECK_SECONDS;
+    int frames = argc > 3 ? atoi(argv[3]) : AUTOSAVE_CHECK_FRAMES;
+    if (seconds < 1 || frames < 1) {
+        fprintf(stderr, "Error: seconds and frames must be positive\n");
+        return EXIT_FAILURE;
+    }
+    WIN playwin[2] = { { NULL, OFFX, OFFY, config.screen_height, config.screen_width, PLAY_COLOR, NULL },
+                       { NULL, OFFX, OFFY, config.screen_height, config.screen_width, PLAY_COLOR, NULL } };
+    GAME_SESSION* played = SessionCreate(&config, &table, &playwin[0], NULL);
+    GAME_SESSION* resumed = SessionCreate(&config, &table, &playwin[1], NULL);
+    TICK_HISTORY* a = TickHistoryCreate(frames);
+    TICK_HISTORY* b = TickHistoryCreate(frames);
+    if (!played || !resumed || !a || !b) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    SessionReset(played, config.seed);
+    if (!AutosaveStart(played, seconds, AUTOSAVE_CHECK_FILE)) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    unlink(AUTOSAVE_CHECK_FILE);
+
+    // the game as MainLoop plays it, up to the first checkpoint
+    long at = seconds * 1000L / FRAME_TIME;
+    int keys[MAX_BIRDS];
+    int result = GAME_RUNNING;
+    while (played->frame < at && result == GAME_RUNNING) {
+        BotKeys(played, keys, 0, 1);
+        result = SessionTick(played, keys, 1);
+        AutosaveTick(played);
+    }
+    AutosaveFlush();
+    int status = EXIT_FAILURE;
+    if (result != GAME_RUNNING) {
+        printf("the game ended at frame %ld, before the checkpoint at frame %ld\n", played->frame, at);
+    } else {
+        int end_a = PlayHashed(played, a, frames);
+        AUTOSAVE_SLOT* s = &autosaver.slot[0];
+        if (!AutosaveLoad(s, resumed)) {
+            printf("the checkpoint at frame %ld could not be loaded from %s\n", at, AUTOSAVE_CHECK_FILE);
+        } else {
+            AutosaveResume(resumed, s);
+            int end_b = PlayHashed(resumed, b, frames);
+            long tick = 0;
+            while (tick < a->ticks && tick < b->ticks && a->node[tick] == b->node[tick]) tick++;
+            if (tick == a->ticks && tick == b->ticks && end_a == end_b) {
+                printf("resume: identical to the uninterrupted game for %ld frames after the checkpoint at frame %ld%s\n",
+                       tick, at, end_a == GAME_RUNNING ? "" : ", to the end of the game");
+                status = EXIT_SUCCESS;
+            } else if (tick == a->ticks || tick == b->ticks) {
+                printf("resume: identical for %ld frames, then only the %s game went on\n", tick,
+                       tick == a->ticks ? "resumed" : "uninterrupted");
+            } else {
+                printf("resume: differs from the uninterrupted game at frame %ld (the checkpoint was at frame %ld)\n",
+                       at + tick + 1, at);
+                TickHistoryRows(a);
+                TickHistoryRows(b);
+                const uint64_t* ra = a->leaf + tick * TICK_ENTITIES;
+                const uint64_t* rb = b->leaf + tick * TICK_ENTITIES;
+                char name[64];
+                for (int i = 0; i < TICK_ENTITIES; i++) {
+                    if (ra[i] == rb[i]) continue;
+                    TickEntityName(i, name, sizeof(name));
+                    printf("  %-44s %016llx %016llx\n", name, (unsigned long long)ra[i], (unsigned long long)rb[i]);
+                }
+            }
+        }
+    }
+    AutosaveStop();
+    unlink(AUTOSAVE_CHECK_FILE);
+    TickHistoryFree(a);
+    TickHistoryFree(b);
+    SessionDestroy(played);
+    SessionDestroy(resumed);
+    return status;
+}
+
+// ./game --pack-make <file> [levels] [map files...]
+// Writes a campaign of levels levels for config.txt's board. Level i plays on map
+// i % maps (an open board without maps); through every ten levels the quota, the hunters
+// and their speed go up while the taxi bonus goes down, and odd ones drop stars in lanes.
+#define PACK_MAKE_LEVELS 100
+
+// Record of level i, into out (big enough for any record of the board). Returns its size.
+static size_t MakePackLevel(unsigned char* out , const GameConfig* config , int i , const MAP* map)
+{
+    int step = i % 10;
+    PACK_RECORD* r = (PACK_RECORD*)out;
+    memset(r, 0, sizeof(*r));
+    r->star_quota = config->star_quota + 2 * step;
+    r->time_limit = (uint32_t)(config->time_limit * 1000);
+    r->available_taxis = config->available_taxis + (step < 5);
+    r->taxi_bonus = BONUS_STARS - step;
+    for (int k = 0; k < NUM_LEVELS; k++) {
+        const LEVEL* l = &DEFAULT_DIFFICULTY.level[k];
+        r->stage[k].hunter_spawn_rate = l->hunter_spawn_rate > step ? l->hunter_spawn_rate - step : 1;
+        r->stage[k].hunter_bounces = l->hunter_bounces;
+        r->stage[k].hunter_num = l->hunter_num + step / 4 < MAX_HUNTERS ? l->hunter_num + step / 4 : MAX_HUNTERS;
+        double speed = l->hunter_speed > 0 ? l->hunter_speed : config->hunter_speed;
+        r->stage[k].hunter_speed = (uint16_t)lround(speed * (1 + 0.05 * step) * 1000);
+    }
+    uint16_t* lane = (uint16_t*)(r + 1);
+    if (step % 2) {
+        for (int x = 3; x < config->screen_width - 1; x += 6) lane[r->lanes++] = x;
+    }
+    PACK_RUN* run = (PACK_RUN*)(lane + r->lanes);
+    for (int y = 0; map && y < map->rows; y++) {
+        for (int x = 0; x < map->cols; x++) {
+            if (!map->solid[y * map->cols + x] || (x > 0 && map->solid[y * map->cols + x - 1])) continue;
+            int length = 1;
+            while (x + length < map->cols && map->solid[y * map->cols + x + length]) length++;
+            run[r->runs++] = (PACK_RUN){ y, x, length };
+        }
+    }
+    return sizeof(PACK_RECORD) + r->lanes * sizeof(uint16_t) + r->runs * sizeof(PACK_RUN);
+}
+
+// Returns 0 if the file cannot be written
+int WritePack(const char* filename , const GameConfig* config , int levels , MAP* const maps[] , int count)
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file) return 0;
+    int cols = config->screen_width, rows = config->screen_height;
+    size_t most = sizeof(PACK_RECORD) + cols * sizeof(uint16_t) + (size_t)(cols + 1) / 2 * rows * sizeof(PACK_RUN);
+    unsigned char* record = (unsigned char*)malloc(most);
+    PACK_ENTRY* index = (PACK_ENTRY*)malloc(levels * sizeof(PACK_ENTRY));
+    PACK_HEADER h = { PACK_MAGIC, PACK_VERSION, sizeof(PACK_HEADER), (uint32_t)levels, (uint16_t)cols, (uint16_t)rows, 0 };
+    int ok = record && index && fwrite(&h, sizeof(h), 1, file) == 1;
+    uint64_t offset = sizeof(h);
+    static const unsigned char pad[8] = { 0 };
+    for (int i = 0; ok && i < levels; i++) {
+        size_t size = MakePackLevel(record, config, i, count ? maps[i % count] : NULL);
+        index[i] = (PACK_ENTRY){ offset, (uint32_t)size, (uint32_t)crc32(0, record, size) };
+        size_t padded = (size + 7) & ~(size_t)7;    // records and the index start 8 byte aligned
+        ok = fwrite(record, size, 1, file) == 1 && fwrite(pad, padded - size, 1, file) == (padded > size);
+        offset += padded;
+    }
+    h.index = offset;
+    ok = ok && fwrite(index, sizeof(PACK_ENTRY), levels, file) == (size_t)levels;
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    free(record);
+    free(index);
+    return ok;
+}
+
+int RunPackMake(int argc, char* argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s --pack-make <file> [levels] [map files...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    int levels = argc > 3 ? atoi(argv[3]) : PACK_MAKE_LEVELS;
+    if (levels < 1) {
+        fprintf(stderr, "Error: a pack needs at least one level\n");
+        return EXIT_FAILURE;
+    }
+    int count = argc > 4 ? argc - 4 : 0;
+    MAP* maps[argc > 4 ? argc - 4 : 1];
+    for (int i = 0; i < count; i++) {
+        maps[i] = LoadMap(argv[4 + i], config.screen_width, config.screen_height);
+        if (!maps[i]) {
+            fprintf(stderr, "Error: Could not read map %s\n", argv[4 + i]);
+            return EXIT_FAILURE;
+        }
+    }
+    int ok = WritePack(argv[2], &config, levels, maps, count);
+    for (int i = 0; i < count; i++) FreeMap(maps[i]);
+    if (!ok) {
+        fprintf(stderr, "Error: Could not write %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    printf("%s: %d levels for the %dx%d board on %d maps\n", argv[2], levels, config.screen_width, config.screen_height, count);
+    return EXIT_SUCCESS;
+}
+
+// Resident memory of the process in KB, from /proc/self/statm
+static long ResidentKB(void)
+{
+    long pages = 0, resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    if (fscanf(file, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(file);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// ./game --pack-bench [levels] [map files...]
+// Writes a 10 level pack and a levels level one and, for each, times opening it, entering
+// a level never seen, entering the prefetched next level and entering one far away, and
+// how much the process grew. Neither should depend on the size of the pack.
+#define PACK_BENCH_LEVELS 100000
+
+int RunPackBench(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    int levels = argc > 2 ? atoi(argv[2]) : PACK_BENCH_LEVELS;
+    int count = argc > 3 ? argc - 3 : 0;
+    MAP* maps[argc > 3 ? argc - 3 : 1];
+    for (int i = 0; i < count; i++) {
+        maps[i] = LoadMap(argv[3 + i], config.screen_width, config.screen_height);
+        if (!maps[i]) {
+            fprintf(stderr, "Error: Could not read map %s\n", argv[3 + i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (levels < 10) levels = 10;
+    int sizes[2] = { 10, levels };
+    printf("pack levels    file KB   open us  first us  prefetched us  far us  RSS growth KB\n");
+    int failed = 0;
+    for (int k = 0; k < 2; k++) {
+        char name[] = "/tmp/swallow-pack-XXXXXX";
+        int fd = mkstemp(name);
+        if (fd < 0 || !WritePack(name, &config, sizes[k], maps, count)) {
+            fprintf(stderr, "Error: Could not write a pack in /tmp\n");
+            if (fd >= 0) close(fd);
+            return EXIT_FAILURE;
+        }
+        close(fd);
+        struct stat st;
+        stat(name, &st);
+        // the file was just written, drop it from the page cache so open pays for its reads
+        fd = open(name, O_RDONLY);
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+        long rss = ResidentKB();
+        uint64_t start = TraceWallNs();
+        LEVEL_PACK* p = OpenPack(name, config.screen_width, config.screen_height);
+        double open_us = (TraceWallNs() - start) / 1e3;
+        if (!p) return EXIT_FAILURE;
+        start = TraceWallNs();
+        const PACK_LEVEL* first = PackLevel(p, 1);
+        double first_us = (TraceWallNs() - start) / 1e3;
+        PackPrefetch(p, 2);
+        usleep(20000);      // a frame or so of play
+        start = TraceWallNs();
+        const PACK_LEVEL* next = PackLevel(p, 2);
+        double next_us = (TraceWallNs() - start) / 1e3;
+        start = TraceWallNs();
+        const PACK_LEVEL* far = PackLevel(p, sizes[k] - 1);
+        double far_us = (TraceWallNs() - start) / 1e3;
+        long grown = ResidentKB() - rss;
+        failed |= !first || !next || !far;
+        printf("%11d %10.0f %9.1f %9.1f %14.1f %7.1f %14ld   %ld decoded %ld prefetch hits\n", sizes[k],
+               st.st_size / 1e3, open_us, first_us, next_us, far_us, grown, p->decodes, p->hits);
+        PackRelease(p, first);
+        PackRelease(p, next);
+        PackRelease(p, far);
+        ClosePack(p);
+        unlink(name);
+    }
+    for (int i = 0; i < count; i++) FreeMap(maps[i]);
+    ClosePack(config.pack);
+    if (failed) printf("a level could not be decoded\n");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+// ./game --rain [stars] [ticks] [cols rows]
+// A bird flies through STAR_RAIN on a headless board (config.txt's, or cols x rows) and the
+// rain's time per tick is compared with as many STAR entities for a tenth of the ticks
+#define RAIN_BENCH_STARS 100000
+#define RAIN_BENCH_TICKS 2000
+
+int RunRainBench(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    long stars = argc > 2 ? atol(argv[2]) : RAIN_BENCH_STARS;
+    int ticks = argc > 3 ? atoi(argv[3]) : RAIN_BENCH_TICKS;
+    if (argc > 5) {
+        config.screen_width = atoi(argv[4]);
+        config.screen_height = atoi(argv[5]);
+        config.kernel = SelectKernel(&config);
+    }
+    if (stars < 1 || ticks < 10 || config.screen_width < 8 || config.screen_height < 8) {
+        fprintf(stderr, "Error: stars and ticks must be positive and the board at least 8x8\n");
+        return EXIT_FAILURE;
+    }
+    config.map = NULL;      // the rain falls on an open board
+    BENCH_SCENE scene;
+    if (!BenchSceneCreate(&scene, &config)) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    WIN playwin = scene.playwin;
+    FLOCK* flock = scene.flock;
+    void* mem = malloc(RainSize(playwin.cols, playwin.rows));
+    STAR_RAIN* rain = InitRain(mem, &playwin, stars, config.seed);
+    if (!rain) {
+        fprintf(stderr, "Error: the board is too wide for the rain\n");
+        free(mem);
+        BenchSceneFree(&scene);
+        return EXIT_FAILURE;
+    }
+    uint64_t start = TraceWallNs();
+    for (int tick = 0; tick < ticks; tick++) {
+        BenchSceneFly(&scene, &config, tick);
+        RainTick(rain, flock, 1);
+    }
+    double rain_us = (TraceWallNs() - start) / 1e3 / ticks;
+    long caught = 0;
+    for (int i = 0; i < flock->count; i++) caught += flock->bird[i]->score;
+    printf("%ldx%d board, %d birds\n", (long)config.screen_width, config.screen_height, config.birds);
+    printf("rain:     %ld stars in %d speed classes, %8.2f us per tick, %ld caught, %ld left\n",
+           rain->stars, RAIN_CLASSES, rain_us, caught, rain->stars);
+
+    // the same number of STAR entities, the way MAX_STARS stars are moved in the game
+    int entities = (int)rain->stars;
+    int entity_ticks = ticks / 10;
+    STAR** s = (STAR**)malloc(entities * sizeof(STAR*));
+    for (int i = 0; i < entities; i++) {
+        s[i] = InitStar(i, &playwin);
+    }
+    start = TraceWallNs();
+    for (int tick = 0; tick < entity_ticks; tick++) {
+        for (int i = 0; i < flock->count; i++) config.kernel->move_bird(flock->bird[i], 1);
+        IndexFlock(flock, 1);
+        MoveMultipleStar(s, entities, flock, &config, 1);
+        flock->tick++;
+    }
+    double entity_us = (TraceWallNs() - start) / 1e3 / entity_ticks;
+    printf("entities: %d STAR structs,              %8.2f us per tick (%.0fx the rain)\n",
+           entities, entity_us, entity_us / rain_us);
+    for (int i = 0; i < entities; i++) free(s[i]);
+    free(s);
+    free(rain);
+    BenchSceneFree(&scene);
+    return EXIT_SUCCESS;
+}
+
+
+// ./game --kernels [hunters] [stars] [ticks]
+// Times the stress scene on every specialised kernel's board against the generic kernel
+// on the same board, best of KERNEL_BENCH_RUNS, and checks both end in the same state
+#define KERNEL_BENCH_RUNS 3
+
+int RunKernelBench(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    int hunters = argc > 2 ? atoi(argv[2]) : STRESS_HUNTERS;
+    int stars = argc > 3 ? atoi(argv[3]) : STRESS_STARS;
+    int ticks = argc > 4 ? atoi(argv[4]) : STRESS_TICKS;
+    if (hunters < 0 || stars < 0 || ticks < 1) {
+        fprintf(stderr, "Error: counts must be positive\n");
+        return EXIT_FAILURE;
+    }
+    printf("%d hunters, %d stars, %d ticks, best of %d\n", hunters, stars, ticks, KERNEL_BENCH_RUNS);
+    printf("kernel       generic ms/tick  specialised ms/tick  speedup  state\n");
+    int failed = 0;
+    for (int i = 1; i < NUM_GAME_KERNELS; i++) {
+        const GAME_KERNEL* k = &GAME_KERNELS[i];
+        GameConfig board = config;
+        board.screen_width = k->cols;
+        board.screen_height = k->rows;
+        board.hunter_width = k->hunter_width;
+        board.hunter_height = k->hunter_height;
+        SolidMask(board.hunter_mask, k->hunter_width, k->hunter_height);
+        board.hunter_solid = 1;
+        double generic = 0, special = 0;
+        uint64_t generic_hash = 0, special_hash = 0;
+        for (int run = 0; run < KERNEL_BENCH_RUNS; run++) {
+            board.kernel = &GAME_KERNELS[0];
+            double g = RunStressScene(&board, hunters, stars, ticks, &generic_hash);
+            board.kernel = k;
+            double sp = RunStressScene(&board, hunters, stars, ticks, &special_hash);
+            if (run == 0 || g < generic) generic = g;
+            if (run == 0 || sp < special) special = sp;
+        }
+        printf("%-12s %15.3f  %19.3f  %7.2f  %s\n", k->name, generic * 1000, special * 1000,
+               generic / special, generic_hash == special_hash ? "identical" : "DIFFERENT");
+        if (generic_hash != special_hash) failed = 1;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+// ./game --perf games [dt]
+// Plays headless games back to back on one session with the reference bot and reports the
+// counters of every frame phase, the restart time and any allocation after the first frame
+int RunPerf(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    DIFFICULTY_TABLE table;
+    LoadDifficulty(DIFFICULTY_FILE, &table);
+    int games = atoi(argv[2]);
+    int dt = argc > 3 ? atoi(argv[3]) : 1;
+    if (games < 1 || dt < 1 || dt > MAX_DT) {
+        fprintf(stderr, "Error: games must be positive and dt between 1 and %d\n", MAX_DT);
+        return EXIT_FAILURE;
+    }
+    WIN playwin = { NULL, OFFX, OFFY, config.screen_height, config.screen_width, PLAY_COLOR, NULL };
+    GAME_SESSION* gs = SessionCreate(&config, &table, &playwin, NULL);
+    if (!gs) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    PERF counters;
+    PerfOpen(&counters);
+    phase_perf = &counters;
+    int wins = 0;
+    long allocs = 0;
+    uint64_t restart_total = 0, restart_max = 0;
+    for (int i = 0; i < games; i++) {
+        if (RunHeadlessGame(gs, config.seed + i, dt) == 2) wins++;
+        allocs += gs->frame_allocs;
+        if (gs->heat) HeatFlush(gs->heat, HEATMAP_FILE);
+        restart_total += gs->restart_ns;
+        if (gs->restart_ns > restart_max) restart_max = gs->restart_ns;
+    }
+    phase_perf = NULL;
+    PerfClose(&counters);
+    SessionDestroy(gs);
+    printf("%d headless games, %d won, dt %d\n", games, wins, dt);
+    PerfReport(&counters, stdout);
+    printf("restart to first frame: %.1f us mean, %.1f us max\n",
+           restart_total / 1000.0 / games, restart_max / 1000.0);
+    PrintAllocs(allocs);
+    return allocs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ./game --planner [games] [ticks per decision] [threads]
+// Checks that a WORLD snapshot plays on exactly like the session it was taken from, times
+// clones and steps, then plays the same seeds headless with the reference bot and with the
+// planner and compares them.
+#define PLANNER_BENCH_GAMES  4
+#define PLANNER_BENCH_TICKS  100000
+#define PLANNER_CHECK_FRAMES 1000
+
+static int SameActors(const WORLD* w , const GAME_SESSION* gs)
+{
+    for (int i = 0; i < gs->flock.count; i++) {
+        const BIRD* a = &w->bird[i];
+        const BIRD* b = gs->flock.bird[i];
+        if (a->x != b->x || a->y != b->y || a->life != b->life || a->score != b->score) return 0;
+    }
+    for (int i = 0; i < MAX_HUNTERS; i++) {
+        const HUNTER* a = &w->hunter[i];
+        const HUNTER* b = gs->hunter[i];
+        if (a->active != b->active || (a->active && (a->x != b->x || a->y != b->y))) return 0;
+    }
+    for (int i = 0; i < MAX_STARS; i++) {
+        if (w->star[i].x != gs->star[i]->x || w->star[i].y != gs->star[i]->y) return 0;
+    }
+    return w->taxi.x == gs->taxi->x && w->taxi.active == gs->taxi->active;
+}
+
+int RunPlannerBench(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    config.star_rain = 0;   // snapshots do not carry the rain, the replay check would fail
+    DIFFICULTY_TABLE table;
+    LoadDifficulty(DIFFICULTY_FILE, &table);
+    int games = argc > 2 ? atoi(argv[2]) : PLANNER_BENCH_GAMES;
+    long budget = argc > 3 ? atol(argv[3]) : PLANNER_BENCH_TICKS;
+    int threads = argc > 4 ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (games < 1 || budget < PLAN_HOLD || threads < 1) {
+        fprintf(stderr, "Error: games, ticks and threads must be positive\n");
+        return EXIT_FAILURE;
+    }
+    WIN playwin = { NULL, OFFX, OFFY, config.screen_height, config.screen_width, PLAY_COLOR, NULL };
+    GAME_SESSION* gs = SessionCreate(&config, &table, &playwin, NULL);
+    PLANNER* planner = PlannerCreate(&config, &playwin, budget, threads);
+    WORLD* w = (WORLD*)calloc(2, sizeof(WORLD));
+    if (!gs || !planner || !w) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // the snapshot and the session, fed the same keys
+    SessionReset(gs, config.seed);
+    FLOW_FIELD* flow = config.map ? InitFlowField(malloc(FlowFieldSize(playwin.cols, playwin.rows)), &playwin, &config) : NULL;
+    WorldSave(&w[0], gs, flow);
+    int keys[MAX_BIRDS];
+    int diverged = -1, frames = 0;
+    for (; frames < PLANNER_CHECK_FRAMES; frames++) {
+        BotKeys(gs, keys, 0, 1);
+        int a = SessionTick(gs, keys, 1);
+        int b = WorldStep(&w[0], keys, 1);
+        if (a != b || !SameActors(&w[0], gs)) {
+            diverged = frames;
+            break;
+        }
+        if (a != GAME_RUNNING) break;
+    }
+    if (diverged >= 0) printf("snapshot replay: differs from the game at frame %d\n", diverged);
+    else printf("snapshot replay: identical to the game for %d frames\n", frames);
+
+    SessionReset(gs, config.seed);
+    WorldSave(&w[0], gs, flow);
+    w[1].flock.flow = flow;
+    int clones = 200000;
+    uint64_t start = TraceWallNs();
+    for (int i = 0; i < clones; i++) {
+        WorldClone(&w[1], &w[i & 1 ? 1 : 0]);
+        __asm__ volatile("" ::: "memory");
+    }
+    double clone_ns = (double)(TraceWallNs() - start) / clones;
+    for (int i = 0; i < MAX_BIRDS; i++) keys[i] = NOKEY;
+    long steps = 0;
+    start = TraceWallNs();
+    while (steps < 200000) {
+        WorldClone(&w[1], &w[0]);
+        for (int f = 0; f < 200 && WorldStep(&w[1], keys, 1) == GAME_RUNNING; f++) steps++;
+    }
+    double step_ns = (double)(TraceWallNs() - start) / steps;
+    printf("WORLD is %zu bytes: clone %.0f ns, step %.0f ns (%.2f M ticks/s on one thread)\n",
+           sizeof(WORLD), clone_ns, step_ns, 1e3 / step_ns);
+
+    printf("%d games, %ld simulated ticks per decision on %d threads\n", games, budget, planner->threads);
+    printf("bot         won  stars/game  life left  ms/decision  M ticks/s\n");
+    for (int mode = 0; mode < 2; mode++) {
+        gs->planner = mode ? planner : NULL;
+        int wins = 0;
+        long stars = 0, life = 0;
+        for (int g = 0; g < games; g++) {
+            if (RunHeadlessGame(gs, config.seed + g, 1) == 2) wins++;
+            stars += gs->bird->score;
+            life += gs->bird->life;
+        }
+        if (mode == 0) {
+            printf("reference  %4d  %10.1f  %9.1f            -          -\n", wins, (double)stars / games, (double)life / games);
+        } else {
+            printf("planner    %4d  %10.1f  %9.1f  %11.2f  %9.2f\n", wins, (double)stars / games, (double)life / games,
+                   planner->ns / 1e6 / planner->decisions, planner->ticks * 1e3 / planner->ns);
+        }
+    }
+    printf("planner decisions: %ld, %.0f simulated ticks each\n", planner->decisions, (double)planner->ticks / planner->decisions);
+    gs->planner = planner;
+    SessionDestroy(gs);
+    free(w);
+    free(flow);
+    return diverged < 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+// ./game --shm-bench [ticks] [us between ticks]
+// Headless bot games publish every tick to a private shared memory object while a forked
+// reader polls it through swallow_shm.h. The reader reports how long after the end of a
+// tick it held a consistent copy of it, the game how long publishing took.
+#define SHM_BENCH_TICKS    5000
+#define SHM_BENCH_INTERVAL 1000
+
+int CompareU64(const void* x, const void* y)
+{
+    uint64_t a = *(const uint64_t*)x, b = *(const uint64_t*)y;
+    return (a > b) - (a < b);
+}
+
+int ShmBenchReader(const char* name, int ticks)
+{
+    const swallow_shm* shm = swallow_shm_open(name);
+    uint64_t* latency = (uint64_t*)malloc(ticks * sizeof(uint64_t));
+    if (!shm || !latency) {
+        fprintf(stderr, "Error: reader could not open %s\n", name);
+        return EXIT_FAILURE;
+    }
+    swallow_shm_state s;
+    uint64_t seen = swallow_shm_version(shm);
+    long missed = 0;
+    int n = 0;
+    while (n < ticks && !swallow_shm_closed(shm)) {
+        uint64_t v = swallow_shm_version(shm);
+        if (v == seen || (v & 1)) continue;
+        uint64_t got = swallow_shm_read(shm, &s);
+        uint64_t now = TraceWallNs();
+        if (!got) continue;
+        missed += (got - seen) / 2 - 1;
+        latency[n++] = now - s.time_ns;
+        seen = got;
+    }
+    swallow_shm_close(shm);
+    if (n == 0) {
+        printf("reader saw no ticks\n");
+        free(latency);
+        return EXIT_FAILURE;
+    }
+    qsort(latency, n, sizeof(uint64_t), CompareU64);
+    printf("reader saw %d ticks, missed %ld\n", n, missed);
+    printf("tick to reader: %.2f us median, %.2f us p99, %.2f us max\n",
+           latency[n / 2] / 1000.0, latency[(int)(n * 0.99)] / 1000.0, latency[n - 1] / 1000.0);
+    free(latency);
+    return EXIT_SUCCESS;
+}
+
+int RunShmBench(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    DIFFICULTY_TABLE table;
+    LoadDifficulty(DIFFICULTY_FILE, &table);
+    int ticks = argc > 2 ? atoi(argv[2]) : SHM_BENCH_TICKS;
+    int interval = argc > 3 ? atoi(argv[3]) : SHM_BENCH_INTERVAL;
+    if (ticks < 1 || interval < 0) {
+        fprintf(stderr, "Error: ticks must be positive\n");
+        return EXIT_FAILURE;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "/swallow-bench-%d", (int)getpid());
+    if (!ShmStart(name)) return EXIT_FAILURE;
+    fflush(stdout);
+    pid_t reader = fork();
+    if (reader < 0) {
+        perror("fork");
+        ShmStop();
+        return EXIT_FAILURE;
+    }
+    if (reader == 0) {
+        int status = ShmBenchReader(name, ticks);
+        fflush(stdout);
+        _exit(status);
+    }
+    WIN playwin = { NULL, OFFX, OFFY, config.screen_height, config.screen_width, PLAY_COLOR, NULL };
+    GAME_SESSION* gs = SessionCreate(&config, &table, &playwin, NULL);
+    if (!gs) {
+        fprintf(stderr, "Error: Out of memory\n");
+        ShmStop();
+        waitpid(reader, NULL, 0);
+        return EXIT_FAILURE;
+    }
+    usleep(100000);     // give the reader time to map the segment
+    SessionReset(gs, config.seed);
+    ShmNewGame();
+    uint64_t publish = 0, publish_max = 0;
+    int keys[MAX_BIRDS];
+    int games = 1;
+    for (int i = 0; i < ticks; i++) {
+        BotKeys(gs, keys, 0, 1);
+        int result = SessionTick(gs, keys, 1);
+        uint64_t start = TraceWallNs();
+        ShmPublish(gs, result);
+        uint64_t took = TraceWallNs() - start;
+        publish += took;
+        if (took > publish_max) publish_max = took;
+        if (result != GAME_RUNNING) {
+            SessionReset(gs, config.seed + games++);
+            ShmNewGame();
+        }
+        if (interval) usleep(interval);
+    }
+    ShmStop();
+    int status = EXIT_FAILURE;
+    waitpid(reader, &status, 0);
+    SessionDestroy(gs);
+    printf("%d ticks over %d games, %zu byte state\n", ticks, games, sizeof(swallow_shm_state));
+    printf("publish: %.2f us mean, %.2f us max\n", publish / 1000.0 / ticks, publish_max / 1000.0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+// ./game --pty-latency [presses] [ms between presses]
+// Plays the real game binary under a pseudo-terminal, like a player would, and times key
+// presses until the screen shows them. The output goes through a small terminal emulator
+// (the cursor, erase, insert/delete and repeat sequences ncurses uses for xterm-like
+// terminals) and the status bar's "Position: x=.. y=.." is read back from the emulated
+// screen. Presses alternate between the axes, so a press has shown up once the position
+// changes along the new axis. The bird is first sped up to move every frame.
+#define PTY_PRESSES    200
+#define PTY_SPACING    150      // ms between presses, plus up to one frame of jitter
+#define PTY_TIMEOUT    1000     // ms without the press showing up before it counts as lost
+#define PTY_BUCKET     10       // ms per histogram bar
+#define PTY_MAX_PARAMS 16
+
+typedef struct{
+    int rows, cols;
+    char* cells;
+    int y, x;
+    int saved_y, saved_x;
+    int wrap;               // the last column was written, the next character wraps
+    char last;              // last printed character, for CSI b (repeat)
+    int state;              // 0 text, 1 after ESC, 2 in CSI, 3 skip one byte, 4 in OSC
+    int params[PTY_MAX_PARAMS];
+    int nparams;
+    long bytes;
+} PTY_SCREEN;
+
+void PtyClear(PTY_SCREEN* s, int from, int to)   // cells [from, to) of the screen
+{
+    if (from < 0) from = 0;
+    if (to > s->rows * s->cols) to = s->rows * s->cols;
+    if (to > from) memset(s->cells + from, ' ', to - from);
+}
+
+void PtyLineFeed(PTY_SCREEN* s)
+{
+    if (s->y < s->rows - 1) {
+        s->y++;
+        return;
+    }
+    memmove(s->cells, s->cells + s->cols, (size_t)(s->rows - 1) * s->cols);
+    memset(s->cells + (s->rows - 1) * s->cols, ' ', s->cols);
+}
+
+void PtyPut(PTY_SCREEN* s, char c)
+{
+    if (s->wrap) {
+        s->x = 0;
+        PtyLineFeed(s);
+        s->wrap = 0;
+    }
+    s->cells[s->y * s->cols + s->x] = c;
+    s->last = c;
+    if (s->x < s->cols - 1) s->x++;
+    else s->wrap = 1;
+}
+
+void PtyCsi(PTY_SCREEN* s, char final)
+{
+    int n = s->nparams > 0 && s->params[0] > 0 ? s->params[0] : 1;
+    int m = s->nparams > 1 && s->params[1] > 0 ? s->params[1] : 1;
+    int at = s->y * s->cols + s->x;
+    char* line = s->cells + s->y * s->cols;
+    int left = s->cols - s->x;
+    s->wrap = 0;
+    switch (final) {
+        case 'H': case 'f': s->y = n - 1; s->x = m - 1; break;
+        case 'A': s->y -= n; break;
+        case 'B': s->y += n; break;
+        case 'C': s->x += n; break;
+        case 'D': s->x -= n; break;
+        case 'G': case '`': s->x = n - 1; break;
+        case 'd': s->y = n - 1; break;
+        case 'X': PtyClear(s, at, at + (n < left ? n : left)); break;
+        case 'K': {
+            int mode = s->nparams ? s->params[0] : 0;
+            if (mode == 0) PtyClear(s, at, at + left);
+            else if (mode == 1) PtyClear(s, at - s->x, at + 1);
+            else PtyClear(s, at - s->x, at - s->x + s->cols);
+            break;
+        }
+        case 'J': {
+            int mode = s->nparams ? s->params[0] : 0;
+            if (mode == 0) PtyClear(s, at, s->rows * s->cols);
+            else if (mode == 1) PtyClear(s, 0, at + 1);
+            else PtyClear(s, 0, s->rows * s->cols);
+            break;
+        }
+        case 'P':
+            if (n > left) n = left;
+            memmove(line + s->x, line + s->x + n, left - n);
+            memset(line + s->cols - n, ' ', n);
+            break;
+        case '@':
+            if (n > left) n = left;
+            memmove(line + s->x + n, line + s->x, left - n);
+            memset(line + s->x, ' ', n);
+            break;
+        case 'L': case 'M': {
+            int below = s->rows - s->y;
+            if (n > below) n = below;
+            char* top = s->cells + s->y * s->cols;
+            if (final == 'L') memmove(top + n * s->cols, top, (size_t)(below - n) * s->cols);
+            else memmove(top, top + n * s->cols, (size_t)(below - n) * s->cols);
+            PtyClear(s, final == 'L' ? at - s->x : (s->rows - n) * s->cols,
+                     final == 'L' ? at - s->x + n * s->cols : s->rows * s->cols);
+            break;
+        }
+        case 'b': for (int i = 0; i < n; i++) PtyPut(s, s->last); break;
+        default: break;     // colors, modes, scroll regions: nothing the position depends on
+    }
+    if (s->y < 0) s->y = 0;
+    if (s->y >= s->rows) s->y = s->rows - 1;
+    if (s->x < 0) s->x = 0;
+    if (s->x >= s->cols) s->x = s->cols - 1;
+}
+
+void PtyFeed(PTY_SCREEN* s, const char* data, int len)
+{
+    s->bytes += len;
+    for (int i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        switch (s->state) {
+            case 1:     // after ESC
+                s->state = 0;
+                if (c == '[') {
+                    s->state = 2;
+                    s->nparams = 0;
+                    s->params[0] = 0;
+                }
+                else if (c == ']') s->state = 4;
+                else if (c == '(' || c == ')' || c == '*' || c == '+' || c == '#') s->state = 3;
+                else if (c == '7') { s->saved_y = s->y; s->saved_x = s->x; }
+                else if (c == '8') { s->y = s->saved_y; s->x = s->saved_x; s->wrap = 0; }
+                else if (c == 'M' && s->y > 0) s->y--;
+                break;
+            case 2:     // CSI parameters
+                if (c >= '0' && c <= '9') {
+                    if (s->nparams == 0) s->nparams = 1;
+                    s->params[s->nparams - 1] = s->params[s->nparams - 1] * 10 + (c - '0');
+                }
+                else if (c == ';') {
+                    if (s->nparams == 0) s->nparams = 1;
+                    if (s->nparams < PTY_MAX_PARAMS) s->params[s->nparams++] = 0;
+                }
+                else if (c >= 0x40 && c <= 0x7e) {
+                    s->state = 0;
+                    PtyCsi(s, c);
+                }
+                break;      // '?', '>' and the like only mark private modes
+            case 3:
+                s->state = 0;
+                break;
+            case 4:     // OSC, ends with BEL or ESC + backslash
+                if (c == 7) s->state = 0;
+                else if (c == 27) s->state = 3;
+                break;
+            default:
+                if (c == 27) s->state = 1;
+                else if (c == '\r') { s->x = 0; s->wrap = 0; }
+                else if (c == '\n' || c == 11 || c == 12) { PtyLineFeed(s); s->wrap = 0; }
+                else if (c == '\b') { if (s->x > 0) s->x--; s->wrap = 0; }
+                else if (c == '\t') { s->x = (s->x / 8 + 1) * 8; if (s->x >= s->cols) s->x = s->cols - 1; }
+                else if (c >= 0x20 && c != 0x7f && (c < 0x80 || c >= 0xc0)) PtyPut(s, (char)c);
+                break;  // other control bytes and UTF-8 continuation bytes take no cell
+        }
+    }
+}
+
+// Reads the status bar, 0 while it is not on screen
+int PtyPosition(const PTY_SCREEN* s, int* x, int* y)
+{
+    static const char key[] = "Position: x=";
+    int klen = (int)sizeof(key) - 1;
+    for (int r = 0; r < s->rows; r++) {
+        const char* line = s->cells + r * s->cols;
+        for (int c = 0; c + klen < s->cols; c++) {
+            if (line[c] != 'P' || memcmp(line + c, key, klen) != 0) continue;
+            char text[32];
+            int n = s->cols - c - klen < 31 ? s->cols - c - klen : 31;
+            memcpy(text, line + c + klen, n);
+            text[n] = '\0';
+            return sscanf(text, "%d y=%d", x, y) == 2;
+        }
+    }
+    return 0;
+}
+
+// Feeds whatever the game printed within wait_ms (or less once something arrived)
+int PtyPump(int fd, PTY_SCREEN* s, int wait_ms)
+{
+    struct pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, wait_ms) <= 0) return 0;
+    char buf[16384];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) return -1;
+    PtyFeed(s, buf, (int)n);
+    return 1;
+}
+
+// Keeps the screen up to date until the given time
+void PtyPumpUntil(int fd, PTY_SCREEN* s, uint64_t until)
+{
+    uint64_t now;
+    while ((now = TraceWallNs()) < until) {
+        if (PtyPump(fd, s, (int)((until - now) / 1000000) + 1) < 0) return;
+    }
+}
+
+int RunPtyLatency(int argc, char* argv[])
+{
+    GameConfig config;
+    if (!LoadConfig("config.txt", &config)) return EXIT_FAILURE;
+    int presses = argc > 2 ? atoi(argv[2]) : PTY_PRESSES;
+    int spacing = argc > 3 ? atoi(argv[3]) : PTY_SPACING;
+    if (presses < 1 || spacing < 0) {
+        fprintf(stderr, "Error: presses must be positive\n");
+        return EXIT_FAILURE;
+    }
+    PTY_SCREEN s = { 0 };
+    s.rows = config.screen_height + OFFY + STAT_HEIGHT + 1;
+    s.cols = config.screen_width + OFFX + 2;
+    s.cells = (char*)malloc((size_t)s.rows * s.cols);
+    uint64_t* latency = (uint64_t*)malloc(presses * sizeof(uint64_t));
+    if (!s.cells || !latency) return EXIT_FAILURE;
+    PtyClear(&s, 0, s.rows * s.cols);
+
+    struct winsize ws = { (unsigned short)s.rows, (unsigned short)s.cols, 0, 0 };
+    int fd;
+    pid_t game = forkpty(&fd, NULL, NULL, &ws);
+    if (game < 0) {
+        perror("forkpty");
+        return EXIT_FAILURE;
+    }
+    if (game == 0) {
+        setenv("TERM", getenv("TERM") ? getenv("TERM") : "xterm", 0);
+        execl("/proc/self/exe", argv[0], (char*)NULL);
+        _exit(127);
+    }
+    int x = 0, y = 0;
+    uint64_t deadline = TraceWallNs() + 5000000000ULL;
+    while (!PtyPosition(&s, &x, &y) && TraceWallNs() < deadline) {
+        if (PtyPump(fd, &s, 100) < 0) break;
+    }
+    int started = PtyPosition(&s, &x, &y);
+    if (started) {
+        // full speed, one key per frame since the game drops the rest; then move sideways
+        const char warmup[] = { SPEED_UP, SPEED_UP, SPEED_UP, SPEED_UP, RIGHT };
+        for (size_t i = 0; i < sizeof(warmup); i++) {
+            write(fd, &warmup[i], 1);
+            PtyPumpUntil(fd, &s, TraceWallNs() + 3 * FRAME_TIME * 1000000ULL);
+        }
+    }
+    const char keys[] = { UP, RIGHT, DOWN, LEFT };
+    unsigned int rng = (unsigned int)time(NULL);
+    int seen = 0, lost = 0, lost_in_row = 0;
+    long bytes = s.bytes;
+    uint64_t start = TraceWallNs();
+    for (int i = 0; started && i < presses && lost_in_row < 3; i++) {
+        char key = keys[i % 4];
+        int vertical = key == UP || key == DOWN;
+        PtyPosition(&s, &x, &y);
+        int before = vertical ? y : x;
+        uint64_t pressed = TraceWallNs();
+        write(fd, &key, 1);
+        int shown = 0;
+        while (!shown && TraceWallNs() - pressed < PTY_TIMEOUT * 1000000ULL) {
+            if (PtyPump(fd, &s, 10) < 0) break;
+            int nx, ny;
+            if (PtyPosition(&s, &nx, &ny) && (vertical ? ny : nx) != before) shown = 1;
+        }
+        if (shown) {
+            latency[seen++] = TraceWallNs() - pressed;
+            lost_in_row = 0;
+        }
+        else {
+            lost++;
+            lost_in_row++;
+        }
+        // a random part of a frame on top, so presses land everywhere in the frame
+        uint64_t jitter = GameRandFrom(&rng) % (FRAME_TIME * 1000) * 1000ULL;
+        PtyPumpUntil(fd, &s, TraceWallNs() + spacing * 1000000ULL + jitter);
+    }
+    double seconds = (TraceWallNs() - start) / 1e9;
+    bytes = s.bytes - bytes;
+
+    // quit, the end screen and ranking need a moment
+    char quit = QUIT;
+    for (int i = 0; i < 20 && waitpid(game, NULL, WNOHANG) == 0; i++) {
+        write(fd, &quit, 1);
+        PtyPumpUntil(fd, &s, TraceWallNs() + 250000000ULL);
+    }
+    if (waitpid(game, NULL, WNOHANG) == 0) {
+        kill(game, SIGTERM);
+        waitpid(game, NULL, 0);
+    }
+    close(fd);
+    free(s.cells);
+
+    if (!started) {
+        fprintf(stderr, "Error: the game did not show its status bar\n");
+        free(latency);
+        return EXIT_FAILURE;
+    }
+    printf("%d presses on a %dx%d pty (TERM=%s): %d shown, %d lost%s\n", seen + lost, s.cols, s.rows,
+           getenv("TERM") ? getenv("TERM") : "xterm", seen, lost, lost_in_row >= 3 ? " (game over)" : "");
+    printf("output: %.0f bytes/s, %.0f bytes per %d ms frame\n",
+           bytes / seconds, bytes / seconds * FRAME_TIME / 1000.0, FRAME_TIME);
+    if (seen) {
+        qsort(latency, seen, sizeof(uint64_t), CompareU64);
+        printf("input to display: %.1f ms min, %.1f median, %.1f p90, %.1f p99, %.1f max\n",
+               latency[0] / 1e6, latency[seen / 2] / 1e6, latency[(int)(seen * 0.9)] / 1e6,
+               latency[(int)(seen * 0.99)] / 1e6, latency[seen - 1] / 1e6);
+        int buckets = (int)(latency[seen - 1] / 1000000 / PTY_BUCKET) + 1;
+        for (int b = 0, i = 0; b < buckets; b++) {
+            int count = 0;
+            while (i < seen && latency[i] < (uint64_t)(b + 1) * PTY_BUCKET * 1000000) { i++; count++; }
+            printf("%4d-%-4d ms %5d ", b * PTY_BUCKET, (b + 1) * PTY_BUCKET, count);
+            for (int k = 0; k < count * 50 / seen; k++) putchar('#');
+            putchar('\n');
+        }
+    }
+    free(latency);
+    return seen ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+// ./game --trace-json trace.bin trace.json
+// Converts a binary trace into Chrome trace JSON (chrome://tracing or ui.perfetto.dev)
+int RunTraceJson(int argc, char* argv[])
+{
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s --trace-json trace.bin trace.json\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE* in = fopen(argv[2], "rb");
+    if (!in) {
+        fprintf(stderr, "Error: Could not open trace file %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    char magic[8];
+    uint32_t header[2];
+    if (fread(magic, 1, 8, in) != 8 || memcmp(magic, TRACE_MAGIC, 8) != 0
+        || fread(header, sizeof(header), 1, in) != 1 || header[1] != sizeof(TRACE_EVENT)) {
+        fprintf(stderr, "Error: %s is not a trace file\n", argv[2]);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    long start = ftell(in);
+
+    // First pass: the first and last clock sync give the raw clock -> ns mapping
+    TRACE_EVENT e;
+    int syncs = 0;
+    uint64_t t0 = 0, t1 = 0, ns0 = 0, ns1 = 0;
+    while (fread(&e, sizeof(e), 1, in) == 1) {
+        if (e.type != TRACE_CLOCK_SYNC) continue;
+        uint64_t ns = (uint64_t)(uint32_t)e.a | ((uint64_t)(uint32_t)e.b << 32);
+        if (syncs++ == 0) { t0 = e.time; ns0 = ns; }
+        t1 = e.time;
+        ns1 = ns;
+    }
+    double ns_per_tick = (syncs > 1 && t1 != t0) ? (double)(ns1 - ns0) / (double)(t1 - t0) : 1.0;
+
+    FILE* out = fopen(argv[3], "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write %s\n", argv[3]);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    static const char* names[TRACE_EVENT_TYPES] = {
+        "clock sync", "frame", "frame", "star collected", "bird damaged",
+        "hunter spawned", "taxi boarded", "taxi finished", "events dropped"
+    };
+    fseek(in, start, SEEK_SET);
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"swallow game\"}}");
+    long count = 0;
+    while (fread(&e, sizeof(e), 1, in) == 1) {
+        if (e.type == TRACE_CLOCK_SYNC || e.type >= TRACE_EVENT_TYPES) continue;
+        double us = ((double)(int64_t)(e.time - t0) * ns_per_tick) / 1000.0;
+        const char* phase = e.type == TRACE_FRAME_BEGIN ? "B" : e.type == TRACE_FRAME_END ? "E" : "i";
+        fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+                names[e.type], phase, us, (unsigned)e.thread);
+        if (phase[0] == 'i') fprintf(out, ",\"s\":\"t\"");
+        fprintf(out, ",\"args\":{\"tick\":%u", (unsigned)e.tick);
+        switch (e.type) {
+            case TRACE_STAR_COLLECTED:
+                fprintf(out, ",\"star\":%d,\"x\":%d,\"y\":%d", e.entity, e.a, e.b);
+                break;
+            case TRACE_BIRD_DAMAGED:
+                fprintf(out, ",\"hunter\":%d,\"damage\":%d,\"x\":%d,\"y\":%d", e.entity, e.a, e.b, e.c);
+                break;
+            case TRACE_HUNTER_SPAWNED:
+                fprintf(out, ",\"hunter\":%d,\"x\":%d,\"y\":%d", e.entity, e.a, e.b);
+                break;
+            case TRACE_TAXI_BOARDED:
+                fprintf(out, ",\"x\":%d,\"y\":%d", e.a, e.b);
+                break;
+            case TRACE_TAXI_FINISHED:
+                fprintf(out, ",\"bonus\":%d", e.a);
+                break;
+            case TRACE_DROPPED:
+                fprintf(out, ",\"count\":%d", e.a);
+                break;
+        }
+        fprintf(out, "}}");
+        count++;
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    fclose(in);
+    printf("%ld events written to %s\n", count, argv[3]);
+    return EXIT_SUCCESS;
+}
+
+
+//__VERSUS OVER A SOCKET______________//
+//====================================//
+//------------------------------------//
+
+// ./game --host [socket] [delay ms] [jitter ms] in one terminal and ./game --join with the
+// same socket in another: two players in one game, the host flies the first bird and the
+// guest the second, and the hunters chase both. Each side runs the whole simulation from
+// the host's seed and only the keys are sent. Nobody waits for the other's key of a frame:
+// it is predicted (no key, like most frames) and the game goes on. When the real key turns
+// out different, the game is put back to the snapshot from before that frame and the frames
+// since are played again. A side NET_ROLLBACK frames ahead of the keys it has waits instead.
+// delay and jitter hold back every packet sent, to try it as if the other side were far away.
+#define NET_SOCKET   "swallow.sock"
+#define NET_MAGIC    0x53574e54u    // "SWNT"
+#define NET_VERSION  1
+#define NET_ROLLBACK 8              // most frames played on predicted keys
+#define NET_SNAPS    (NET_ROLLBACK + 2)
+#define NET_RING     64             // frames of keys kept, more than either side can be ahead
+#define NET_CHECK    16             // frames between state hash comparisons
+#define NET_CHECKS   8              // hashes kept per side
+#define NET_QUEUE    512            // packets the latency injection can hold back
+
+enum { NET_HELLO, NET_INPUT, NET_CHECKSUM };
+
+typedef struct{
+    uint32_t type;
+    uint32_t tick;
+    uint64_t value;     // NET_HELLO: seed or settings hash, NET_INPUT: key, NET_CHECKSUM: state hash
+} NET_PACKET;
+
+typedef struct{
+    int fd;
+    int closed;                     // the other side hung up
+    int delay_ms, jitter_ms;
+    unsigned int rng;               // jitter
+    NET_PACKET queue[NET_QUEUE];    // sent, waiting for their due time
+    uint64_t due[NET_QUEUE];
+    int head, count;
+    unsigned char in[sizeof(NET_PACKET)];   // a packet read in part
+    int in_size;
+} NET_LINK;
+
+typedef struct{
+    NET_LINK link;
+    int me;                         // the bird of this side, 0 on the host
+    WORLD world;                    // the game as far as it is played, on predicted keys
+    WORLD snap[NET_SNAPS];          // world at the start of each of the last frames
+    long tick;                      // frames played
+    long confirmed;                 // frames whose key from the other side is known
+    long wrong;                     // first played frame whose prediction was wrong, -1 for none
+    int local[NET_RING];            // keys of both sides and the ones played, by frame
+    int remote[NET_RING];
+    int used[NET_RING];
+    long end_tick;                  // last frame of the game, -1 while it runs
+    int result;
+    long checked;                   // frames up to here had their hash sent
+    long check_tick[2][NET_CHECKS]; // [0] ours, [1] theirs
+    uint64_t check_hash[2][NET_CHECKS];
+    long rollbacks, resimulated, deepest, waits, compared, desyncs;
+    GameConfig config;
+    DIFFICULTY_TABLE table;
+    WIN board;                      // the session's, without a window
+    GAME_SESSION* session;          // the game the world was built from
+    FLOW_FIELD* flow;
+} VERSUS;
+
+// Queues p, it is written once delay (and some jitter) has passed. Packets keep their order.
+static void NetSend(NET_LINK* l , uint32_t type , uint32_t tick , uint64_t value)
+{
+    if (l->count == NET_QUEUE) return;      // cannot happen with NET_ROLLBACK frames of keys
+    int i = (l->head + l->count) % NET_QUEUE;
+    uint64_t due = TraceWallNs() + (uint64_t)l->delay_ms * 1000000;
+    if (l->jitter_ms > 0) due += (uint64_t)(GameRandFrom(&l->rng) % (l->jitter_ms + 1)) * 1000000;
+    int last = (i + NET_QUEUE - 1) % NET_QUEUE;
+    if (l->count > 0 && due < l->due[last]) due = l->due[last];
+    l->queue[i] = (NET_PACKET){ type, tick, value };
+    l->due[i] = due;
+    l->count++;
+}
+
+// Writes the packets that are due. With wait set, waits for all of them.
+static void NetFlush(NET_LINK* l , int wait)
+{
+    while (l->count > 0 && !l->closed) {
+        uint64_t now = TraceWallNs();
+        if (l->due[l->head] > now) {
+            if (!wait) return;
+            usleep((l->due[l->head] - now) / 1000 + 1);
+            continue;
+        }
+        ssize_t n = send(l->fd, &l->queue[l->head], sizeof(NET_PACKET), MSG_NOSIGNAL | (wait ? 0 : MSG_DONTWAIT));
+        if (n == (ssize_t)sizeof(NET_PACKET)) {
+            l->head = (l->head + 1) % NET_QUEUE;
+            l->count--;
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        else {
+            l->closed = 1;
+        }
+    }
+}
+
+// Next whole packet from the other side into p. 0 when none has arrived (yet).
+static int NetReceive(NET_LINK* l , NET_PACKET* p , int wait)
+{
+    while (!l->closed) {
+        ssize_t n = recv(l->fd, l->in + l->in_size, sizeof(l->in) - l->in_size, wait ? 0 : MSG_DONTWAIT);
+        if (n > 0) {
+            l->in_size += n;
+            if (l->in_size < (int)sizeof(l->in)) continue;
+            memcpy(p, l->in, sizeof(*p));
+            l->in_size = 0;
+            return 1;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (n < 0 && errno == EINTR) continue;
+        l->closed = 1;
+    }
+    return 0;
+}
 
-    // Create ncurses subwindow
-    W->window = subwin(parent, rows, cols, y, x);
+// What both sides must agree on before playing: the settings, the walls and the first frame
+static uint64_t VersusSettingsHash(const WORLD* w)
+{
+    const GameConfig* c = &w->config;
+    uint64_t hash = 14695981039346656037ULL;
+    int values[] = { c->screen_width, c->screen_height, c->star_quota, c->swallow_speed_min, c->swallow_speed_max,
+                     c->hunter_spawn_rate, c->damage_penalty, c->hunter_bounces, c->hunter_width, c->hunter_height,
+                     c->hunter_num, c->available_taxis, c->taxi_bonus, c->birds, c->pack_level, c->hunter_flocking };
+    double times[] = { c->time_limit, c->hunter_speed };
+    hash = HashBytes(hash, values, sizeof(values));
+    hash = HashBytes(hash, times, sizeof(times));
+    hash = HashBytes(hash, c->hunter_mask, sizeof(c->hunter_mask));
+    for (int i = 0; i < NUM_LEVELS; i++) {     // field by field, LEVEL has padding
+        const LEVEL* l = &w->table->level[i];
+        int stage[] = { l->hunter_spawn_rate, l->hunter_bounces, l->hunter_num };
+        hash = HashBytes(hash, stage, sizeof(stage));
+        hash = HashBytes(hash, &l->hunter_speed, sizeof(double));
+    }
+    if (w->win.map) hash = HashBytes(hash, w->win.map->solid, (size_t)w->win.map->cols * w->win.map->rows);
+    for (int i = 0; i < w->flock.count; i++) hash = HashBytes(hash, &w->bird[i].x, sizeof(int) * 4);
+    hash = HashBytes(hash, &w->hunter[0].seed, sizeof(unsigned int));    // the game's seed
+    return hash;
+}
 
-    // Clear the window
-    CleanWin(W, bo);
+// Everything the players can see, compared every NET_CHECK frames to catch a desync
+static uint64_t WorldHash(const WORLD* w)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    hash = HashBytes(hash, &w->config.time_limit, sizeof(double));
+    for (int i = 0; i < w->flock.count; i++) {
+        const BIRD* b = &w->bird[i];
+        int values[] = { b->x, b->y, b->dx, b->dy, b->speed, b->score, b->life, b->on_taxi };
+        hash = HashBytes(hash, values, sizeof(values));
+    }
+    for (int i = 0; i < MAX_HUNTERS; i++) {
+        const HUNTER* h = &w->hunter[i];
+        hash = HashBytes(hash, &h->active, sizeof(int));
+        if (!h->active) continue;
+        hash = HashBytes(hash, &h->x, sizeof(double) * 4);
+        hash = HashBytes(hash, &h->bounces, sizeof(int));
+    }
+    for (int i = 0; i < MAX_STARS; i++) hash = HashBytes(hash, &w->star[i].x, sizeof(int) * 2);
+    int taxi[] = { w->taxi.x, w->taxi.active, w->taxi.state, w->taxi.counter_of_taxis };
+    return HashBytes(hash, taxi, sizeof(taxi));
+}
 
-    // Set input mode: delay==0 means non-blocking (for real-time games)
-    if (delay == 0) nodelay(W->window, TRUE);
+// Plays frame v->tick on the keys known or predicted for it
+static int VersusStep(VERSUS* v)
+{
+    long t = v->tick;
+    int keys[MAX_BIRDS];
+    for (int i = 0; i < MAX_BIRDS; i++) keys[i] = NOKEY;
+    v->used[t % NET_RING] = t < v->confirmed ? v->remote[t % NET_RING] : NOKEY;
+    keys[v->me] = v->local[t % NET_RING];
+    keys[1 - v->me] = v->used[t % NET_RING];
+    if (keys[1] == QUIT) keys[0] = QUIT;    // GameTick only ends the game on the first bird's
+    WorldClone(&v->snap[t % NET_SNAPS], &v->world);
+    v->tick++;
+    int result = WorldStep(&v->world, keys, 1);
+    if (result != GAME_RUNNING) {
+        v->end_tick = t;
+        v->result = result;
+    }
+    return result;
+}
 
-    // Display the window
-    wrefresh(W->window);
+// Sends the hash of every checked frame whose keys are all known by now, and compares it
+// with the other side's when both are there
+static void VersusCheck(VERSUS* v , int side , long tick , uint64_t hash)
+{
+    int i = (tick / NET_CHECK) % NET_CHECKS;
+    v->check_tick[side][i] = tick;
+    v->check_hash[side][i] = hash;
+    if (v->check_tick[1 - side][i] != tick) return;
+    v->compared++;
+    if (v->check_hash[1 - side][i] != hash) v->desyncs++;
+}
 
-    return W;
+// Reads what the other side sent, and notes the first frame that was played on a wrong guess
+static void VersusReceive(VERSUS* v)
+{
+    NET_PACKET p;
+    while (NetReceive(&v->link, &p, 0)) {
+        if (p.type == NET_INPUT && p.tick == v->confirmed) {
+            int key = (int)(int64_t)p.value;
+            v->remote[p.tick % NET_RING] = key;
+            if (p.tick < v->tick && v->used[p.tick % NET_RING] != key && v->wrong < 0) v->wrong = p.tick;
+            v->confirmed++;
+        }
+        else if (p.type == NET_CHECKSUM) {
+            VersusCheck(v, 1, p.tick, p.value);
+        }
+    }
 }
 
-void ShowStatus(WIN* W, void* bird , GameConfig* config)
+// Back to the frame that was played on a wrong guess, and forward again on the real keys
+static void VersusRollback(VERSUS* v)
 {
-    BIRD* b = (BIRD*)bird;
-    // Set status bar color
-    
-    wattron(W->window, COLOR_PAIR(BIRD_COLOR) | A_BOLD | A_REVERSE);
-    mvwprintw(W->window, 1, 2, "   SCORE: %d/%d     Time Left : %.1f  Life = %d   ", b->score , config->star_quota , config->time_limit ,  b->life);
-    wattroff(W->window, COLOR_PAIR(BIRD_COLOR) | A_BOLD | A_REVERSE);
-    
-    wattron(W->window, COLOR_PAIR(W->color));
+    if (v->wrong < 0) return;
+    long to = v->tick;
+    v->tick = v->wrong;
+    v->wrong = -1;
+    WorldClone(&v->world, &v->snap[v->tick % NET_SNAPS]);
+    if (v->world.flock.flow) v->world.flock.flow->count = -1;  // routes for the restored birds
+    v->end_tick = -1;
+    v->result = GAME_RUNNING;
+    v->rollbacks++;
+    if (to - v->tick > v->deepest) v->deepest = to - v->tick;
+    while (v->tick < to) {
+        v->resimulated++;
+        if (VersusStep(v) != GAME_RUNNING) break;
+    }
+}
 
-    // Draw border around status bar
-    box(W->window, 0, 0);
-    const char* controls = "[W]Up [S]Dn [A]Lft [D]Rgt [Q]Quit";
-    int pos_x = W->cols - strlen(controls) - 2; // -2 for right margin
-    mvwprintw(W->window, 1, pos_x, "%s", controls);
-    
-    // Display controls
-    
-    mvwprintw(W->window, 2, pos_x, "Position: x=%d y=%d " ,b->x, b->y  );
-    mvwprintw(W->window, 3, pos_x - 30, "Press t to activate shield taxi and bonus points");
-    mvwprintw(W->window, 2, 2, "PLAYER: %s   LEVEL: %d  TAXIS AVAILABLE: %d", config->player_name, config->curr_level , config->available_taxis);
-    
-    mvwprintw(W->window , 3 , 2 , "SPEED = %d" , b->speed );
-    // Update display
-    wrefresh(W->window);
-    //sleep(2);
+// Hash of each NET_CHECK frame once nothing can change it any more
+static void VersusSendChecks(VERSUS* v)
+{
+    long final = v->confirmed < v->tick ? v->confirmed : v->tick;   // frames before it are final
+    for (long t = (v->checked / NET_CHECK + 1) * NET_CHECK; t <= final; t += NET_CHECK) {
+        uint64_t hash = WorldHash(t == v->tick ? &v->world : &v->snap[t % NET_SNAPS]);
+        NetSend(&v->link, NET_CHECKSUM, (uint32_t)t, hash);
+        VersusCheck(v, 0, t, hash);
+        v->checked = t;
+    }
 }
 
-void EndGameWin(WIN* W)
+static void DrawVersus(VERSUS* v , WIN* playwin , WIN* statwin)
 {
-    // Clear the window
-    CleanWin(W, 1);
-    nodelay(W->window , FALSE);
-    // Display goodbye message
-    wattron(W->window, COLOR_PAIR(STAT_COLOR));
-    mvwprintw(W->window, W->rows / 2 - 1 , W->cols / 2 - 18, "MISSION ACCOMPLISHED! SWALLOW SAVED!");
-    wattroff(W->window, COLOR_PAIR(STAT_COLOR));
-    sleep(1);
-    mvwprintw(W->window, W->rows / 2 + 1 , W->cols / 2 - 12, "Press q to exit ");
-    wrefresh(W->window);
+    WORLD* w = &v->world;
+    w->win.window = playwin->window;
+    werase(playwin->window);
+    wattron(playwin->window, COLOR_PAIR(playwin->color));
+    box(playwin->window, 0, 0);
+    DrawMap(&w->win);
+    for (int i = 0; i < MAX_STARS; i++) DrawStar(&w->star[i]);
+    for (int i = 0; i < MAX_HUNTERS; i++) {
+        if (w->hunter[i].active) DrawHunter(&w->hunter[i]);
+    }
+    if (w->taxi.active) {
+        if (w->taxi.state == 1) {
+            DrawTaxiSafeZone(&w->taxi);
+            DrawBonus(&w->taxi);
+        }
+        DrawTaxi(&w->taxi);
+    }
+    DrawFlock(&w->flock);
+    w->win.window = NULL;
+    wnoutrefresh(playwin->window);
+
+    const BIRD* me = &w->bird[v->me];
+    const BIRD* them = &w->bird[1 - v->me];
+    werase(statwin->window);
+    wattron(statwin->window, COLOR_PAIR(statwin->color));
+    box(statwin->window, 0, 0);
+    wattron(statwin->window, COLOR_PAIR(BIRD_COLOR) | A_BOLD | A_REVERSE);
+    mvwprintw(statwin->window, 1, 2, "   YOU: %d stars, life %d   OTHER: %d stars, life %d   TOGETHER: %d/%d   Time Left : %.1f   ",
+              me->score, me->life, them->score, them->life, me->score + them->score, w->config.star_quota, w->config.time_limit);
+    wattroff(statwin->window, COLOR_PAIR(BIRD_COLOR) | A_BOLD | A_REVERSE);
+    wattron(statwin->window, COLOR_PAIR(statwin->color));
+    mvwprintw(statwin->window, 2, 2, "FRAME %ld  AHEAD %ld  ROLLBACKS %ld  RESIMULATED %ld  DEEPEST %ld  WAITS %ld  DESYNCS %ld",
+              v->tick, v->tick - v->confirmed, v->rollbacks, v->resimulated, v->deepest, v->waits, v->desyncs);
+    mvwprintw(statwin->window, 3, 2, "%s, latency injection %d ms + up to %d ms   [W]Up [S]Dn [A]Lft [D]Rgt [T]axi [Q]Quit",
+              v->me ? "GUEST (second bird)" : "HOST (first bird)", v->link.delay_ms, v->link.jitter_ms);
+    wnoutrefresh(statwin->window);
+    doupdate();
+}
 
-    wgetch(W->window);
-  
+// Whether the next frame can be played now. Otherwise it waits for keys that may still
+// change the end, or because it is too far ahead of the other side's.
+static int VersusReady(VERSUS* v)
+{
+    if (v->end_tick >= 0 || v->tick - v->confirmed >= NET_ROLLBACK) {
+        v->waits++;
+        return 0;
+    }
+    return 1;
 }
 
-void EndGameLose(WIN* W)
+// Plays the next frame on this side's key, and sends the key
+static void VersusPlay(VERSUS* v , int key)
 {
-    CleanWin(W, 1);
-    nodelay(W->window , FALSE);
-    wattron(W->window, COLOR_PAIR(HUNTER_COLOR));
-    mvwprintw(W->window, W->rows / 2 - 1 , W->cols / 2 - 18 , "GAME OVER.");
-    wattroff(W->window, COLOR_PAIR(HUNTER_COLOR));
-    sleep(1);
+    v->local[v->tick % NET_RING] = key;
+    NetSend(&v->link, NET_INPUT, (uint32_t)v->tick, (uint64_t)(int64_t)key);
+    VersusStep(v);
+}
 
-    mvwprintw(W->window, W->rows / 2 + 1 , W->cols / 2 - 12, "Press q to exit ");
-    wrefresh(W->window);
-   
+// Sends what is due, takes in the other side's keys and plays again the frames they change.
+// GAME_RUNNING until the game is over on keys both sides agree on, 0 if the other side left.
+static int VersusSync(VERSUS* v)
+{
+    NetFlush(&v->link, 0);
+    VersusReceive(v);
+    VersusRollback(v);
+    VersusSendChecks(v);
+    if (v->end_tick >= 0 && v->confirmed > v->end_tick) return v->result;
+    if (v->link.closed) return 0;
+    return GAME_RUNNING;
+}
 
-    int ch;
-    while((ch = wgetch(W->window)) != 'q') {
+// Plays until the game is over on keys both sides agree on, or the other side leaves.
+// Returns the result as MainLoop does.
+static int VersusLoop(VERSUS* v , WIN* playwin , WIN* statwin)
+{
+    while (1) {
+        uint64_t start = TraceWallNs();
+        int result = VersusSync(v);
+        if (result != GAME_RUNNING) return result;
+        if (VersusReady(v)) {
+            int keys[MAX_BIRDS];
+            ReadPlayerKeys(statwin->window, keys, 1);
+            VersusPlay(v, keys[0]);
         }
+        NetFlush(&v->link, 0);
+        DrawVersus(v, playwin, statwin);
+        flushinp();
+        uint64_t spent = (TraceWallNs() - start) / 1000;
+        if (spent < FRAME_TIME * 1000) usleep(FRAME_TIME * 1000 - spent);
+    }
+}
 
+// Connected socket to the other player, NULL-like -1 with a message if it fails
+static int VersusConnect(const char* path , int host)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path %s is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (!host) {
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "Error: nobody hosts a game on %s\n", path);
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+        fprintf(stderr, "Error: Could not listen on %s\n", path);
+        close(fd);
+        return -1;
+    }
+    printf("Waiting for the other player: ./game --join %s\n", path);
+    fflush(stdout);
+    int peer = accept(fd, NULL, NULL);
+    close(fd);
+    unlink(path);
+    return peer;
 }
 
-void EndGameQuit(WIN* W)
+// One side of a game with config.txt and difficulty.txt read, not connected yet.
+// NULL with a message if they cannot be read or memory runs out.
+static VERSUS* VersusCreate(int host , int delay_ms , int jitter_ms)
 {
-    CleanWin(W, 1);
-    mvwprintw(W->window, 2, 2, "Game Aborted.");
-    wrefresh(W->window);
-    sleep(1);
+    VERSUS* v = (VERSUS*)calloc(1, sizeof(VERSUS));
+    if (!v) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return NULL;
+    }
+    if (!LoadConfig("config.txt", &v->config)) {
+        free(v);
+        return NULL;
+    }
+    v->config.birds = 2;
+    v->config.players = 1;
+    v->config.planner = 0;
+    v->config.star_rain = 0;   // not part of the snapshots
+    LoadDifficulty(DIFFICULTY_FILE, &v->table);
+    v->me = host ? 0 : 1;
+    v->wrong = -1;
+    v->end_tick = -1;
+    v->result = GAME_RUNNING;
+    v->link.fd = -1;
+    v->link.delay_ms = delay_ms;
+    v->link.jitter_ms = jitter_ms;
+    v->link.rng = (unsigned int)getpid() * 2 + v->me;
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < NET_CHECKS; i++) v->check_tick[s][i] = -1;
+    }
+    return v;
 }
 
-//__MAIN_GAME_LOOP_AND_MECHANICS___//
-//==================================//
-//--------------------------------//
+// Closes the socket and frees v with the game it holds
+static void VersusDestroy(VERSUS* v)
+{
+    if (!v) return;
+    if (v->link.fd >= 0) close(v->link.fd);
+    SessionDestroy(v->session);
+    free(v->flow);
+    FreeMap((MAP*)v->config.map);
+    ClosePack(v->config.pack);
+    free(v);
+}
 
-void Difficulty(GameConfig *config , double time)
+// Writes p at once, without the latency injection. 0 if the other side is gone.
+static int NetSendNow(NET_LINK* l , const NET_PACKET* p)
 {
-    double time_passed = time - config->time_limit;
-    // 4 levels , level 1 from 10 to 35 level 2 : from 35 to 60 level 3 : from 60 to 85 and level 4 : from 85 to 90
-    //spaw rate of hunter lowers , and the bounces increases so the live longer at the last level speed also increases
-    if (time_passed > 0 && time_passed <= config->time_limit/6.0) {
-            config->hunter_spawn_rate = 50;
-            config->hunter_bounces = 3;
-            config->curr_level = 1;
-            config->hunter_num = 3;
-        }
-        else if (time_passed > config->time_limit/6.0 && time_passed <= 2*config->time_limit/6.0) {
-            config->hunter_spawn_rate = 25;
-            config->hunter_bounces = 8;
-            config->curr_level = 2;
-            config->hunter_num = 4;
+    if (send(l->fd, p, sizeof(*p), MSG_NOSIGNAL) == (ssize_t)sizeof(*p)) return 1;
+    l->closed = 1;
+    return 0;
+}
 
+// Builds the game on v->link.fd: the host sends its seed, then both sides check they built
+// the same game from it. 0 with a message if they could not agree.
+static int VersusOpen(VERSUS* v)
+{
+    NET_PACKET p = { NET_HELLO, NET_VERSION, (uint64_t)(unsigned int)v->config.seed };
+    if (v->me == 0) {
+        if (!NetSendNow(&v->link, &p)) {
+            fprintf(stderr, "Error: the other player left before the game started\n");
+            return 0;
         }
-        else if (time_passed > 2*config->time_limit/4.0 && time_passed <= 3.5 * config->time_limit/4.0) {
-            config->hunter_spawn_rate = 20;
-            config->hunter_bounces = 5;
-            config->curr_level = 3;
-            config->hunter_num = 5;
-            config->hunter_speed = 1.0;
+    }
+    else if (!NetReceive(&v->link, &p, 1) || p.type != NET_HELLO || p.tick != NET_VERSION) {
+        fprintf(stderr, "Error: the host speaks another version\n");
+        return 0;
+    }
+    unsigned int seed = (unsigned int)p.value;
+    v->board = (WIN){ NULL, OFFX, OFFY, v->config.screen_height, v->config.screen_width, PLAY_COLOR, NULL };
+    v->session = SessionCreate(&v->config, &v->table, &v->board, NULL);
+    if (!v->session) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 0;
+    }
+    SessionReset(v->session, seed);
+    if (v->board.map && v->board.map->walls) {
+        v->flow = InitFlowField(malloc(FlowFieldSize(v->board.cols, v->board.rows)), &v->board, &v->session->config);
+        if (!v->flow) {
+            fprintf(stderr, "Error: Out of memory\n");
+            return 0;
         }
-        else if(time_passed > 3.5 * config->time_limit/4.0){
-            config->hunter_spawn_rate = 10;
-            config->hunter_bounces = 4;
-            config->curr_level = 4;
-            config->hunter_num = 6;
-            config->hunter_speed = 1.2;
+    }
+    WorldSave(&v->world, v->session, v->flow);
+    uint64_t mine = VersusSettingsHash(&v->world);
+    p = (NET_PACKET){ NET_HELLO, NET_MAGIC, mine };
+    if (!NetSendNow(&v->link, &p)) {
+        fprintf(stderr, "Error: the other player left before the game started\n");
+        return 0;
+    }
+    if (!NetReceive(&v->link, &p, 1) || p.type != NET_HELLO || p.tick != NET_MAGIC || p.value != mine) {
+        fprintf(stderr, "Error: the other side has another config.txt, difficulty.txt or map\n");
+        return 0;
+    }
+    return 1;
+}
 
-        }
+// ./game --host [socket] [delay ms] [jitter ms] or ./game --join [socket] [delay ms] [jitter ms]
+int RunVersus(int argc, char* argv[])
+{
+    int host = strcmp(argv[1], "--host") == 0;
+    const char* path = argc > 2 ? argv[2] : NET_SOCKET;
+    VERSUS* v = VersusCreate(host, argc > 3 ? atoi(argv[3]) : 0, argc > 4 ? atoi(argv[4]) : 0);
+    if (!v) return EXIT_FAILURE;
+    v->link.fd = VersusConnect(path, host);
+    if (v->link.fd < 0 || !VersusOpen(v)) {
+        VersusDestroy(v);
+        return EXIT_FAILURE;
+    }
+
+    WINDOW* mainwin = Start();
+    WIN* playwin = InitWin(mainwin, v->config.screen_height, v->config.screen_width, OFFY, OFFX, PLAY_COLOR, BORDER, 0);
+    WIN* statwin = InitWin(mainwin, STAT_HEIGHT, v->config.screen_width, v->config.screen_height + OFFY, OFFX, STAT_COLOR, BORDER, 0);
+    int result = VersusLoop(v, playwin, statwin);
+    NetFlush(&v->link, 1);      // the other side still needs our last keys
+    int left = v->link.closed && v->end_tick < 0;
+    EndGameResult(result, statwin);
+    delwin(playwin->window);
+    delwin(statwin->window);
+    delwin(mainwin);
+    endwin();
+    free(playwin);
+    free(statwin);
+
+    const BIRD* me = &v->world.bird[v->me];
+    const BIRD* them = &v->world.bird[1 - v->me];
+    if (left) printf("The other player left\n");
+    printf("%s after %ld frames: you %d stars, the other player %d\n",
+           result == 2 ? "Won" : result == 1 ? "Lost" : "Quit", v->tick, me->score, them->score);
+    printf("%ld rollbacks, %ld frames played again (deepest %ld), %ld frames waited, %ld desyncs, state %016llx\n",
+           v->rollbacks, v->resimulated, v->deepest, v->waits, v->desyncs, (unsigned long long)WorldHash(&v->world));
+    VersusDestroy(v);
+    return EXIT_SUCCESS;
 }
 
-int MainLoop(WIN* playwin, WIN* statwin, BIRD* bird , TAXI* taxi, STAR* star[] , HUNTER* hunter[] , GameConfig *config)
+// ./game --versus-check [frames] [delay ms] [jitter ms]
+// Both sides of a game in one process, each on its own thread and joined by a socketpair,
+// with the latency injection on both. Each side presses random keys a frame out of four, so
+// most of the other's predictions are wrong and get rolled back. The host quits after frames
+// frames. It passes when no hash comparison differed and both ended in the same state.
+#define VERSUS_CHECK_FRAMES 600
+#define VERSUS_CHECK_DELAY  10      // ms, plus up to as much again of jitter
+#define VERSUS_CHECK_FRAME  2000    // us per frame, fast enough that keys are often late
+
+typedef struct{
+    VERSUS* v;
+    int frames;         // the host quits here
+    int opened;
+    int result;
+} VERSUS_CHECK_SIDE;
+
+static void* VersusCheckSide(void* arg)
 {
-    int ch;        // Variable to store key press
-    double max_time = config->time_limit;
-    // Infinite loop - runs until player quits
-    while (1)
-    {
-        // Read keyboard input (non-blocking due to nodelay(TRUE))
-        ch = wgetch(statwin->window);
-        Difficulty(config , max_time);
-        config->time_limit -= (FRAME_TIME / 1000.0);
-        // Check if player wants to quit
-        if (ch == QUIT) return 0;
-        if (bird->life == 0 || config->time_limit <= 0) return 1; //defeat
-        if(bird->score >= config->star_quota) return 2; //win
-        if (ch == UP) {
-            UpBird(bird);
-        }else if(ch == DOWN){
-            DownBird(bird);
-        }else if(ch == RIGHT){
-            RightBird(bird);
-        }else if(ch == LEFT){
-            LeftBird(bird);
-        }else if(ch == SPEED_UP){
-            SpeedUp(bird , config);
-        }else if(ch == SPEED_DOWN){
-            SpeedDown(bird , config);
-        }else if(ch == ACTIVATE_TAXI && !taxi->active && config->available_taxis > 0){
-            taxi->active = 1;
-            taxi->state = 0;
-            config->available_taxis--;
+    VERSUS_CHECK_SIDE* side = (VERSUS_CHECK_SIDE*)arg;
+    VERSUS* v = side->v;
+    side->opened = VersusOpen(v);
+    if (!side->opened) {
+        shutdown(v->link.fd, SHUT_RDWR);    // or the other side waits for our hello forever
+        return NULL;
+    }
+    unsigned int rng = 0x5eed + v->me;
+    static const int moves[] = { UP, DOWN, LEFT, RIGHT };
+    while ((side->result = VersusSync(v)) == GAME_RUNNING) {
+        if (VersusReady(v)) {
+            int r = GameRandFrom(&rng) % 16;
+            int key = r < 4 ? moves[r] : NOKEY;
+            if (v->me == 0 && v->tick >= side->frames) key = QUIT;
+            VersusPlay(v, key);
         }
-        
-        // Move bird (automatic movement every frame)
-        if (taxi->active) {
-            MoveTaxi(taxi, bird);
+        NetFlush(&v->link, 0);
+        usleep(VERSUS_CHECK_FRAME);
+    }
+    NetFlush(&v->link, 1);
+    return NULL;
+}
+
+int RunVersusCheck(int argc, char* argv[])
+{
+    int frames = argc > 2 ? atoi(argv[2]) : VERSUS_CHECK_FRAMES;
+    int delay = argc > 3 ? atoi(argv[3]) : VERSUS_CHECK_DELAY;
+    int jitter = argc > 4 ? atoi(argv[4]) : delay;
+    if (frames < 1 || delay < 0 || jitter < 0) {
+        fprintf(stderr, "Error: frames must be positive, delay and jitter not negative\n");
+        return EXIT_FAILURE;
+    }
+    VERSUS_CHECK_SIDE side[2] = { { VersusCreate(1, delay, jitter), frames, 0, 0 },
+                                  { VersusCreate(0, delay, jitter), frames, 0, 0 } };
+    int fd[2];
+    if (!side[0].v || !side[1].v || socketpair(AF_UNIX, SOCK_STREAM, 0, fd) != 0) {
+        if (side[0].v && side[1].v) fprintf(stderr, "Error: Could not create a socket pair\n");
+        VersusDestroy(side[0].v);
+        VersusDestroy(side[1].v);
+        return EXIT_FAILURE;
+    }
+    side[0].v->link.fd = fd[0];
+    side[1].v->link.fd = fd[1];
+    pthread_t threads[2];
+    int started[2];
+    for (int i = 0; i < 2; i++) {
+        started[i] = pthread_create(&threads[i], NULL, VersusCheckSide, &side[i]) == 0;
+        if (!started[i]) shutdown(side[i].v->link.fd, SHUT_RDWR);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    int status = EXIT_FAILURE;
+    if (!started[0] || !started[1]) {
+        fprintf(stderr, "Error: Could not start a thread\n");
+    } else if (side[0].opened && side[1].opened) {
+        uint64_t hash[2];
+        for (int i = 0; i < 2; i++) {
+            const VERSUS* v = side[i].v;
+            hash[i] = WorldHash(&v->world);
+            printf("%s: %ld frames, %ld rollbacks, %ld frames played again (deepest %ld), %ld frames waited, "
+                   "%ld hashes compared, %ld desyncs, state %016llx\n", i ? "guest" : "host ", v->tick, v->rollbacks,
+                   v->resimulated, v->deepest, v->waits, v->compared, v->desyncs, (unsigned long long)hash[i]);
         }
-        if (bird->on_taxi == 0) {
-            MoveBird(bird);
+        const VERSUS* h = side[0].v;
+        const VERSUS* g = side[1].v;
+        if (h->desyncs || g->desyncs || hash[0] != hash[1] || h->tick != g->tick || side[0].result != side[1].result) {
+            printf("versus: the two sides disagree\n");
+        } else if (h->compared + g->compared == 0 || h->rollbacks + g->rollbacks == 0) {
+            printf("versus: nothing was %s, play more frames or add delay\n", h->rollbacks + g->rollbacks ? "compared" : "rolled back");
         } else {
-            UpdateBirdColor(bird);
-            DrawBird(bird);
+            printf("versus: both sides ended in the same state after %ld frames\n", h->tick);
+            status = EXIT_SUCCESS;
         }
-        
-        MoveMultipleStar(star , bird);
-        MoveMultipleHunter(hunter , bird , taxi, playwin , config);
-        mvwprintw(playwin->window, 1, playwin->cols - 2, "Z");
-        
-        // Update status bar with current position
-        ShowStatus(statwin, bird , config);
-        
-        // Refresh play window to show changes
-        wrefresh(playwin->window);
+    }
+    VersusDestroy(side[0].v);
+    VersusDestroy(side[1].v);
+    return status;
+}
 
-        // Clear input buffer to avoid key press accumulation
-        flushinp();
 
-        // Sleep to control frame rate
-        // FRAME_TIME is in milliseconds, usleep needs microseconds
-        usleep(FRAME_TIME * 1000);
+//__VECTORIZED ENVIRONMENTS___________//
+//====================================//
+//------------------------------------//
+
+// swallow_env.h: many headless sessions stepped by one call, observations written
+// struct-of-arrays into one block so agents can read them without copying.
+struct swallow_env{
+    swallow_obs obs;
+    GameConfig config;
+    DIFFICULTY_TABLE table;
+    int frame_skip;
+    unsigned int seed;
+    WIN* wins;                  // one headless window per environment
+    GAME_SESSION** sessions;
+    float* floats;              // backing store of the float observations
+    unsigned char* bytes;       // done and won
+};
+
+static const int SWALLOW_KEYS[SWALLOW_ACTIONS] = {
+    NOKEY, UP, DOWN, LEFT, RIGHT, SPEED_UP, SPEED_DOWN, ACTIVATE_TAXI
+};
+
+unsigned int EnvSeed(const swallow_env* env, int i, uint32_t episode)
+{
+    return env->seed + (unsigned int)i * 1000003u + episode * 7919u;
+}
+
+// Writes environment i's current state into the observation arrays
+void EnvObserve(swallow_env* env, int i)
+{
+    swallow_obs* o = &env->obs;
+    GAME_SESSION* gs = env->sessions[i];
+    int n = o->num_envs;
+    BIRD* b = gs->bird;
+    o->bird_x[i] = b->x;
+    o->bird_y[i] = b->y;
+    o->bird_dx[i] = b->dx;
+    o->bird_dy[i] = b->dy;
+    o->bird_speed[i] = b->speed;
+    o->bird_life[i] = b->life;
+    o->bird_score[i] = b->score;
+    o->on_taxi[i] = b->on_taxi;
+    o->time_left[i] = gs->config.time_limit;
+    for (int k = 0; k < MAX_HUNTERS; k++) {
+        HUNTER* h = gs->hunter[k];
+        int active = k < gs->config.hunter_num && h->active;
+        o->hunter_x[k * n + i] = active ? h->x : 0;
+        o->hunter_y[k * n + i] = active ? h->y : 0;
+        o->hunter_dx[k * n + i] = active ? h->dx : 0;
+        o->hunter_dy[k * n + i] = active ? h->dy : 0;
+        o->hunter_active[k * n + i] = active;
+    }
+    for (int k = 0; k < MAX_STARS; k++) {
+        o->star_x[k * n + i] = gs->star[k]->x;
+        o->star_y[k * n + i] = gs->star[k]->y;
     }
 }
 
-void EndGameResult(int result, WIN* statwin)
+swallow_env* swallow_env_create(int num_envs, const char* config_file, const char* difficulty_file,
+                                unsigned int seed, int frame_skip)
 {
-    if (result == 2) {
-            EndGameWin(statwin);
-        }
-        else if (result == 1) {
-            EndGameLose(statwin);
+    if (num_envs < 1 || frame_skip < 1 || frame_skip > MAX_DT) return NULL;
+    swallow_env* env = (swallow_env*)calloc(1, sizeof(swallow_env));
+    if (!env) return NULL;
+    if (config_file) {
+        if (!LoadConfig(config_file, &env->config)) {
+            free(env);
+            return NULL;
         }
-        else if(result == 0){
-            EndGameQuit(statwin);
+    } else {
+        DefaultValues(&env->config);
+    }
+    env->table = DEFAULT_DIFFICULTY;
+    if (difficulty_file && !LoadDifficulty(difficulty_file, &env->table)) {
+        free(env);
+        return NULL;
+    }
+    env->frame_skip = frame_skip;
+    env->wins = (WIN*)calloc(num_envs, sizeof(WIN));
+    env->sessions = (GAME_SESSION**)calloc(num_envs, sizeof(GAME_SESSION*));
+    int per_env = 10 + 5 * MAX_HUNTERS + 2 * MAX_STARS;   // float fields of one environment
+    env->floats = (float*)calloc((size_t)num_envs * per_env, sizeof(float));
+    env->bytes = (unsigned char*)calloc((size_t)num_envs * 2, 1);
+    env->obs.episode = (uint32_t*)calloc(num_envs, sizeof(uint32_t));
+    if (!env->wins || !env->sessions || !env->floats || !env->bytes || !env->obs.episode) {
+        swallow_env_destroy(env);
+        return NULL;
+    }
+    for (int i = 0; i < num_envs; i++) {
+        WIN w = { NULL, OFFX, OFFY, env->config.screen_height, env->config.screen_width, PLAY_COLOR, NULL };
+        env->wins[i] = w;
+        env->sessions[i] = SessionCreate(&env->config, &env->table, &env->wins[i], NULL);
+        if (!env->sessions[i]) {
+            env->obs.num_envs = num_envs;   // so destroy frees the sessions made so far
+            swallow_env_destroy(env);
+            return NULL;
         }
+    }
+
+    swallow_obs* o = &env->obs;
+    o->num_envs = num_envs;
+    o->max_hunters = MAX_HUNTERS;
+    o->max_stars = MAX_STARS;
+    o->width = env->config.screen_width;
+    o->height = env->config.screen_height;
+    float* f = env->floats;
+    float** bird_fields[] = { &o->bird_x, &o->bird_y, &o->bird_dx, &o->bird_dy, &o->bird_speed,
+                              &o->bird_life, &o->bird_score, &o->on_taxi, &o->time_left, &o->reward };
+    for (int k = 0; k < 10; k++) {
+        *bird_fields[k] = f;
+        f += num_envs;
+    }
+    float** hunter_fields[] = { &o->hunter_x, &o->hunter_y, &o->hunter_dx, &o->hunter_dy, &o->hunter_active };
+    for (int k = 0; k < 5; k++) {
+        *hunter_fields[k] = f;
+        f += (size_t)num_envs * MAX_HUNTERS;
+    }
+    o->star_x = f;
+    f += (size_t)num_envs * MAX_STARS;
+    o->star_y = f;
+    o->done = env->bytes;
+    o->won = env->bytes + num_envs;
+    swallow_env_reset(env, seed);
+    return env;
 }
 
-void CleanUpMemory(WINDOW* mainwin, WIN* playwin, WIN* statwin, BIRD* bird, TAXI* taxi, STAR* star[], HUNTER* hunter[], GameConfig* config){
-    // Delete ncurses windows
-    delwin(playwin->window);
-    delwin(statwin->window);
-    delwin(mainwin);
+const swallow_obs* swallow_env_obs(const swallow_env* env)
+{
+    return &env->obs;
+}
 
-    // Close ncurses
-    endwin();
-    refresh();
-    // Free allocated memory
-    free_hunter(hunter , config);
-    free_star(star);
-    free(bird);
-    free(taxi);
-    free(playwin);
-    free(statwin);
+void swallow_env_reset(swallow_env* env, unsigned int seed)
+{
+    env->seed = seed;
+    for (int i = 0; i < env->obs.num_envs; i++) {
+        env->obs.episode[i] = 0;
+        env->obs.reward[i] = 0;
+        env->obs.done[i] = 0;
+        env->obs.won[i] = 0;
+        SessionReset(env->sessions[i], EnvSeed(env, i, 0));
+        EnvObserve(env, i);
+    }
+}
+
+void swallow_env_step(swallow_env* env, const int* actions)
+{
+    swallow_obs* o = &env->obs;
+    for (int i = 0; i < o->num_envs; i++) {
+        GAME_SESSION* gs = env->sessions[i];
+        BIRD* b = gs->bird;
+        int action = actions[i];
+        int keys[MAX_BIRDS];
+        keys[0] = (action > 0 && action < SWALLOW_ACTIONS) ? SWALLOW_KEYS[action] : NOKEY;
+        BotKeys(gs, keys, 1, env->frame_skip);   // BIRDS above 1 in the config fly with the bot
+        int score = b->score;
+        int life = b->life;
+        int result = SessionTick(gs, keys, env->frame_skip);
+        if (result == GAME_RUNNING) result = GameResult(&gs->flock, &gs->config);
+        float reward = (float)(b->score - score);
+        if (b->life < life) reward -= (float)(life - b->life) / (gs->config.damage_penalty > 0 ? gs->config.damage_penalty : 1);
+        o->done[i] = result != GAME_RUNNING;
+        o->won[i] = result == 2;
+        if (result != GAME_RUNNING) {
+            reward += result == 2 ? SWALLOW_END_REWARD : -SWALLOW_END_REWARD;
+            o->episode[i]++;
+            SessionReset(gs, EnvSeed(env, i, o->episode[i]));
+        }
+        o->reward[i] = reward;
+        EnvObserve(env, i);
+    }
+}
+
+void swallow_env_destroy(swallow_env* env)
+{
+    if (!env) return;
+    if (env->sessions) {
+        for (int i = 0; i < env->obs.num_envs; i++) SessionDestroy(env->sessions[i]);
+    }
+    free(env->sessions);
+    free(env->wins);
+    free(env->floats);
+    free(env->bytes);
+    free(env->obs.episode);
+    FreeMap((MAP*)env->config.map);
+    ClosePack(env->config.pack);
+    free(env);
 }
 
+// ./game --env-bench [envs] [steps] [frame skip]
+// Steps a swallow_env with random actions (changed every 8 steps, like BotKey's reaction time)
+#define ENV_BENCH_ENVS  256
+#define ENV_BENCH_STEPS 4000
+
+int RunEnvBench(int argc, char* argv[])
+{
+    int envs = argc > 2 ? atoi(argv[2]) : ENV_BENCH_ENVS;
+    int steps = argc > 3 ? atoi(argv[3]) : ENV_BENCH_STEPS;
+    int skip = argc > 4 ? atoi(argv[4]) : 1;
+    swallow_env* env = swallow_env_create(envs, "config.txt", NULL, 1, skip);
+    if (!env || steps < 1) {
+        fprintf(stderr, "Error: Could not create %d environments (frame skip 1 to %d)\n", envs, MAX_DT);
+        return EXIT_FAILURE;
+    }
+    const swallow_obs* obs = swallow_env_obs(env);
+    int* actions = (int*)calloc(envs, sizeof(int));
+    unsigned int rng = 12345;
+    long games = 0, wins = 0;
+    double reward = 0;
+    uint64_t start = TraceWallNs();
+    for (int step = 0; step < steps; step++) {
+        if (step % 8 == 0) {
+            for (int i = 0; i < envs; i++) actions[i] = GameRandFrom(&rng) % SWALLOW_ACTIONS;
+        }
+        swallow_env_step(env, actions);
+        for (int i = 0; i < envs; i++) {
+            games += obs->done[i];
+            wins += obs->won[i];
+            reward += obs->reward[i];
+        }
+    }
+    double seconds = (TraceWallNs() - start) / 1e9;
+    printf("%d envs x %d steps (frame skip %d) in %.2f s: %.2f M env-steps/s\n",
+           envs, steps, skip, seconds, (double)envs * steps / seconds / 1e6);
+    printf("%ld games finished, %ld won, mean reward per step %.4f\n", games, wins, reward / ((double)envs * steps));
+    free(actions);
+    swallow_env_destroy(env);
+    return EXIT_SUCCESS;
+}
 
 
-int main()
+#ifndef SWALLOW_NO_MAIN
+int main(int argc, char* argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "--calibrate") == 0) {
+        return RunCalibration(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--stress") == 0) {
+        return RunStress(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--env-bench") == 0) {
+        return RunEnvBench(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--kernels") == 0) {
+        return RunKernelBench(argc, argv);
+    }
+    if (argc > 1 && (strcmp(argv[1], "--host") == 0 || strcmp(argv[1], "--join") == 0)) {
+        return RunVersus(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--versus-check") == 0) {
+        return RunVersusCheck(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--pack-make") == 0) {
+        return RunPackMake(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--pack-bench") == 0) {
+        return RunPackBench(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--heat-merge") == 0) {
+        return RunHeatMerge(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--heat-show") == 0) {
+        return RunHeatShow(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--tick-hash") == 0) {
+        return RunTickHash(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--tick-diff") == 0) {
+        return RunTickDiff(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--autosave-check") == 0) {
+        return RunAutosaveCheck(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--boids") == 0) {
+        return RunBoidsBench(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--rain") == 0) {
+        return RunRainBench(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--planner") == 0) {
+        return RunPlannerBench(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--shm-bench") == 0) {
+        return RunShmBench(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--pty-latency") == 0) {
+        return RunPtyLatency(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--trace-json") == 0) {
+        return RunTraceJson(argc, argv);
+    }
+    // --perf with a number of games runs them headless, on its own it measures a normal game
+    if (argc > 2 && strcmp(argv[1], "--perf") == 0) {
+        return RunPerf(argc, argv);
+    }
+    int measure = argc > 1 && strcmp(argv[1], "--perf") == 0;
+    PERF counters;
     GameConfig config;
     if (!LoadConfig("config.txt", &config)) {
             return EXIT_FAILURE;
         }
-    double initial_time = config.time_limit;
-    srand(config.seed);
-    STAR* s[MAX_STARS];
-    HUNTER* h[MAX_HUNTERS];
+    DIFFICULTY_TABLE table;
+    LoadDifficulty(DIFFICULTY_FILE, &table);
 
     WINDOW *mainwin = Start();
     WIN* playwin = InitWin(mainwin, config.screen_height, config.screen_width, OFFY, OFFX,
                            PLAY_COLOR, BORDER, 0);
     WIN* statwin = InitWin(mainwin, STAT_HEIGHT, config.screen_width , config.screen_height+OFFY, OFFX,
                            STAT_COLOR, BORDER, 0);
-    BIRD* b = InitBird(playwin, config.screen_width/2, config.screen_height/2, 1, 0 , &config);
-    TAXI* t = InitTaxi(playwin , &config);
-    InitMultipleStar(s , playwin );
-    InitMultipleHunter(h , playwin , b , &config);
+    GAME_SESSION* gs = SessionCreate(&config, &table, playwin, statwin);
+    if (!gs) {
+        endwin();
+        fprintf(stderr, "Error: Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    if (config.planner > 0) {
+        gs->planner = PlannerCreate(&config, playwin, config.planner, config.planner_threads);
+        if (!gs->planner) {
+            endwin();
+            fprintf(stderr, "Error: Out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+    SessionReset(gs, config.seed);
+    if (config.autosave && AutosaveStart(gs, config.autosave, AUTOSAVE_FILE)) AutosaveOffer(gs);
     // Step 4: Initial display
    
-    DrawBird(b);            // Draw bird
-    ShowStatus(statwin, b , &config);    // Update status bar
+    DrawMap(playwin);                 // Draw walls
+    DrawFlock(&gs->flock);            // Draw birds
+    ShowStatus(statwin, &gs->flock , &gs->config);    // Update status bar
     wrefresh(playwin->window);    // Refresh play window
-    int result = MainLoop(playwin, statwin, b ,t , s , h , &config);
-    double time_used = initial_time - config.time_limit;
-        if(time_used < 0) time_used = 0;
-    
-    UpdateRanking(b, &config, time_used, CalculateScore(b , &config) );
-    
-    // Step 5: Run main game loop (returns when player quits)
-    
-    EndGameResult(result , statwin);
-
-    ShowRanking(mainwin, config.screen_height, config.screen_width);
+    TraceStart(TRACE_FILE);
+    if (config.shared_state) ShmStart(SWALLOW_SHM_NAME);
+    if (config.metrics) MetricsStart(config.metrics);
+    char record_file[64] = "";
+    if (config.record) {
+        snprintf(record_file, sizeof(record_file), RECORD_FILE, (long)time(NULL));
+        if (!RecordStart(record_file, config.screen_height + OFFY + STAT_HEIGHT, config.screen_width + OFFX)) {
+            record_file[0] = '\0';
+        }
+    }
+    if (measure) {
+        PerfOpen(&counters);
+        phase_perf = &counters;
+    }
+    long steady_allocs = 0;
+    int again;
+    do {
+        // Step 5: Run main game loop (returns when player quits)
+        int result = MainLoop(gs);
+        steady_allocs += gs->frame_allocs;
+        AutosaveDiscard();
+        MetricsWrites(1);
+        if (gs->heat) HeatFlush(gs->heat, HEATMAP_FILE);
+        double time_used = gs->max_time - gs->config.time_limit;
+            if(time_used < 0) time_used = 0;
+        
+        uint64_t ranking_start = TraceWallNs();
+        UpdateRanking(gs->bird, &gs->config, time_used, CalculateScore(gs->bird , &gs->config) );
+        MetricObserve(M_RANKING_SECONDS, TraceWallNs() - ranking_start);
+        MetricsWrites(0);   // the heatmap and the ranking, not the screen
+        MetricAdd(result == 2 ? M_GAMES_WON : result == 1 ? M_GAMES_LOST : M_GAMES_QUIT, 1);
+        
+        // Display game over message
+        again = EndGameResult(result , statwin);
+
+        ShowRanking(mainwin, config.screen_height, config.screen_width);
+        // a won pack level moves the campaign on, the last one starts it again
+        if (result == 2 && gs->level) gs->pack_level = gs->pack_level % config.pack->levels + 1;
+        if (again) PlayAgain(mainwin, gs);
+    } while (again);
+    phase_perf = NULL;
+    TraceStop();
+    unsigned int dropped = RecordStop();
+    ShmStop();
+    MetricsStop();
+    AutosaveStop();
     // Step 6: Cleanup - free resources and close ncurses
-    // Display game over message
     
-    CleanUpMemory(mainwin, playwin, statwin, b , t, s, h , &config);
+    CleanUpMemory(mainwin, gs);
+    FreeMap((MAP*)config.map);
+    ClosePack(config.pack);
+    if (record_file[0]) printf("Session recorded to %s (%u frames dropped)\n", record_file, dropped);
+    if (measure) {
+        PerfClose(&counters);
+        PerfReport(&counters, stdout);
+        PrintAllocs(steady_allocs);
+    }
     
     return EXIT_SUCCESS;
 }
-
-
-
+#endif
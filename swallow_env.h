@@ -0,0 +1,102 @@
+//
+//  swallow_env.h
+//  Many headless swallow games stepped together, for agents and search code.
+//
+//  Build with `make libswallow_env.a` and link with -lswallow_env -lncurses -lm -lpthread -lz.
+//
+//      swallow_env* env = swallow_env_create(1024, "config.txt", NULL, 42, 1);
+//      const swallow_obs* obs = swallow_env_obs(env);
+//      int actions[1024];
+//      for (;;) {
+//          ... fill actions from obs ...
+//          swallow_env_step(env, actions);
+//      }
+//      swallow_env_destroy(env);
+//
+//  Every observation array is laid out struct-of-arrays: one value per environment next to
+//  each other, so field[i] is environment i and, for hunters and stars,
+//  field[k * num_envs + i] is slot k of environment i. An environment whose game ended in
+//  a step reports done and its reward for that step, and already shows the first state of
+//  the next game (seeded from the env seed, the environment and its episode number).
+//
+
+#ifndef SWALLOW_ENV_H
+#define SWALLOW_ENV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    SWALLOW_NOOP = 0,
+    SWALLOW_UP,
+    SWALLOW_DOWN,
+    SWALLOW_LEFT,
+    SWALLOW_RIGHT,
+    SWALLOW_SPEED_UP,
+    SWALLOW_SPEED_DOWN,
+    SWALLOW_TAXI,
+    SWALLOW_ACTIONS
+};
+
+typedef struct{
+    int num_envs;
+    int max_hunters;        // hunter slots per environment
+    int max_stars;          // star slots per environment
+    int width, height;      // board size in cells
+
+    // [num_envs]
+    float* bird_x;
+    float* bird_y;
+    float* bird_dx;
+    float* bird_dy;
+    float* bird_speed;
+    float* bird_life;
+    float* bird_score;      // stars collected this game
+    float* on_taxi;
+    float* time_left;       // seconds
+    float* reward;          // stars collected - hits taken, +-SWALLOW_END_REWARD on the last step
+    uint8_t* done;          // 1 if the game ended in the last step (the env has restarted)
+    uint8_t* won;           // with done: 1 won, 0 lost
+    uint32_t* episode;      // games finished by this environment
+
+    // [max_hunters * num_envs], inactive hunters are zero
+    float* hunter_x;
+    float* hunter_y;
+    float* hunter_dx;
+    float* hunter_dy;
+    float* hunter_active;
+
+    // [max_stars * num_envs]
+    float* star_x;
+    float* star_y;
+} swallow_obs;
+
+#define SWALLOW_END_REWARD 10.0f
+
+typedef struct swallow_env swallow_env;
+
+// config_file and difficulty_file may be NULL for the built-in settings. frame_skip is the
+// number of game frames (50 ms each) one step simulates, 1 to 16.
+// Returns NULL if a file cannot be read or memory runs out.
+swallow_env* swallow_env_create(int num_envs, const char* config_file, const char* difficulty_file,
+                                unsigned int seed, int frame_skip);
+
+// Observation buffers, valid until swallow_env_destroy and updated by every step
+const swallow_obs* swallow_env_obs(const swallow_env* env);
+
+// Starts a new game in every environment from seed
+void swallow_env_reset(swallow_env* env, unsigned int seed);
+
+// Advances every environment by one step, actions[i] is a SWALLOW_* action for env i
+void swallow_env_step(swallow_env* env, const int* actions);
+
+void swallow_env_destroy(swallow_env* env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+//
+//  swallow_shm.h
+//  The live game state as the game publishes it into POSIX shared memory, and the
+//  reader side for overlays, bots and dashboards. Header only, link with nothing.
+//
+//  Turn it on with SHARED_STATE 1 in config.txt, then from any local process:
+//
+//      const swallow_shm* shm = swallow_shm_open(NULL);
+//      swallow_shm_state s;
+//      uint64_t seen = 0;
+//      while (shm && !swallow_shm_closed(shm)) {
+//          if (swallow_shm_version(shm) == seen) { usleep(1000); continue; }
+//          seen = swallow_shm_read(shm, &s);
+//          ... s.bird.x, s.hunter[k].x, s.time_left ...
+//      }
+//      swallow_shm_close(shm);
+//
+//  The game writes under a sequence lock: the sequence is odd while a tick is being
+//  written and even otherwise. A reader copies the state and keeps it only if the
+//  sequence was even and unchanged around the copy, so the game never waits for readers
+//  and readers never see half a tick.
+//
+
+#ifndef SWALLOW_SHM_H
+#define SWALLOW_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWALLOW_SHM_NAME    "/swallow-state"
+#define SWALLOW_SHM_MAGIC   0x53574c57u     // "SWLW"
+#define SWALLOW_SHM_VERSION 1
+#define SWALLOW_SHM_HUNTERS 6
+#define SWALLOW_SHM_STARS   10
+#define SWALLOW_SHM_BONUS   15
+#define SWALLOW_SHM_TRIES   100000          // copies swallow_shm_read attempts before giving up
+
+typedef struct{
+    int32_t x, y;
+    int32_t dx, dy;
+    int32_t speed;
+    int32_t life, max_life;
+    int32_t score;          // stars collected
+    int32_t on_taxi;
+} swallow_shm_bird;
+
+typedef struct{
+    double x, y;
+    double dx, dy;
+    int32_t bounces;        // wall bounces left
+    int32_t active;         // 0: the slot is empty, the rest is stale
+    int32_t width, height;
+} swallow_shm_hunter;
+
+typedef struct{
+    int32_t x, y;
+} swallow_shm_star;
+
+typedef struct{
+    int32_t x, y;
+    int32_t state;          // 0 waiting for the bird, 1 carrying it
+    int32_t active;
+    int32_t taxis_left;
+    int32_t bonus_x[SWALLOW_SHM_BONUS];
+    uint8_t bonus_active[SWALLOW_SHM_BONUS];   // 1 not collected yet
+} swallow_shm_taxi;
+
+typedef struct{
+    uint64_t tick;          // frames since this game started
+    uint64_t time_ns;       // CLOCK_MONOTONIC when the tick finished, before it was published
+    uint32_t game;          // games played by the process, starting at 1
+    int32_t result;         // -1 running, 0 quit, 1 lost, 2 won
+    int32_t width, height;  // board in cells
+    int32_t level;
+    int32_t star_quota;
+    int32_t hunter_num;     // hunters allowed at once on this level
+    int32_t total_score;    // what the ranking would get now
+    float time_left;        // seconds
+    swallow_shm_bird bird;
+    swallow_shm_taxi taxi;
+    swallow_shm_hunter hunter[SWALLOW_SHM_HUNTERS];
+    swallow_shm_star star[SWALLOW_SHM_STARS];
+} swallow_shm_state;
+
+typedef struct{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;          // sizeof(swallow_shm)
+    uint32_t closed;        // 1 once the game has exited
+    uint64_t seq __attribute__((aligned(64)));   // odd while a tick is being written
+    swallow_shm_state state;
+} swallow_shm;
+
+// Maps the segment read only. name NULL is SWALLOW_SHM_NAME. NULL if no game publishes
+// under that name or it was built with another layout.
+static inline const swallow_shm* swallow_shm_open(const char* name)
+{
+    int fd = shm_open(name ? name : SWALLOW_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(swallow_shm)) {
+        close(fd);
+        return NULL;
+    }
+    void* p = mmap(NULL, sizeof(swallow_shm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    const swallow_shm* shm = (const swallow_shm*)p;
+    if (shm->magic != SWALLOW_SHM_MAGIC || shm->version != SWALLOW_SHM_VERSION ||
+        shm->size != sizeof(swallow_shm)) {
+        munmap(p, sizeof(swallow_shm));
+        return NULL;
+    }
+    return shm;
+}
+
+static inline void swallow_shm_close(const swallow_shm* shm)
+{
+    if (shm) munmap((void*)shm, sizeof(swallow_shm));
+}
+
+// Changes with every published tick, cheap enough to poll
+static inline uint64_t swallow_shm_version(const swallow_shm* shm)
+{
+    return __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+}
+
+static inline int swallow_shm_closed(const swallow_shm* shm)
+{
+    return __atomic_load_n(&shm->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+// Copies the latest complete tick into out and returns its version, or 0 if nothing was
+// published yet or the game stopped in the middle of a tick.
+static inline uint64_t swallow_shm_read(const swallow_shm* shm, swallow_shm_state* out)
+{
+    for (int i = 0; i < SWALLOW_SHM_TRIES; i++) {
+        uint64_t before = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+        memcpy(out, (const void*)&shm->state, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == before) return before;
+    }
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif